@@ -0,0 +1,48 @@
+#pragma once
+
+#include <string>
+#include <memory>
+
+#include "record.h"
+
+namespace Bench
+{
+
+//! Адрес, на котором гарантированно никто не слушает: отправка сразу завершается ошибкой соединения.
+//! Бенчмарки очереди используют MemorySink и от сети не зависят
+constexpr const char* kHost = "127.0.0.1";
+constexpr uint16_t kPort = 1;
+constexpr const char* kToken = "bench";
+
+//! Короткая запись без тела
+inline Logger::RecordPtr MakeSmallRecord()
+{
+	auto r = std::make_shared<Logger::Record>();
+	r->service = "BENCH";
+	r->source = "BENCH";
+	r->category = "BENCH";
+	r->level = "INFO";
+	r->info = "short message";
+	return r;
+}
+
+//! Запись, аналогичная demo: кириллица, свойства, заголовки и json тело
+inline Logger::RecordPtr MakeLargeRecord()
+{
+	auto r = std::make_shared<Logger::Record>();
+	r->service = "WBA";
+	r->source = "DEMO";
+	r->category = "WBA";
+	r->level = "INFO";
+	r->info = "произвольная информация для поиска через регулярные выражения";
+	r->url = "github.com/jackc/pgx/issues/771";
+	r->httpType = "POST";
+	r->properties = {{"idOrder", "123"}, {"idProject", "541"}};
+	r->httpHeaders = {{"User-Agent", "PostmanRuntime/7.29.0"}};
+	r->jsonBody = R"({"id": "4286", "mainInfo": {"type": "personalDataChangePassportAge", "status": "anketaDraft"},)"
+				  R"("passportMain": {"gender": 1, "lastName": "Козлов", "birthDate": "1999-01-01", "firstName": "Андрей"},)"
+				  R"("passportRegistration": {"area": null, "city": "г Москва", "flat": "кв 1", "house": "д 5", "index": "125319"}})";
+	return r;
+}
+
+} // namespace Bench
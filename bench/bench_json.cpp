@@ -0,0 +1,238 @@
+#include <benchmark/benchmark.h>
+
+#include <random>
+
+#include "bench_common.h"
+#include "json_escape.h"
+#include "serializer.h"
+#include "json.hpp"
+#include "date.h"
+#include "fmtlib/format.h"
+
+namespace
+{
+
+const char* KernelName(Logger::JsonKernel kernel)
+{
+	switch (kernel)
+	{
+		case Logger::JsonKernel::Scalar:
+			return "scalar";
+		case Logger::JsonKernel::Sse2:
+			return "sse2";
+		case Logger::JsonKernel::Avx2:
+			return "avx2";
+	}
+	return "";
+}
+
+//! Случайная строка: ASCII, экранируемые символы, корректные многобайтовые последовательности
+//! и (если invalid) некорректные: обрезанные, overlong, суррогаты, одиночные байты продолжения
+std::string RandomString(std::mt19937& rng, bool invalid)
+{
+	static const std::vector<std::string> pieces = {
+		"a", "Z", " ", "/", "\x7F", "\"", "\\", "\n", "\r", "\t", "\b", "\f", std::string(1, '\0'), "\x01", "\x1F",
+		"ж", "Ё", "€", "\xF0\x9F\x98\x80", "\xEF\xBF\xBF", "\xF4\x8F\xBF\xBF", "\xED\x9F\xBF", "\xE0\xA0\x80", "\xF0\x90\x80\x80",
+		"произвольная информация", "github.com/jackc/pgx/issues/771",
+	};
+	static const std::vector<std::string> broken = {
+		"\x80", "\xBF", "\xC0\x80", "\xC1\xBF", "\xC3", "\xE2\x82", "\xE0\x80\x80", "\xED\xA0\x80", "\xF0\x80\x80\x80",
+		"\xF4\x90\x80\x80", "\xF5\x80\x80\x80", "\xFF", "\xF0\x9F\x98", "\xC3\x28",
+	};
+
+	std::string s;
+	size_t count = std::uniform_int_distribution<size_t>(0, 80)(rng);
+	for (size_t i = 0; i < count; i++)
+	{
+		// длинные участки ASCII проверяют переход между блоками
+		if (rng() % 8 == 0)
+			s += std::string(rng() % 40, 'x');
+		else
+			s += pieces.at(rng() % pieces.size());
+	}
+	if (invalid)
+		s.insert(rng() % (s.size() + 1), broken.at(rng() % broken.size()));
+	return s;
+}
+
+//! Эталон: строка через nlohmann::json::dump() или пустая строка, если сериализация невозможна
+std::string NlohmannString(const std::string& value)
+{
+	try
+	{
+		return nlohmann::json(value).dump();
+	}
+	catch (...)
+	{
+		return {};
+	}
+}
+
+std::string EscapedString(const std::string& value)
+{
+	try
+	{
+		std::string out;
+		Logger::AppendJsonString(out, value);
+		return out;
+	}
+	catch (...)
+	{
+		return {};
+	}
+}
+
+//! Эталонная сериализация записи через nlohmann::json (как до прямой сериализации)
+std::string NlohmannRecord(const Logger::Record& r)
+{
+	auto j = nlohmann::json::object();
+	j["logTime"] = date::format("%FT%TZ", r.time);
+	j["service"] = r.service;
+	j["source"] = r.source;
+	j["category"] = r.category;
+	j["level"] = r.level;
+	j["session"] = r.session;
+	j["info"] = r.info;
+	j["url"] = r.url;
+	j["httpType"] = r.httpType;
+	j["httpCode"] = r.httpCode;
+	j["errorCode"] = r.errorCode;
+	j["properties"] = r.properties;
+	j["httpHeaders"] = r.httpHeaders;
+	if (!r.jsonBody.empty())
+	{
+		try
+		{
+			j["body"] = nlohmann::json::parse(r.jsonBody);
+		}
+		catch (...)
+		{
+		}
+	}
+	return j.dump();
+}
+
+} // namespace
+
+// Экранирование строки для JSON: ASCII, кириллица, строка с экранируемыми символами
+static void BM_JsonString(benchmark::State& state)
+{
+	const auto kernel = (Logger::JsonKernel)state.range(0);
+	Logger::SetJsonKernel(kernel);
+	if (Logger::ActiveJsonKernel() != kernel)
+	{
+		state.SkipWithError("kernel is not supported");
+		Logger::SetJsonKernel(Logger::DetectJsonKernel());
+		return;
+	}
+
+	std::string value;
+	for (int i = 0; i < 16; i++)
+	{
+		switch (state.range(1))
+		{
+			case 0:
+				value += "github.com/jackc/pgx/issues/771 ";
+				break;
+			case 1:
+				value += "произвольная информация ";
+				break;
+			default:
+				value += "{\"key\": \"value\"}\n";
+		}
+	}
+
+	std::string out;
+	for (auto _ : state)
+	{
+		out.clear();
+		Logger::AppendJsonString(out, value);
+		benchmark::DoNotOptimize(out);
+	}
+	state.SetBytesProcessed(state.iterations() * value.size());
+	state.SetLabel(KernelName(kernel));
+	Logger::SetJsonKernel(Logger::DetectJsonKernel());
+}
+BENCHMARK(BM_JsonString)->ArgNames({"kernel", "text"})->ArgsProduct({{0, 1, 2}, {0, 1, 2}});
+
+// Сравнение с nlohmann::json на случайных строках и записях для всех реализаций. При расхождении бенчмарк завершается ошибкой
+static void BM_JsonStringFuzz(benchmark::State& state)
+{
+	std::mt19937 rng(12345);
+	size_t checked = 0;
+	for (auto _ : state)
+	{
+		std::string value = RandomString(rng, rng() % 4 == 0);
+		std::string expected = NlohmannString(value);
+
+		auto record = Bench::MakeLargeRecord();
+		record->info = value;
+		record->properties["key"] = RandomString(rng, false);
+		std::string expected_record;
+		try
+		{
+			expected_record = NlohmannRecord(*record);
+		}
+		catch (...)
+		{
+		}
+
+		// запись с шаблоном отличается только порядком ключей
+		auto record_template = std::make_shared<Logger::RecordTemplate>(RandomString(rng, false), RandomString(rng, false), "category",
+																		 std::map<std::string, std::string> {{"h", RandomString(rng, false)}});
+		auto templated = std::make_shared<Logger::Record>(*record);
+		templated->recordTemplate = record_template;
+		auto applied = std::make_shared<Logger::Record>(*templated);
+		applied->ApplyTemplate();
+		std::string expected_templated;
+		try
+		{
+			expected_templated = NlohmannRecord(*applied);
+		}
+		catch (...)
+		{
+		}
+
+		for (auto kernel : {Logger::JsonKernel::Scalar, Logger::JsonKernel::Sse2, Logger::JsonKernel::Avx2})
+		{
+			Logger::SetJsonKernel(kernel);
+			if (Logger::ActiveJsonKernel() != kernel)
+				continue;
+
+			bool valid = Logger::IsValidUtf8(value);
+			std::string serialized;
+			try
+			{
+				serialized = Logger::SerializeRecord(*record);
+			}
+			catch (...)
+			{
+			}
+
+			bool templated_ok;
+			try
+			{
+				std::string json = Logger::SerializeRecord(*templated);
+				templated_ok = !expected_templated.empty() && nlohmann::json::parse(json) == nlohmann::json::parse(expected_templated);
+			}
+			catch (...)
+			{
+				templated_ok = expected_templated.empty();
+			}
+
+			if (EscapedString(value) != expected || valid == expected.empty() || serialized != expected_record || !templated_ok)
+			{
+				Logger::SetJsonKernel(Logger::DetectJsonKernel());
+				std::string hex;
+				for (unsigned char c : value)
+					hex += fmt::format("{:02x}", c);
+				state.SkipWithError(fmt::format("{} mismatch on: {}", KernelName(kernel), hex).c_str());
+				return;
+			}
+			checked++;
+		}
+	}
+	state.counters["checked"] = (double)checked;
+	Logger::SetJsonKernel(Logger::DetectJsonKernel());
+}
+BENCHMARK(BM_JsonStringFuzz)->Iterations(20000);
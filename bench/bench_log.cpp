@@ -0,0 +1,99 @@
+#include <benchmark/benchmark.h>
+
+#include "bench_common.h"
+#include "log.h"
+#include "clock.h"
+
+// Форматирование info в потоке, добавляющем запись
+static void BM_EagerFormat(benchmark::State& state)
+{
+	for (auto _ : state)
+	{
+		auto r = std::make_shared<Logger::Record>();
+		r->service = "BENCH";
+		r->level = "INFO";
+		r->info = fmt::format("order {} project {} client {} amount {:.2f}", 123, 541, "Андрей Козлов", 1234.5);
+		benchmark::DoNotOptimize(r);
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_EagerFormat);
+
+// Сохранение аргументов для форматирования в потоке обработчика
+static void BM_DeferredFormatCapture(benchmark::State& state)
+{
+	for (auto _ : state)
+	{
+		auto r = std::make_shared<Logger::Record>();
+		r->service = "BENCH";
+		r->level = "INFO";
+		r->deferredInfo =
+			std::make_shared<Logger::FmtDeferredFormat>("order {} project {} client {} amount {:.2f}", 123, 541, "Андрей Козлов", 1234.5);
+		benchmark::DoNotOptimize(r);
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_DeferredFormatCapture);
+
+// Форматирование сохраненных аргументов (выполняется обработчиком)
+static void BM_DeferredFormatResolve(benchmark::State& state)
+{
+	auto deferred = std::make_shared<Logger::FmtDeferredFormat>("order {} project {} client {} amount {:.2f}", 123, 541, "Андрей Козлов", 1234.5);
+	Logger::Record r;
+	for (auto _ : state)
+	{
+		r.deferredInfo = deferred;
+		r.FormatDeferred();
+		benchmark::DoNotOptimize(r.info);
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_DeferredFormatResolve);
+
+// Вызов отключенного уровня: запись не создается
+static void BM_DisabledLevel(benchmark::State& state)
+{
+	Logger::LevelFilter::SetMinLevel(Logger::Level::Info);
+	if (state.range(0))
+		Logger::LevelFilter::SetServiceMinLevel("OTHER", Logger::Level::Warning);
+
+	for (auto _ : state)
+		benchmark::DoNotOptimize(LOG_DEBUG("BENCH", "order {} project {}", 123, 541));
+	state.SetItemsProcessed(state.iterations());
+
+	Logger::LevelFilter::ResetServiceMinLevel("OTHER");
+	Logger::LevelFilter::SetMinLevel(Logger::Level::Trace);
+}
+BENCHMARK(BM_DisabledLevel)->ArgName("service_levels")->Arg(0)->Arg(1);
+
+// Получение времени записи: 0 - system_clock, 1 - CLOCK_REALTIME_COARSE, 2 - TSC.
+// drift_us - расхождение с system_clock после измерения
+static void BM_ClockNow(benchmark::State& state)
+{
+	const auto source = (Logger::ClockSource)state.range(0);
+	if (Logger::Clock::SetSource(source) != source)
+	{
+		state.SkipWithError("clock source is not supported");
+		return;
+	}
+
+	for (auto _ : state)
+		benchmark::DoNotOptimize(Logger::Clock::Now());
+	state.SetItemsProcessed(state.iterations());
+
+	auto system = std::chrono::time_point_cast<std::chrono::microseconds>(std::chrono::system_clock::now());
+	state.counters["drift_us"] = (double)std::abs((Logger::Clock::Now() - system).count());
+	Logger::Clock::SetSource(Logger::ClockSource::System);
+}
+BENCHMARK(BM_ClockNow)->ArgName("source")->Arg(0)->Arg(1)->Arg(2);
+
+// Создание записи с немедленным и отложенным получением времени
+static void BM_RecordCreate(benchmark::State& state)
+{
+	Logger::Clock::SetDeferredCapture(state.range(0) != 0);
+	for (auto _ : state)
+		benchmark::DoNotOptimize(std::make_shared<Logger::Record>());
+	state.SetItemsProcessed(state.iterations());
+	Logger::Clock::SetDeferredCapture(false);
+}
+BENCHMARK(BM_RecordCreate)->ArgName("deferred")->Arg(0)->Arg(1);
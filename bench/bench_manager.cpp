@@ -0,0 +1,138 @@
+#include <benchmark/benchmark.h>
+
+#include <filesystem>
+#include <thread>
+
+#include "bench_common.h"
+#include "manager.h"
+
+namespace
+{
+void StartManager(size_t workers_count, const std::string& error_file_name = "", size_t max_buffer_size = 0)
+{
+	// записи принимаются в памяти, поэтому измеряется только очередь и обработчики, без сети
+	Logger::Manager::SetSinks({std::make_shared<Logger::MemorySink>()});
+	Logger::Manager::SetErrorFunc([](const std::string&) {}, std::chrono::seconds(0));
+	Logger::Manager::Start(Bench::kToken, Bench::kHost, Bench::kPort, workers_count, 1000, 0, max_buffer_size, true, error_file_name);
+	Logger::Manager::WaitStart();
+}
+
+std::string ErrorFileName()
+{
+	return (std::filesystem::temp_directory_path() / "loglib-bench-errors.log").string();
+}
+} // namespace
+
+// Добавление записей из нескольких потоков-производителей
+static void BM_ManagerAddRecord(benchmark::State& state)
+{
+	if (state.thread_index() == 0)
+		StartManager(4);
+
+	auto record = Bench::MakeSmallRecord();
+	for (auto _ : state)
+		benchmark::DoNotOptimize(Logger::Manager::AddRecord(record));
+	state.SetItemsProcessed(state.iterations());
+
+	if (state.thread_index() == 0)
+		Logger::Manager::Stop();
+}
+BENCHMARK(BM_ManagerAddRecord)->ThreadRange(1, 16)->UseRealTime();
+
+// Добавление записей с ожиданием места в маленьком буфере вместо отбрасывания. dropped - отброшено по истечении ожидания
+static void BM_ManagerAddRecordBlocking(benchmark::State& state)
+{
+	if (state.thread_index() == 0)
+		StartManager(2, "", 100);
+
+	auto record = Bench::MakeSmallRecord();
+	size_t dropped = 0;
+	for (auto _ : state)
+	{
+		if (!Logger::Manager::AddRecord(record, std::chrono::seconds(1)))
+			dropped++;
+	}
+	state.SetItemsProcessed(state.iterations());
+	state.counters["dropped"] = benchmark::Counter((double)dropped, benchmark::Counter::kAvgThreads);
+
+	if (state.thread_index() == 0)
+		Logger::Manager::Stop();
+}
+BENCHMARK(BM_ManagerAddRecordBlocking)->ThreadRange(1, 8)->UseRealTime();
+
+// Один из двух обработчиков отправляет каждый пакет 20 мс. Время доставки 2000 записей без перераспределения и с ним
+static void BM_ManagerStalledWorker(benchmark::State& state)
+{
+	// медленным считается поток, первым вызвавший приемник
+	class StallSink : public Logger::MemorySink
+	{
+	protected:
+		Logger::SinkResult Write(const std::vector<Logger::RecordPtr>& records) override
+		{
+			std::thread::id none;
+			_slow.compare_exchange_strong(none, std::this_thread::get_id());
+			if (_slow.load() == std::this_thread::get_id())
+				std::this_thread::sleep_for(std::chrono::milliseconds(20));
+			return MemorySink::Write(records);
+		}
+
+	private:
+		std::atomic<std::thread::id> _slow;
+	};
+
+	Logger::StealingOptions stealing;
+	stealing.enabled = state.range(0) != 0;
+	stealing.stall = std::chrono::milliseconds(5);
+	Logger::Manager::SetStealing(stealing);
+	Logger::Manager::SetSinks({std::make_shared<StallSink>()});
+	Logger::Manager::SetErrorFunc([](const std::string&) {}, std::chrono::seconds(0));
+	Logger::Manager::Start(Bench::kToken, Bench::kHost, Bench::kPort, 2, 100, 0, 0, true, "");
+	Logger::Manager::WaitStart();
+
+	auto record = Bench::MakeSmallRecord();
+	for (auto _ : state)
+	{
+		for (int i = 0; i < 2000; i++)
+			Logger::Manager::AddRecord(record);
+		Logger::Manager::Flush(std::chrono::seconds(10));
+	}
+	state.SetItemsProcessed(state.iterations() * 2000);
+	state.counters["stolen"] = (double)Logger::Manager::StolenRecords();
+
+	Logger::Manager::Stop();
+	Logger::Manager::SetStealing({});
+}
+BENCHMARK(BM_ManagerStalledWorker)->ArgName("stealing")->Arg(0)->Arg(1)->UseRealTime();
+
+// Стоимость выбора обработчика в зависимости от их количества
+static void BM_ManagerRouting(benchmark::State& state)
+{
+	StartManager(state.range(0));
+
+	auto record = Bench::MakeSmallRecord();
+	for (auto _ : state)
+		benchmark::DoNotOptimize(Logger::Manager::AddRecord(record));
+	state.SetItemsProcessed(state.iterations());
+
+	Logger::Manager::Stop();
+}
+BENCHMARK(BM_ManagerRouting)->ArgName("workers")->RangeMultiplier(2)->Range(1, 32);
+
+// Запись в локальный файл ошибок
+static void BM_ManagerSaveErrors(benchmark::State& state)
+{
+	const std::string file_name = ErrorFileName();
+	StartManager(1, file_name);
+
+	std::vector<Logger::RecordPtr> records;
+	for (int64_t i = 0; i < state.range(0); i++)
+		records.push_back(Bench::MakeLargeRecord());
+
+	for (auto _ : state)
+		Logger::Manager::SaveErrors(records, 503, "bench");
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+
+	Logger::Manager::Stop();
+	std::filesystem::remove(file_name);
+}
+BENCHMARK(BM_ManagerSaveErrors)->ArgName("records")->Arg(1)->Arg(100);
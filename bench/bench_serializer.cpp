@@ -0,0 +1,83 @@
+#include <benchmark/benchmark.h>
+
+#include "bench_common.h"
+#include "serializer.h"
+
+// Сериализация одной записи (режим concat_records = false)
+static void BM_SerializeRecord(benchmark::State& state)
+{
+	std::vector<Logger::RecordPtr> records = {state.range(0) ? Bench::MakeLargeRecord() : Bench::MakeSmallRecord()};
+	size_t bytes = 0;
+	for (auto _ : state)
+	{
+		auto data = Logger::SerializeRecords(records);
+		bytes += data.size();
+		benchmark::DoNotOptimize(data);
+	}
+	state.SetItemsProcessed(state.iterations());
+	state.SetBytesProcessed(bytes);
+}
+BENCHMARK(BM_SerializeRecord)->ArgName("large")->Arg(0)->Arg(1);
+
+// Сериализация пакета записей (режим concat_records = true)
+static void BM_SerializeBatch(benchmark::State& state)
+{
+	std::vector<Logger::RecordPtr> records;
+	for (int64_t i = 0; i < state.range(0); i++)
+		records.push_back(Bench::MakeLargeRecord());
+
+	size_t bytes = 0;
+	for (auto _ : state)
+	{
+		auto data = Logger::SerializeRecords(records);
+		bytes += data.size();
+		benchmark::DoNotOptimize(data);
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+	state.SetBytesProcessed(bytes);
+}
+BENCHMARK(BM_SerializeBatch)->ArgName("batch")->Arg(10)->Arg(100)->Arg(1000);
+
+// Сериализация пакета записей с постоянными полями: в каждой записи или из шаблона (RecordTemplate)
+static void BM_SerializeTemplate(benchmark::State& state)
+{
+	auto record_template = std::make_shared<Logger::RecordTemplate>(
+		"WBA", "DEMO", "WBA", std::map<std::string, std::string> {{"User-Agent", "PostmanRuntime/7.29.0"}, {"X-Request-Source", "мобильное приложение"}});
+
+	std::vector<Logger::RecordPtr> records;
+	for (int i = 0; i < 100; i++)
+	{
+		auto r = state.range(0) ? std::make_shared<Logger::Record>(record_template) : std::make_shared<Logger::Record>();
+		if (!state.range(0))
+		{
+			r->service = record_template->Service();
+			r->source = record_template->Source();
+			r->category = record_template->Category();
+			r->httpHeaders = record_template->HttpHeaders();
+		}
+		r->level = "INFO";
+		r->info = "short message";
+		records.push_back(r);
+	}
+
+	size_t bytes = 0;
+	for (auto _ : state)
+	{
+		auto data = Logger::SerializeRecords(records);
+		bytes += data.size();
+		benchmark::DoNotOptimize(data);
+	}
+	state.SetItemsProcessed(state.iterations() * records.size());
+	state.SetBytesProcessed(bytes);
+}
+BENCHMARK(BM_SerializeTemplate)->ArgName("template")->Arg(0)->Arg(1);
+
+// Форматирование времени записи
+static void BM_FormatLogTime(benchmark::State& state)
+{
+	auto time = Logger::Clock::Now();
+	for (auto _ : state)
+		benchmark::DoNotOptimize(Logger::FormatLogTime(time));
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_FormatLogTime);
@@ -0,0 +1,88 @@
+#include <benchmark/benchmark.h>
+
+#include <filesystem>
+#include <thread>
+
+#include <httplib.h>
+
+#include "bench_common.h"
+#include "file_sink.h"
+#include "http_sink.h"
+#include "serializer.h"
+
+// Запись пакетов в NDJSON файл
+static void BM_FileSinkWrite(benchmark::State& state)
+{
+	const std::string file_name = (std::filesystem::temp_directory_path() / "loglib-bench-sink.ndjson").string();
+	std::filesystem::remove(file_name);
+
+	const size_t count = state.range(0);
+	Logger::FileSinkOptions options;
+	options.direct_io = state.range(1) != 0;
+	// ротация ограничивает размер файла во время длительного измерения
+	options.rotate_bytes = 256 << 20;
+	options.max_files = 1;
+	auto sink = std::make_shared<Logger::FileSink>(file_name, options);
+
+	std::vector<Logger::RecordPtr> records(count, Bench::MakeLargeRecord());
+	for (auto _ : state)
+		benchmark::DoNotOptimize(sink->Process(records));
+
+	state.SetItemsProcessed(state.iterations() * count);
+	state.SetBytesProcessed(sink->BytesWritten());
+
+	sink.reset();
+	for (auto& entry : std::filesystem::directory_iterator(std::filesystem::temp_directory_path()))
+	{
+		if (entry.path().filename().string().rfind("loglib-bench-sink.ndjson", 0) == 0)
+			std::filesystem::remove(entry.path());
+	}
+}
+BENCHMARK(BM_FileSinkWrite)->ArgNames({"records", "direct"})->ArgsProduct({{1, 1000}, {0, 1}});
+
+// Отправка пакета из 100 записей на локальный HTTP сервер из нескольких обработчиков:
+// новое соединение httplib на каждый запрос или цикл событий с постоянными соединениями
+static void BM_HttpSinkSend(benchmark::State& state)
+{
+	static httplib::Server* server = nullptr;
+	static std::thread* server_thread = nullptr;
+	static std::shared_ptr<Logger::HttpSink> sink;
+
+	if (state.thread_index() == 0)
+	{
+		server = new httplib::Server();
+		server->set_keep_alive_max_count(1000000);
+		server->Post("/api/add", [](const httplib::Request&, httplib::Response& res) { res.status = 201; });
+		int port = server->bind_to_any_port("127.0.0.1");
+		server_thread = new std::thread([]() { server->listen_after_bind(); });
+
+		Logger::EventLoopOptions event_loop;
+		event_loop.enabled = state.range(0) != 0;
+		sink = std::make_shared<Logger::HttpSink>(Bench::kToken, std::vector<Logger::Endpoint> {{"127.0.0.1", (uint16_t)port}},
+												  Logger::EndpointPoolOptions {}, true, 0, Logger::SinkOptions {}, 0, event_loop);
+	}
+
+	Logger::SerializedBatch batch;
+	for (int i = 0; i < 100; i++)
+		batch.Append(Logger::SerializeRecord(*Bench::MakeLargeRecord()));
+
+	size_t failed = 0;
+	for (auto _ : state)
+	{
+		if (!sink->Process(batch).ok)
+			failed++;
+	}
+	state.SetItemsProcessed(state.iterations() * 100);
+	state.counters["failed"] = benchmark::Counter((double)failed, benchmark::Counter::kAvgThreads);
+
+	if (state.thread_index() == 0)
+	{
+		state.counters["connects"] = (double)sink->GetEventLoopStats().connects;
+		sink.reset();
+		server->stop();
+		server_thread->join();
+		delete server_thread;
+		delete server;
+	}
+}
+BENCHMARK(BM_HttpSinkSend)->ArgName("event_loop")->Arg(0)->Arg(1)->ThreadRange(1, 8)->UseRealTime();
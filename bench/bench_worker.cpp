@@ -0,0 +1,79 @@
+#include <benchmark/benchmark.h>
+
+#include "bench_common.h"
+#include "worker.h"
+#include "file_sink.h"
+#include "pipeline.h"
+
+// Помещение записей в очередь обработчика и их извлечение (без отправки)
+static void BM_WorkerQueuePushDrain(benchmark::State& state)
+{
+	const size_t count = state.range(0);
+	// второй аргумент - размер буфера аварийного сохранения (сериализация записи при добавлении)
+	Logger::Worker worker(std::make_shared<Logger::MemorySink>(), count, 0, state.range(1));
+	auto record = Bench::MakeSmallRecord();
+
+	std::vector<Logger::RecordPtr> records;
+	records.reserve(count);
+	for (auto _ : state)
+	{
+		for (size_t i = 0; i < count; i++)
+			worker.AddRecord(record);
+
+		records.clear();
+		benchmark::DoNotOptimize(worker.TakeRecords(records, count));
+	}
+	state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_WorkerQueuePushDrain)->ArgNames({"records", "crash_buffer"})->ArgsProduct({{1, 100, 10000}, {0, 16 << 20}});
+
+// Добавление записей и обработка очереди с сериализацией: в обработчике или при добавлении (BatchOptions::pre_serialize).
+// queue_bytes - объем очереди на одну запись перед обработкой
+static void BM_WorkerSerialize(benchmark::State& state)
+{
+	const size_t count = 1000;
+	Logger::BatchOptions batch_options;
+	batch_options.pre_serialize = state.range(0) != 0;
+	// приемник с сериализацией записей, запись в /dev/null
+	auto sink = std::make_shared<Logger::FileSink>("/dev/null");
+	Logger::Worker worker(sink, count, 0, 0, 0, batch_options);
+	auto record = Bench::MakeLargeRecord();
+
+	double queue_bytes = 0;
+	for (auto _ : state)
+	{
+		for (size_t i = 0; i < count; i++)
+			worker.AddRecord(record);
+
+		queue_bytes = (double)worker.BufferBytes() / count;
+		worker.Flush();
+	}
+	state.SetItemsProcessed(state.iterations() * count);
+	state.counters["queue_bytes"] = queue_bytes;
+}
+BENCHMARK(BM_WorkerSerialize)->ArgName("pre_serialize")->Arg(0)->Arg(1);
+
+// Обработка очереди с измерением задержки по этапам (LatencyOptions) и без него.
+// Второй аргумент - источник времени (Logger::ClockSource)
+static void BM_WorkerLatency(benchmark::State& state)
+{
+	const size_t count = 1000;
+	Logger::Clock::SetSource((Logger::ClockSource)state.range(1));
+	Logger::Pipeline pipeline;
+	Logger::LatencyOptions latency;
+	latency.enabled = state.range(0) != 0;
+	latency.sample_every = 100;
+	pipeline.SetLatencyOptions(latency);
+
+	Logger::Worker worker(std::make_shared<Logger::MemorySink>(), count, 0, 0, 0, {}, &pipeline);
+	auto record = Bench::MakeSmallRecord();
+	for (auto _ : state)
+	{
+		for (size_t i = 0; i < count; i++)
+			worker.AddRecord(record);
+		worker.Flush();
+	}
+	state.SetItemsProcessed(state.iterations() * count);
+	Logger::Clock::SetSource(Logger::ClockSource::System);
+}
+BENCHMARK(BM_WorkerLatency)->ArgNames({"latency", "clock"})->ArgsProduct({{0, 1}, {0, 1, 2}});
@@ -0,0 +1,4 @@
+#include <benchmark/benchmark.h>
+
+// Результаты для отслеживания регрессий: loglib-bench --benchmark_out=result.json --benchmark_out_format=json
+BENCHMARK_MAIN();
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <cstdlib>
+
+namespace Tools
+{
+
+//! Распределение случайной величины для нагрузочных утилит (задержки, размеры записей)
+struct Distribution
+{
+	enum class Type
+	{
+		None,
+		Fixed,
+		Uniform,
+		Normal,
+		Exponential,
+	};
+
+	Type type = Type::None;
+	double a = 0;
+	double b = 0;
+
+	//! Формат: fixed:MS | uniform:MIN:MAX | normal:MEAN:STDDEV | exp:MEAN
+	static bool Parse(const std::string& text, Distribution& d)
+	{
+		std::vector<std::string> parts;
+		size_t begin = 0;
+		while (true)
+		{
+			size_t end = text.find(':', begin);
+			parts.push_back(text.substr(begin, end == std::string::npos ? std::string::npos : end - begin));
+			if (end == std::string::npos)
+				break;
+			begin = end + 1;
+		}
+
+		auto number = [&](size_t i) { return i < parts.size() ? std::atof(parts.at(i).c_str()) : 0.0; };
+
+		if (parts.at(0) == "none")
+			d.type = Type::None;
+		else if (parts.at(0) == "fixed" && parts.size() == 2)
+			d.type = Type::Fixed;
+		else if (parts.at(0) == "uniform" && parts.size() == 3)
+			d.type = Type::Uniform;
+		else if (parts.at(0) == "normal" && parts.size() == 3)
+			d.type = Type::Normal;
+		else if (parts.at(0) == "exp" && parts.size() == 2)
+			d.type = Type::Exponential;
+		else
+			return false;
+
+		d.a = number(1);
+		d.b = number(2);
+		return true;
+	}
+
+	double Sample(std::mt19937_64& rng) const
+	{
+		switch (type)
+		{
+			case Type::None:
+				return 0;
+			case Type::Fixed:
+				return a;
+			case Type::Uniform:
+				return std::uniform_real_distribution<double>(a, b)(rng);
+			case Type::Normal:
+				return std::max(0.0, std::normal_distribution<double>(a, b)(rng));
+			case Type::Exponential:
+				return a > 0 ? std::exponential_distribution<double>(1.0 / a)(rng) : 0;
+		}
+		return 0;
+	}
+};
+
+} // namespace Tools
@@ -1,72 +1,84 @@
+// Генератор нагрузки для подбора параметров Manager (workers_count, packet_size, max_buffer_size)
+// Работает в открытом цикле: записи добавляются с заданной частотой независимо от того, успевает ли библиотека
+
 #include <iostream>
+#include <fstream>
+#include <sstream>
 #include <thread>
+#include <atomic>
+#include <mutex>
+#include <deque>
+#include <ctime>
 #include <fmtlib/format.h>
+#include <json.hpp>
 
 #include "manager.h"
+#include "file_sink.h"
+#include "clock.h"
+#include "distribution.h"
+#include "histogram.h"
 
-#define TEST 0
-
-void errorFunc(const std::string& error)
+namespace
 {
-	static std::mutex m;
-	m.lock();
-	std::cerr << error << std::endl;
-	m.unlock();
-}
 
-int main()
+struct Options
 {
 	// настройки менеджера логов
-	const size_t auto_flush_size = 1000; // после какого размера очереди в буфере воркеры логов начнут принудительно слать их нас сервер
-	const size_t packet_size = auto_flush_size; // сколько записей максимум можно слать за один раз
-#if TEST
-	const size_t work_thread_count = 1;
-#else
-	const size_t work_thread_count =  (size_t)std::thread::hardware_concurrency() / 2; // количество потоков на обработку логов
-#endif                                                                                                                                                                                                                                                   \
-	// Максимальный размер буфера, при котором новые записи будут отбрасываться. Необходимо для исключения переполнения памяти в случае,
-	// когда количество вызовов AddRecord превышает скорость обработки буфера
-	size_t max_buffer_size = work_thread_count * auto_flush_size;
-	const bool concat_records = true; // упаковывать ли несколько записей в один json. отключение только для тестирования
-	const std::string token = "dbda0fba4da680c615340d6faa2868eb5413c3b837640078b87149872257f842";
+	std::string host = "localhost";
+	int port = 8080;
+	std::string token = "dbda0fba4da680c615340d6faa2868eb5413c3b837640078b87149872257f842";
+	size_t workers = std::max<size_t>(1, std::thread::hardware_concurrency() / 2); // количество потоков на обработку логов
+	size_t packet_size = 1000; // сколько записей максимум можно слать за один раз
+	size_t flush_buffer_size = 1000; // после какого размера очереди в буфере воркеры логов начнут принудительно слать их нас сервер
+	size_t max_buffer_size = 0; // если 0, то workers * flush_buffer_size
+	size_t max_buffer_bytes = 0; // ограничение объема очередей в байтах, 0 - без ограничения
+	size_t flush_buffer_bytes = 0; // объем очереди обработчика, после которого она сбрасывается принудительно, 0 - никогда
+	size_t max_batch_bytes = 4 << 20; // максимальный размер тела запроса, 0 - без ограничения
+	size_t stream_chunk_bytes = 0; // потоковая отправка пакетов частями указанного размера, 0 - пакет сериализуется целиком
+	bool pre_serialize = false; // сериализация записей при добавлении
+	bool record_template = false; // постоянные поля записей из шаблона (RecordTemplate)
+	std::string clock = "system"; // источник времени записей: system | coarse | tsc
+	bool deferred_time = false; // время записи фиксируется при добавлении в очередь
+	bool latency = false; // измерение задержки по этапам (LatencyOptions)
+	size_t trace_every = 0; // трассировка каждой N-й записи, 0 - отключена
+	int block_ms = 0; // ожидание места в буфере при добавлении записи, 0 - запись отбрасывается сразу
+	size_t event_loop = 0; // потоков цикла событий для отправки запросов, 0 - запросы отправляют обработчики
+	size_t connections = 64; // соединений потока цикла событий с одним узлом
+	size_t pending = 8; // пакетов обработчика, ожидающих ответа через цикл событий
+	int steal_ms = 0; // через сколько отправки обработчика его очередь разбирают другие обработчики, 0 - отключено
+	bool adaptive_batch = false; // подбор количества записей в пакете по времени ответа
+	int target_latency_ms = 200; // время ответа, при превышении которого пакет уменьшается
+	size_t max_workers = 0; // если больше workers, то включается автоматическое масштабирование в диапазоне [workers, max_workers]
+	bool concat_records = true; // упаковывать ли несколько записей в один json. отключение только для тестирования
+	std::string error_file;
+	std::string endpoints; // host:port[:weight],... вместо host и port
+	std::string balancing = "rr"; // rr | least
+	std::string sink = "http"; // http | memory | stdout | file:PATH
 
 	// настройки теста
-#if TEST
-	const size_t test_thread_count = 1;
-#else
-	const size_t test_thread_count = (size_t)std::thread::hardware_concurrency() / 2; // количество клиентов, которые параллельно пишут логи
-#endif
-	const size_t sleep_rate_ms = 10;
-	const size_t sleep_pow = 2; // настройка авторегулирования притормаживания клиентов чтобы они не забили буфер менеджера логов
-	const size_t seconds = 0; // длительность теста
-
-	Logger::Manager::Start(token, "localhost", 8080, work_thread_count, packet_size, auto_flush_size, max_buffer_size, concat_records, "");
-	Logger::Manager::SetErrorFunc(errorFunc, std::chrono::seconds(1));
-	Logger::Manager::EnableRPS(true);
+	size_t producers = std::max<size_t>(1, std::thread::hardware_concurrency() / 2); // количество клиентов, которые параллельно пишут логи
+	double rate = 0; // суммарное количество записей в секунду, 0 - без ограничения
+	Tools::Distribution info_size; // размер поля info в байтах; none - текст из demo
+	bool body = true; // добавлять json тело из demo
+	double duration = 10; // длительность измерения в секундах, 0 - бесконечно
+	double warmup = 2; // длительность прогрева в секундах
 
-	std::atomic<unsigned long long> num = 0;
-	std::atomic_bool to_stop = false;
-	std::vector<std::thread*> test_threads;
-	std::atomic<size_t> sleep_rate_sum = 0;
-	std::atomic<size_t> sleep_rate_count = 0;
+	std::string format = "text";
+	std::string output;
+};
 
-	for (size_t i = 0; i < test_thread_count; i++)
-	{
-		test_threads.push_back(new std::thread([&]() {
-			while (!to_stop)
-			{
-				auto r = std::make_shared<Logger::Record>();
-				r->service = "WBA";
-				r->source = "DEMO";
-				r->category = "WBA";
-				r->level = "INFO";
-				r->session = "";
-				r->info = "произвольная информация для поиска через регулярные выражения";
-				r->url = "github.com/jackc/pgx/issues/771";
-				r->httpType = "POST";
-				r->properties = {{"idOrder", "123"}, {"idProject", "541"}};
-				r->httpHeaders = {{"User-Agent", "PostmanRuntime/7.29.0"}};
-				r->jsonBody =
+//! Статистика одного клиента. Заполняется только во время измерения
+struct ProducerStats
+{
+	Logger::Histogram add_latency; // длительность вызова AddRecord
+	Logger::Histogram sched_latency; // от запланированного момента до завершения AddRecord
+	uint64_t added = 0;
+	uint64_t dropped = 0;
+	uint64_t bytes = 0;
+	uint64_t cpu_ns = 0;
+};
+
+const char* kDemoBody =
 R"(
 {
     "id": "4286",
@@ -115,37 +127,701 @@ R"(
 }
 )";
 
-				Logger::Manager::AddRecord(r);
+Options options;
 
-				size_t total = Logger::Manager::BufferSize();
-				size_t sleep_rate = (double)(pow(total, sleep_pow) * sleep_rate_ms) / (double)(auto_flush_size * test_thread_count);
-				std::this_thread::sleep_for(std::chrono::milliseconds(sleep_rate));
+uint64_t CpuTimeNs(clockid_t clock)
+{
+	timespec ts {};
+	clock_gettime(clock, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
 
-				sleep_rate_sum += sleep_rate;
-				sleep_rate_count++;
+void errorFunc(const std::string& error)
+{
+	static std::mutex m;
+	m.lock();
+	std::cerr << error << std::endl;
+	m.unlock();
+}
+
+Logger::RecordPtr MakeRecord(std::mt19937_64& rng)
+{
+	static const auto record_template =
+		std::make_shared<Logger::RecordTemplate>("WBA", "DEMO", "WBA", std::map<std::string, std::string> {{"User-Agent", "PostmanRuntime/7.29.0"}});
+
+	Logger::RecordPtr r;
+	if (options.record_template)
+	{
+		r = std::make_shared<Logger::Record>(record_template);
+	}
+	else
+	{
+		r = std::make_shared<Logger::Record>();
+		r->service = record_template->Service();
+		r->source = record_template->Source();
+		r->category = record_template->Category();
+		r->httpHeaders = record_template->HttpHeaders();
+	}
+	r->level = "INFO";
+	r->session = "";
+	if (options.info_size.type == Tools::Distribution::Type::None)
+		r->info = "произвольная информация для поиска через регулярные выражения";
+	else
+		r->info.assign((size_t)options.info_size.Sample(rng), 'x');
+	r->url = "github.com/jackc/pgx/issues/771";
+	r->httpType = "POST";
+	r->properties = {{"idOrder", "123"}, {"idProject", "541"}};
+	if (options.body)
+		r->jsonBody = kDemoBody;
+	return r;
+}
 
-				num++;
+const char* PressureName(Logger::PressureLevel level)
+{
+	switch (level)
+	{
+		case Logger::PressureLevel::Green:
+			return "green";
+		case Logger::PressureLevel::Yellow:
+			return "yellow";
+		case Logger::PressureLevel::Red:
+			return "red";
+	}
+	return "";
+}
+
+void PrintUsage()
+{
+	std::cout << "loglib-demo [options]\n"
+				 "  --host=HOST                logsrv host (localhost)\n"
+				 "  --port=N                   logsrv port (8080)\n"
+				 "  --token=TOKEN              access token\n"
+				 "  --workers=N                workers_count (hardware_concurrency / 2)\n"
+				 "  --packet-size=N            packet_size (1000)\n"
+				 "  --flush-buffer-size=N      flush_buffer_size (1000)\n"
+				 "  --max-buffer-size=N        max_buffer_size (workers * flush_buffer_size)\n"
+				 "  --max-buffer-bytes=N       max_buffer_bytes (unlimited)\n"
+				 "  --flush-buffer-bytes=N     flush_buffer_bytes (never)\n"
+				 "  --max-batch-bytes=N        max request body size (4194304, 0 = unlimited)\n"
+				 "  --stream-chunk=N           stream request bodies in N-byte chunks (0 = off)\n"
+				 "  --pre-serialize=0|1        serialize records in AddRecord (0)\n"
+				 "  --template=0|1             constant fields from a RecordTemplate (0)\n"
+				 "  --clock=system|coarse|tsc  record time source (system)\n"
+				 "  --deferred-time=0|1        capture record time on enqueue (0)\n"
+				 "  --latency=0|1              measure per-stage delivery latency by service and level (0)\n"
+				 "  --trace-every=N            trace stage timings of every N-th record, implies --latency (0 = off)\n"
+				 "  --block=MS                 wait up to MS for buffer space instead of dropping records (0)\n"
+				 "  --event-loop=N             send requests from N epoll threads over keep-alive connections (0 = off)\n"
+				 "  --connections=N            event loop connections per endpoint and thread (64)\n"
+				 "  --pending=N                event loop batches per worker awaiting a response (8)\n"
+				 "  --steal=MS                 idle workers take batches from a worker stuck sending for MS (0 = off)\n"
+				 "  --adaptive-batch=0|1       tune records per batch by response time (0)\n"
+				 "  --target-latency=MS        response time target for adaptive batches (200)\n"
+				 "  --max-workers=N            autoscale workers in [workers, N] (disabled)\n"
+				 "  --concat=0|1               concat_records (1)\n"
+				 "  --error-file=FILE          error_file_name\n"
+				 "  --endpoints=LIST           host:port[:weight],... instead of host and port\n"
+				 "  --balancing=rr|least       endpoint balancing (rr)\n"
+				 "  --sink=SINK                http | memory | stdout | file:PATH (http)\n"
+				 "  --producers=N              producer threads (hardware_concurrency / 2)\n"
+				 "  --rate=N                   total records per second, open loop (0 = unlimited)\n"
+				 "  --info-size=DIST           info size in bytes: fixed:N | uniform:MIN:MAX | normal:MEAN:STDDEV | exp:MEAN\n"
+				 "  --body=0|1                 add demo json body (1)\n"
+				 "  --duration=SEC             measurement duration, 0 = endless (10)\n"
+				 "  --warmup=SEC               warmup duration (2)\n"
+				 "  --format=text|csv|json     report format (text)\n"
+				 "  --output=FILE              report file (stdout)\n";
+}
+
+bool ParseOptions(int argc, char* argv[])
+{
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		size_t eq = arg.find('=');
+		std::string key = arg.substr(0, eq);
+		std::string value = eq == std::string::npos ? "" : arg.substr(eq + 1);
+
+		if (key == "--host")
+			options.host = value;
+		else if (key == "--port")
+			options.port = std::atoi(value.c_str());
+		else if (key == "--token")
+			options.token = value;
+		else if (key == "--workers")
+			options.workers = std::max<size_t>(1, std::strtoul(value.c_str(), nullptr, 10));
+		else if (key == "--packet-size")
+			options.packet_size = std::max<size_t>(1, std::strtoul(value.c_str(), nullptr, 10));
+		else if (key == "--flush-buffer-size")
+			options.flush_buffer_size = std::strtoul(value.c_str(), nullptr, 10);
+		else if (key == "--max-buffer-size")
+			options.max_buffer_size = std::strtoul(value.c_str(), nullptr, 10);
+		else if (key == "--max-buffer-bytes")
+			options.max_buffer_bytes = std::strtoull(value.c_str(), nullptr, 10);
+		else if (key == "--flush-buffer-bytes")
+			options.flush_buffer_bytes = std::strtoull(value.c_str(), nullptr, 10);
+		else if (key == "--max-batch-bytes")
+			options.max_batch_bytes = std::strtoull(value.c_str(), nullptr, 10);
+		else if (key == "--stream-chunk")
+			options.stream_chunk_bytes = std::strtoull(value.c_str(), nullptr, 10);
+		else if (key == "--pre-serialize")
+			options.pre_serialize = value != "0";
+		else if (key == "--template")
+			options.record_template = value != "0";
+		else if (key == "--clock" && (value == "system" || value == "coarse" || value == "tsc"))
+			options.clock = value;
+		else if (key == "--deferred-time")
+			options.deferred_time = value != "0";
+		else if (key == "--latency")
+			options.latency = value != "0";
+		else if (key == "--trace-every")
+			options.trace_every = std::strtoul(value.c_str(), nullptr, 10);
+		else if (key == "--block")
+			options.block_ms = std::atoi(value.c_str());
+		else if (key == "--event-loop")
+			options.event_loop = std::strtoul(value.c_str(), nullptr, 10);
+		else if (key == "--connections")
+			options.connections = std::max<size_t>(1, std::strtoul(value.c_str(), nullptr, 10));
+		else if (key == "--pending")
+			options.pending = std::max<size_t>(1, std::strtoul(value.c_str(), nullptr, 10));
+		else if (key == "--steal")
+			options.steal_ms = std::atoi(value.c_str());
+		else if (key == "--adaptive-batch")
+			options.adaptive_batch = value != "0";
+		else if (key == "--target-latency")
+			options.target_latency_ms = std::atoi(value.c_str());
+		else if (key == "--max-workers")
+			options.max_workers = std::strtoul(value.c_str(), nullptr, 10);
+		else if (key == "--concat")
+			options.concat_records = value != "0";
+		else if (key == "--error-file")
+			options.error_file = value;
+		else if (key == "--endpoints")
+			options.endpoints = value;
+		else if (key == "--balancing" && (value == "rr" || value == "least"))
+			options.balancing = value;
+		else if (key == "--sink" && (value == "http" || value == "memory" || value == "stdout" || value.rfind("file:", 0) == 0))
+			options.sink = value;
+		else if (key == "--producers")
+			options.producers = std::max<size_t>(1, std::strtoul(value.c_str(), nullptr, 10));
+		else if (key == "--rate")
+			options.rate = std::atof(value.c_str());
+		else if (key == "--info-size")
+		{
+			if (!Tools::Distribution::Parse(value, options.info_size))
+			{
+				std::cerr << "invalid size distribution: " << value << std::endl;
+				return false;
 			}
-		}));
+		}
+		else if (key == "--body")
+			options.body = value != "0";
+		else if (key == "--duration")
+			options.duration = std::atof(value.c_str());
+		else if (key == "--warmup")
+			options.warmup = std::atof(value.c_str());
+		else if (key == "--format" && (value == "text" || value == "csv" || value == "json"))
+			options.format = value;
+		else if (key == "--output")
+			options.output = value;
+		else
+		{
+			PrintUsage();
+			return false;
+		}
 	}
 
-	auto begin = std::chrono::steady_clock::now();
-	while (seconds == 0 || std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now() - begin).count() < seconds)
+	if (options.max_buffer_size == 0)
+		options.max_buffer_size = std::max(options.workers, options.max_workers) * options.flush_buffer_size;
+
+	return true;
+}
+
+//! Оценка задержки доставки: библиотека не сообщает о доставке отдельных записей, поэтому сопоставляем
+//! момент, когда счетчик отправленных записей достиг N, с моментом, когда было добавлено N записей (FIFO приближение)
+class DeliveryTracker
+{
+public:
+	void Sample(uint64_t added, uint64_t processed, std::chrono::steady_clock::time_point now, bool measuring)
 	{
-		std::this_thread::sleep_for(std::chrono::milliseconds(1000));
-		std::cout << fmt::format("RPC: {}. Total record created: {}. Sleep rate: {}. Buffer size: {}",
-								 Logger::Manager::RPS(),
-								 Logger::Manager::TotalProcessed(),
-								 sleep_rate_count > 0 ? sleep_rate_sum / sleep_rate_count : 0, Logger::Manager::BufferSize()) << std::endl;
+		_timeline.push_back({added, now});
+
+		if (processed > _last_processed && measuring)
+		{
+			auto it = std::lower_bound(_timeline.begin(), _timeline.end(), processed, [](const Point& p, uint64_t v) { return p.count < v; });
+			if (it != _timeline.end())
+				_latency.Add((uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(now - it->time).count(), processed - _last_processed);
+		}
+		_last_processed = processed;
+
+		// счетчик отправленных только растет, поэтому точки до него больше не понадобятся
+		while (!_timeline.empty() && _timeline.front().count < processed)
+			_timeline.pop_front();
 	}
 
-	to_stop = true;
-	for (size_t i = 0; i < test_thread_count; i++)
+	const Logger::Histogram& Latency() const { return _latency; }
+
+private:
+	struct Point
+	{
+		uint64_t count;
+		std::chrono::steady_clock::time_point time;
+	};
+
+	std::deque<Point> _timeline;
+	uint64_t _last_processed = 0;
+	Logger::Histogram _latency;
+};
+
+struct Report
+{
+	double seconds = 0;
+	uint64_t added = 0;
+	uint64_t dropped = 0;
+	uint64_t delivered = 0;
+	uint64_t bytes = 0;
+	double process_cpu_us_per_record = 0;
+	double producer_cpu_us_per_record = 0;
+	Logger::Histogram add_latency;
+	Logger::Histogram sched_latency;
+	Logger::Histogram delivery_latency;
+	//! Измеренные задержки по этапам (--latency), микросекунды
+	std::vector<Logger::LatencyStats> stages;
+	std::vector<Logger::RecordTrace> traces;
+};
+
+void WriteReport(const Report& r, std::ostream& out)
+{
+	auto us = [](uint64_t ns) { return (double)ns / 1000.0; };
+	const double percentiles[] = {50, 90, 99, 99.9};
+
+	if (options.format == "json")
+	{
+		auto histogram = [&](const Logger::Histogram& h) {
+			auto j = nlohmann::json::object();
+			j["count"] = h.Count();
+			j["mean_us"] = us((uint64_t)h.Mean());
+			for (double p : percentiles)
+				j[fmt::format("p{}_us", p)] = us(h.Percentile(p));
+			j["max_us"] = us(h.Max());
+			return j;
+		};
+
+		auto j = nlohmann::json::object();
+		j["workers"] = options.workers;
+		j["packet_size"] = options.packet_size;
+		j["flush_buffer_size"] = options.flush_buffer_size;
+		j["max_buffer_size"] = options.max_buffer_size;
+		j["producers"] = options.producers;
+		j["target_rate"] = options.rate;
+		j["seconds"] = r.seconds;
+		j["added"] = r.added;
+		j["dropped"] = r.dropped;
+		j["delivered"] = r.delivered;
+		j["added_per_second"] = r.added / r.seconds;
+		j["delivered_per_second"] = r.delivered / r.seconds;
+		j["mb_per_second"] = r.bytes / r.seconds / (1024 * 1024);
+		j["process_cpu_us_per_record"] = r.process_cpu_us_per_record;
+		j["producer_cpu_us_per_record"] = r.producer_cpu_us_per_record;
+		j["add_latency"] = histogram(r.add_latency);
+		j["scheduled_add_latency"] = histogram(r.sched_latency);
+		j["delivery_latency"] = histogram(r.delivery_latency);
+		if (!r.stages.empty())
+		{
+			// гистограммы этапов в микросекундах, а histogram() ожидает наносекунды
+			auto stage = [&](const Logger::Histogram& h) {
+				auto s = nlohmann::json::object();
+				s["count"] = h.Count();
+				s["mean_us"] = h.Mean();
+				for (double p : percentiles)
+					s[fmt::format("p{}_us", p)] = h.Percentile(p);
+				s["max_us"] = h.Max();
+				return s;
+			};
+			auto stages = nlohmann::json::array();
+			for (auto& st : r.stages)
+				stages.push_back({{"service", st.service}, {"level", st.level}, {"failed", st.failed}, {"enqueue", stage(st.enqueue)},
+								  {"queue", stage(st.queue)}, {"send", stage(st.send)}, {"total", stage(st.total)}});
+			j["stage_latency"] = stages;
+		}
+		out << j.dump(4) << std::endl;
+		return;
+	}
+
+	if (options.format == "csv")
 	{
-		test_threads.at(i)->join();
+		out << "workers,packet_size,flush_buffer_size,max_buffer_size,producers,target_rate,seconds,added,dropped,delivered,"
+			   "process_cpu_us_per_record,producer_cpu_us_per_record";
+		for (const char* name : {"add", "sched", "delivery"})
+			out << fmt::format(",{0}_p50_us,{0}_p90_us,{0}_p99_us,{0}_p999_us,{0}_max_us", name);
+		out << "\n";
+
+		out << fmt::format("{},{},{},{},{},{},{:.3f},{},{},{},{:.3f},{:.3f}",
+						   options.workers,
+						   options.packet_size,
+						   options.flush_buffer_size,
+						   options.max_buffer_size,
+						   options.producers,
+						   options.rate,
+						   r.seconds,
+						   r.added,
+						   r.dropped,
+						   r.delivered,
+						   r.process_cpu_us_per_record,
+						   r.producer_cpu_us_per_record);
+		for (auto h : {&r.add_latency, &r.sched_latency, &r.delivery_latency})
+		{
+			for (double p : percentiles)
+				out << fmt::format(",{:.1f}", us(h->Percentile(p)));
+			out << fmt::format(",{:.1f}", us(h->Max()));
+		}
+		out << std::endl;
+		return;
 	}
 
+	out << fmt::format("duration: {:.1f}s, added: {} ({:.0f}/s), dropped: {}, delivered: {} ({:.0f}/s), {:.2f} MB/s",
+					   r.seconds,
+					   r.added,
+					   r.added / r.seconds,
+					   r.dropped,
+					   r.delivered,
+					   r.delivered / r.seconds,
+					   r.bytes / r.seconds / (1024 * 1024))
+		<< std::endl;
+	out << fmt::format("cpu per record: process {:.2f} us, producers {:.2f} us", r.process_cpu_us_per_record, r.producer_cpu_us_per_record) << std::endl;
+	for (auto [name, h] : {std::make_pair("AddRecord", &r.add_latency), std::make_pair("AddRecord (scheduled)", &r.sched_latency),
+						   std::make_pair("delivery (estimated)", &r.delivery_latency)})
+	{
+		out << fmt::format("{} latency us: p50 {:.1f}, p90 {:.1f}, p99 {:.1f}, p99.9 {:.1f}, max {:.1f}",
+						   name,
+						   us(h->Percentile(50)),
+						   us(h->Percentile(90)),
+						   us(h->Percentile(99)),
+						   us(h->Percentile(99.9)),
+						   us(h->Max()))
+			<< std::endl;
+	}
+
+	for (auto& st : r.stages)
+	{
+		out << fmt::format("{} {} ({} records, {} failed):", st.service, st.level, st.total.Count(), st.failed) << std::endl;
+		for (auto [name, h] : {std::make_pair("enqueue", &st.enqueue), std::make_pair("queue", &st.queue), std::make_pair("send", &st.send),
+							   std::make_pair("total", &st.total)})
+		{
+			out << fmt::format("  {} latency us: p50 {}, p90 {}, p99 {}, p99.9 {}, max {}",
+							   name,
+							   h->Percentile(50),
+							   h->Percentile(90),
+							   h->Percentile(99),
+							   h->Percentile(99.9),
+							   h->Max())
+				<< std::endl;
+		}
+	}
+
+	// последние трассировки: смещение этапов от создания записи
+	const size_t first_trace = r.traces.size() > 5 ? r.traces.size() - 5 : 0;
+	for (size_t i = first_trace; i < r.traces.size(); i++)
+	{
+		auto& t = r.traces.at(i);
+		auto since = [&](Logger::RecordTime time) { return (time - t.created).count(); };
+		out << fmt::format("trace {} {}: enqueued +{} us, serialized +{} us, dequeued +{} us, acked +{} us{}",
+						   t.service,
+						   t.level,
+						   since(t.enqueued),
+						   since(t.serialized),
+						   since(t.dequeued),
+						   since(t.acked),
+						   t.ok ? "" : " (failed)")
+			<< std::endl;
+	}
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+	if (!ParseOptions(argc, argv))
+		return 1;
+
+	if (options.max_workers > options.workers)
+	{
+		Logger::ScalingOptions scaling;
+		scaling.enabled = true;
+		scaling.min_workers = options.workers;
+		scaling.max_workers = options.max_workers;
+		Logger::Manager::SetScaling(scaling);
+	}
+
+	auto clock = options.clock == "tsc" ? Logger::ClockSource::Tsc : options.clock == "coarse" ? Logger::ClockSource::Coarse : Logger::ClockSource::System;
+	if (Logger::Clock::SetSource(clock) != clock)
+		std::cerr << "clock source is not supported: " << options.clock << std::endl;
+	Logger::Clock::SetDeferredCapture(options.deferred_time);
+
+	if (options.event_loop > 0)
+	{
+		Logger::EventLoopOptions event_loop;
+		event_loop.enabled = true;
+		event_loop.threads = options.event_loop;
+		event_loop.max_connections = options.connections;
+		event_loop.max_pending_batches = options.pending;
+		Logger::Manager::SetEventLoop(event_loop);
+	}
+
+	if (options.steal_ms > 0)
+	{
+		Logger::StealingOptions stealing;
+		stealing.enabled = true;
+		stealing.stall = std::chrono::milliseconds(options.steal_ms);
+		Logger::Manager::SetStealing(stealing);
+	}
+
+	Logger::LatencyOptions latency;
+	latency.enabled = options.latency || options.trace_every > 0;
+	latency.sample_every = options.trace_every;
+	Logger::Manager::SetLatencyOptions(latency);
+
+	Logger::BackpressureOptions backpressure;
+	backpressure.on_change = [](Logger::PressureLevel level) { std::cerr << "pressure: " << PressureName(level) << std::endl; };
+	Logger::Manager::SetBackpressure(backpressure);
+
+	Logger::MemoryLimits limits;
+	limits.max_buffer_bytes = options.max_buffer_bytes;
+	limits.flush_buffer_bytes = options.flush_buffer_bytes;
+	Logger::Manager::SetMemoryLimits(limits);
+
+	Logger::BatchOptions batch;
+	batch.max_batch_bytes = options.max_batch_bytes;
+	batch.stream_chunk_bytes = options.stream_chunk_bytes;
+	batch.pre_serialize = options.pre_serialize;
+	batch.adaptive = options.adaptive_batch;
+	batch.target_latency = std::chrono::milliseconds(options.target_latency_ms);
+	Logger::Manager::SetBatchOptions(batch);
+
+	if (!options.endpoints.empty())
+	{
+		std::vector<Logger::Endpoint> endpoints;
+		std::stringstream list(options.endpoints);
+		for (std::string item; std::getline(list, item, ',');)
+		{
+			Logger::Endpoint e;
+			size_t colon = item.find(':');
+			e.host = item.substr(0, colon);
+			if (colon != std::string::npos)
+			{
+				e.port = (uint16_t)std::atoi(item.c_str() + colon + 1);
+				size_t weight = item.find(':', colon + 1);
+				if (weight != std::string::npos)
+					e.weight = (unsigned)std::atoi(item.c_str() + weight + 1);
+			}
+			endpoints.push_back(e);
+		}
+
+		Logger::EndpointPoolOptions pool;
+		pool.balancing = options.balancing == "least" ? Logger::Balancing::LeastOutstanding : Logger::Balancing::WeightedRoundRobin;
+		Logger::Manager::SetEndpoints(endpoints, pool);
+	}
+
+	// с приемником memory измеряется производительность очереди и обработчиков без сети
+	if (options.sink == "memory")
+		Logger::Manager::SetSinks({std::make_shared<Logger::MemorySink>()});
+	else if (options.sink == "stdout")
+		Logger::Manager::SetSinks({std::make_shared<Logger::StdoutSink>()});
+	else if (options.sink.rfind("file:", 0) == 0)
+		Logger::Manager::SetSinks({std::make_shared<Logger::FileSink>(options.sink.substr(5))});
+
+	Logger::Manager::Start(options.token, options.host, options.port, options.workers, options.packet_size, options.flush_buffer_size,
+						   options.max_buffer_size, options.concat_records, options.error_file);
+	Logger::Manager::SetErrorFunc(errorFunc, std::chrono::seconds(1));
+	Logger::Manager::EnableRPS(true);
+	Logger::Manager::WaitStart();
+
+	std::atomic_bool to_stop = false;
+	std::atomic_bool measuring = false;
+	std::atomic<uint64_t> added_total = 0;
+	std::vector<ProducerStats> producer_stats(options.producers);
+	std::vector<std::thread> producers;
+
+	const auto start_time = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < options.producers; i++)
+	{
+		producers.emplace_back([&, i]() {
+			ProducerStats& stats = producer_stats.at(i);
+			std::mt19937_64 rng(i);
+
+			const auto interval = options.rate > 0 ? std::chrono::duration<double>((double)options.producers / options.rate)
+												   : std::chrono::duration<double>::zero();
+			auto next = std::chrono::steady_clock::now();
+			bool was_measuring = false;
+			uint64_t cpu_start = 0;
+
+			while (!to_stop)
+			{
+				bool is_measuring = measuring;
+				if (is_measuring != was_measuring)
+				{
+					if (is_measuring)
+						cpu_start = CpuTimeNs(CLOCK_THREAD_CPUTIME_ID);
+					else
+						stats.cpu_ns = CpuTimeNs(CLOCK_THREAD_CPUTIME_ID) - cpu_start;
+					was_measuring = is_measuring;
+				}
+
+				// открытый цикл: момент добавления определяется расписанием, а не завершением предыдущего вызова
+				auto intended = std::chrono::steady_clock::now();
+				if (options.rate > 0)
+				{
+					next += std::chrono::duration_cast<std::chrono::steady_clock::duration>(interval);
+					if (next > intended)
+						std::this_thread::sleep_until(next);
+					intended = next;
+				}
+
+				auto record = MakeRecord(rng);
+				size_t size = record->info.size() + record->jsonBody.size();
+
+				auto begin = std::chrono::steady_clock::now();
+				bool ok = options.block_ms > 0 ? Logger::Manager::AddRecord(record, std::chrono::milliseconds(options.block_ms))
+											   : Logger::Manager::AddRecord(record);
+				auto end = std::chrono::steady_clock::now();
+				if (ok)
+					added_total++;
+
+				if (!is_measuring)
+					continue;
+
+				stats.add_latency.Add(std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count());
+				stats.sched_latency.Add(std::chrono::duration_cast<std::chrono::nanoseconds>(end - intended).count());
+				if (ok)
+				{
+					stats.added++;
+					stats.bytes += size;
+				}
+				else
+				{
+					stats.dropped++;
+				}
+			}
+
+			if (was_measuring)
+				stats.cpu_ns = CpuTimeNs(CLOCK_THREAD_CPUTIME_ID) - cpu_start;
+		});
+	}
+
+	DeliveryTracker delivery;
+	uint64_t process_cpu_start = 0;
+	uint64_t delivered_start = 0;
+	std::chrono::steady_clock::time_point measure_start;
+	auto last_print = start_time;
+
+	// опрос счетчиков каждую миллисекунду для оценки задержки доставки
+	while (true)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		auto now = std::chrono::steady_clock::now();
+		double elapsed = std::chrono::duration<double>(now - start_time).count();
+
+		if (!measuring && elapsed >= options.warmup)
+		{
+			measure_start = now;
+			process_cpu_start = CpuTimeNs(CLOCK_PROCESS_CPUTIME_ID);
+			delivered_start = Logger::Manager::TotalProcessed();
+			measuring = true;
+		}
+
+		delivery.Sample(added_total, Logger::Manager::TotalProcessed(), now, measuring);
+
+		if (now - last_print >= std::chrono::seconds(1))
+		{
+			last_print = now;
+			auto memory = Logger::Manager::GetMemoryStats();
+			std::cerr << fmt::format("{}RPS: {:.0f}. Total processed: {}. Buffer size: {} ({:.2f} MB, peak {:.2f} MB, {})",
+									 measuring ? "" : "[warmup] ",
+									 Logger::Manager::RPS(),
+									 Logger::Manager::TotalProcessed(),
+									 memory.records,
+									 memory.bytes / (1024.0 * 1024.0),
+									 memory.peak_bytes / (1024.0 * 1024.0),
+									 PressureName(Logger::Manager::Pressure()))
+					  << std::endl;
+			for (auto& e : Logger::Manager::GetEndpointStats())
+			{
+				if (options.endpoints.empty())
+					break;
+				std::cerr << fmt::format("  {}:{} {} requests: {}, failures: {}, outstanding: {}, ejections: {}",
+										 e.endpoint.host,
+										 e.endpoint.port,
+										 e.healthy ? "up" : "ejected",
+										 e.requests,
+										 e.failures,
+										 e.outstanding,
+										 e.ejections)
+						  << std::endl;
+			}
+			if (options.max_workers > options.workers)
+			{
+				auto scaling = Logger::Manager::GetScalingStats();
+				std::cerr << fmt::format("Workers: {} (+{} / -{}). {}", scaling.workers, scaling.scale_ups, scaling.scale_downs, scaling.last_decision)
+						  << std::endl;
+			}
+			if (options.event_loop > 0)
+			{
+				auto event_loop = Logger::Manager::GetEventLoopStats();
+				std::cerr << fmt::format("Connections: {} (opened {}, requests {}, reused {})",
+										 event_loop.connections,
+										 event_loop.connects,
+										 event_loop.requests,
+										 event_loop.reused)
+						  << std::endl;
+			}
+			if (options.steal_ms > 0)
+				std::cerr << fmt::format("Stolen records: {}", Logger::Manager::StolenRecords()) << std::endl;
+		}
+
+		if (measuring && options.duration > 0 && std::chrono::duration<double>(now - measure_start).count() >= options.duration)
+			break;
+	}
+
+	Report report;
+	report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - measure_start).count();
+	report.delivered = Logger::Manager::TotalProcessed() - delivered_start;
+	uint64_t process_cpu_ns = CpuTimeNs(CLOCK_PROCESS_CPUTIME_ID) - process_cpu_start;
+	measuring = false;
+
+	to_stop = true;
+	for (auto& t : producers)
+		t.join();
+
 	Logger::Manager::Stop();
 
+	uint64_t producer_cpu_ns = 0;
+	for (auto& s : producer_stats)
+	{
+		report.added += s.added;
+		report.dropped += s.dropped;
+		report.bytes += s.bytes;
+		producer_cpu_ns += s.cpu_ns;
+		report.add_latency.Merge(s.add_latency);
+		report.sched_latency.Merge(s.sched_latency);
+	}
+	report.delivery_latency = delivery.Latency();
+	report.stages = Logger::Manager::GetLatencyStats();
+	report.traces = Logger::Manager::TakeTraces();
+	if (report.added > 0)
+	{
+		report.process_cpu_us_per_record = (double)process_cpu_ns / 1000.0 / (double)report.added;
+		report.producer_cpu_us_per_record = (double)producer_cpu_ns / 1000.0 / (double)report.added;
+	}
+
+	if (options.output.empty())
+	{
+		WriteReport(report, std::cout);
+	}
+	else
+	{
+		std::ofstream file(options.output);
+		WriteReport(report, file);
+	}
+
 	return 0;
 }
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <functional>
+
+namespace Logger
+{
+
+//! Заполненность буфера конвейера для добавляющих записи потоков
+enum class PressureLevel
+{
+	//! Записи принимаются без ограничений
+	Green,
+	//! Буфер заполняется быстрее, чем обрабатывается: стоит снизить подробность логов
+	Yellow,
+	//! Буфер близок к переполнению: новые записи скоро начнут отбрасываться
+	Red,
+};
+
+//! Пороги уровня заполненности буфера. Заполненность - большая из долей max_buffer_size (по количеству записей)
+//! и MemoryLimits::max_buffer_bytes (по объему). Если ни одно ограничение не задано, то уровень всегда Green.
+//! Уровень повышается при достижении порога *_on, а понижается только после снижения ниже *_off, чтобы не переключаться
+//! на каждой записи около порога
+struct BackpressureOptions
+{
+	double yellow_on = 0.5;
+	double yellow_off = 0.3;
+	double red_on = 0.9;
+	double red_off = 0.7;
+	//! Вызывается при изменении уровня из потока, добавившего или обработавшего записи, вне блокировок очередей.
+	//! Вызовы не пересекаются. Функция не должна добавлять записи и управлять конвейером (Start, Stop, Flush)
+	std::function<void(PressureLevel level)> on_change;
+};
+
+} // namespace Logger
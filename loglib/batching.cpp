@@ -0,0 +1,39 @@
+#include "batching.h"
+
+#include <algorithm>
+
+namespace Logger
+{
+
+BatchSizer::BatchSizer(size_t packet_size, const BatchOptions& options) :
+	_max_records(std::max<size_t>(1, packet_size)),
+	_min_records(std::clamp<size_t>(options.min_records, 1, _max_records)),
+	_options(options),
+	_limit(_max_records)
+{
+}
+
+void BatchSizer::Register(size_t records, std::chrono::microseconds latency, bool ok)
+{
+	if (!_options.adaptive || records == 0)
+		return;
+
+	// результаты асинхронной отправки учитываются в потоках приемника одновременно
+	size_t limit = _limit;
+	size_t next;
+	do
+	{
+		next = limit;
+		if (!ok || latency > _options.target_latency)
+		{
+			next = std::max(_min_records, (size_t)((double)limit * std::clamp(_options.decrease_factor, 0.0, 1.0)));
+		}
+		else if (records >= limit)
+		{
+			// неполный пакет ничего не говорит о пропускной способности сервера
+			next = std::min(_max_records, limit + std::max<size_t>(1, _options.increase_step));
+		}
+	} while (!_limit.compare_exchange_weak(limit, next));
+}
+
+} // namespace Logger
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <chrono>
+#include <atomic>
+
+namespace Logger
+{
+
+//! Настройки формирования пакетов для отправки
+struct BatchOptions
+{
+	//! Максимальный размер тела запроса в байтах. Пакет, превысивший его после сериализации, делится пополам. Если 0, то не ограничен.
+	//! При потоковой отправке проверяется только оценка объема при формировании пакета
+	size_t max_batch_bytes = 4 << 20;
+	//! Потоковая отправка (chunked transfer encoding): записи сериализуются в буфер указанного размера во время передачи запроса,
+	//! поэтому память на пакет не зависит от его размера. Если 0, то пакет сериализуется целиком
+	size_t stream_chunk_bytes = 0;
+	//! Сериализовать запись при добавлении в потоке, который ее добавляет. В очереди обработчика хранится только JSON
+	//! в непрерывном буфере, а пакет собирается одним копированием. Отложенное форматирование выполняется сразу.
+	//! Используется, если приемник принимает сериализованные записи (Sink::AcceptsSerialized)
+	bool pre_serialize = false;
+	//! Подбирать количество записей в пакете по времени ответа сервера (AIMD). Верхняя граница - packet_size
+	bool adaptive = false;
+	//! Минимальное количество записей в пакете при адаптивном подборе
+	size_t min_records = 10;
+	//! Время ответа, при превышении которого размер пакета уменьшается
+	std::chrono::milliseconds target_latency {200};
+	//! Увеличение размера пакета после своевременного ответа на полный пакет
+	size_t increase_step = 50;
+	//! Множитель размера пакета при медленном ответе или ошибке
+	double decrease_factor = 0.5;
+};
+
+//! Подбор количества записей в пакете: аддитивное увеличение при своевременных ответах и мультипликативное уменьшение при медленных.
+//! Результаты отправки могут учитываться из нескольких потоков (асинхронный приемник), текущее значение читается без блокировки
+class BatchSizer
+{
+public:
+	BatchSizer(size_t packet_size, const BatchOptions& options);
+
+	//! Текущее ограничение количества записей в пакете
+	size_t Records() const { return _limit; }
+	//! Ограничение объема пакета в байтах (0 - не ограничен)
+	size_t Bytes() const { return _options.max_batch_bytes; }
+
+	//! Учесть результат отправки пакета
+	void Register(
+		//! Количество записей в пакете
+		size_t records,
+		//! Время обработки пакета
+		std::chrono::microseconds latency,
+		//! Пакет успешно отправлен
+		bool ok);
+
+private:
+	const size_t _max_records;
+	const size_t _min_records;
+	const BatchOptions _options;
+	std::atomic<size_t> _limit;
+};
+
+} // namespace Logger
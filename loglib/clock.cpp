@@ -0,0 +1,206 @@
+#include "clock.h"
+
+#include <mutex>
+#include <thread>
+#include <ctime>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#define LOGLIB_TSC
+#endif
+
+namespace Logger
+{
+
+namespace
+{
+using namespace std::chrono;
+
+int64_t SystemMicroseconds()
+{
+	return duration_cast<microseconds>(system_clock::now().time_since_epoch()).count();
+}
+
+#ifdef CLOCK_REALTIME_COARSE
+bool CoarseSupported()
+{
+	static const bool supported = []() {
+		timespec ts;
+		return clock_gettime(CLOCK_REALTIME_COARSE, &ts) == 0;
+	}();
+	return supported;
+}
+
+int64_t CoarseMicroseconds()
+{
+	timespec ts;
+	clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+	return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+#else
+bool CoarseSupported()
+{
+	return false;
+}
+
+int64_t CoarseMicroseconds()
+{
+	return SystemMicroseconds();
+}
+#endif
+
+#ifdef LOGLIB_TSC
+bool TscSupported()
+{
+	// CPUID 0x80000007, EDX бит 8: частота TSC не зависит от P/C-состояний и одинакова на всех ядрах
+	static const bool supported = []() {
+		unsigned int eax, ebx, ecx, edx;
+		if (__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) == 0 || eax < 0x80000007)
+			return false;
+		__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx);
+		return (edx & (1u << 8)) != 0;
+	}();
+	return supported;
+}
+
+uint64_t ReadTsc()
+{
+	return __rdtsc();
+}
+#else
+bool TscSupported()
+{
+	return false;
+}
+
+uint64_t ReadTsc()
+{
+	return 0;
+}
+#endif
+
+//! Соответствие тактов и времени. Читается без блокировки под seqlock, обновляется одним потоком
+class TscCalibration
+{
+public:
+	//! Начальная калибровка. Повторные вызовы ничего не делают
+	void Init()
+	{
+		std::call_once(_init, [this]() {
+			uint64_t tsc0 = ReadTsc();
+			int64_t us0 = SystemMicroseconds();
+			std::this_thread::sleep_for(milliseconds(10));
+			Store(us0, tsc0, ReadTsc(), SystemMicroseconds());
+		});
+	}
+
+	void SetInterval(milliseconds interval) { _interval_us.store(duration_cast<microseconds>(interval).count(), std::memory_order_relaxed); }
+
+	int64_t Now()
+	{
+		uint64_t tsc = ReadTsc();
+		uint64_t base_tsc;
+		int64_t base_us;
+		double us_per_tick;
+		uint64_t seq;
+		do
+		{
+			seq = _seq.load(std::memory_order_acquire);
+			base_tsc = _base_tsc.load(std::memory_order_relaxed);
+			base_us = _base_us.load(std::memory_order_relaxed);
+			us_per_tick = _us_per_tick.load(std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_acquire);
+		} while ((seq & 1) != 0 || seq != _seq.load(std::memory_order_relaxed));
+
+		// такты, прочитанные до обновления другим потоком, могут оказаться меньше базы
+		double elapsed = (double)(int64_t)(tsc - base_tsc) * us_per_tick;
+		if (elapsed > (double)_interval_us.load(std::memory_order_relaxed) && !_calibrating.exchange(true, std::memory_order_acquire))
+		{
+			// наклон считается по интервалу от прошлой калибровки, поэтому с каждым разом он точнее
+			int64_t us = SystemMicroseconds();
+			Store(base_us, base_tsc, ReadTsc(), us);
+			_calibrating.store(false, std::memory_order_release);
+			return us;
+		}
+		return base_us + (int64_t)elapsed;
+	}
+
+private:
+	void Store(int64_t us0, uint64_t tsc0, uint64_t tsc1, int64_t us1)
+	{
+		double us_per_tick = tsc1 > tsc0 && us1 > us0 ? (double)(us1 - us0) / (double)(tsc1 - tsc0) : _us_per_tick.load(std::memory_order_relaxed);
+
+		uint64_t seq = _seq.load(std::memory_order_relaxed);
+		_seq.store(seq + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		_base_tsc.store(tsc1, std::memory_order_relaxed);
+		_base_us.store(us1, std::memory_order_relaxed);
+		_us_per_tick.store(us_per_tick, std::memory_order_relaxed);
+		_seq.store(seq + 2, std::memory_order_release);
+	}
+
+	std::once_flag _init;
+	std::atomic<uint64_t> _seq = 0;
+	std::atomic<uint64_t> _base_tsc = 0;
+	std::atomic<int64_t> _base_us = 0;
+	std::atomic<double> _us_per_tick = 0;
+	std::atomic<int64_t> _interval_us = 1000000;
+	std::atomic_bool _calibrating = false;
+};
+
+TscCalibration& Tsc()
+{
+	static TscCalibration calibration;
+	return calibration;
+}
+} // namespace
+
+ClockSource Clock::SetSource(ClockSource source)
+{
+	if (!IsSupported(source))
+		source = ClockSource::System;
+	if (source == ClockSource::Tsc)
+		Tsc().Init();
+
+	_source.store((int)source, std::memory_order_relaxed);
+	return source;
+}
+
+bool Clock::IsSupported(ClockSource source)
+{
+	switch (source)
+	{
+		case ClockSource::System:
+			return true;
+		case ClockSource::Coarse:
+			return CoarseSupported();
+		case ClockSource::Tsc:
+			return TscSupported();
+	}
+	return false;
+}
+
+void Clock::SetCalibrationInterval(std::chrono::milliseconds interval)
+{
+	Tsc().SetInterval(interval);
+}
+
+RecordTime Clock::Now()
+{
+	int64_t us;
+	switch (Source())
+	{
+		case ClockSource::Coarse:
+			us = CoarseMicroseconds();
+			break;
+		case ClockSource::Tsc:
+			us = Tsc().Now();
+			break;
+		default:
+			us = SystemMicroseconds();
+	}
+	return RecordTime(microseconds(us));
+}
+
+} // namespace Logger
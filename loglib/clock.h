@@ -0,0 +1,51 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+
+namespace Logger
+{
+
+//! Время записи: микросекунды от эпохи UNIX. Хранится одним int64, точнее формат logTime все равно не выводит
+using RecordTime = std::chrono::time_point<std::chrono::system_clock, std::chrono::microseconds>;
+
+//! Источник времени записей
+enum class ClockSource
+{
+	//! std::chrono::system_clock (CLOCK_REALTIME)
+	System,
+	//! CLOCK_REALTIME_COARSE: время последнего тика ядра. Точность 1-4 мс, но дешевле System.
+	//! Если не поддерживается, то используется System
+	Coarse,
+	//! Счетчик тактов процессора, периодически калибруемый по system_clock.
+	//! Требует инвариантного TSC, иначе используется System
+	Tsc,
+};
+
+//! Получение времени записей. Настройки общие для всех конвейеров
+class Clock
+{
+public:
+	//! Выбор источника времени. При первом выборе Tsc выполняется начальная калибровка (около 10 мс).
+	//! Возвращает фактически установленный источник
+	static ClockSource SetSource(ClockSource source);
+	static ClockSource Source() { return (ClockSource)_source.load(std::memory_order_relaxed); }
+	//! Поддерживается ли источник на этой машине
+	static bool IsSupported(ClockSource source);
+	//! Период калибровки TSC по system_clock
+	static void SetCalibrationInterval(std::chrono::milliseconds interval);
+
+	//! Фиксировать время записи при добавлении в очередь обработчика, а не при создании Record.
+	//! Время не запрашивается для записей, которые не были добавлены (остановленный конвейер, переполнение буфера)
+	static void SetDeferredCapture(bool deferred) { _deferred.store(deferred, std::memory_order_relaxed); }
+	static bool DeferredCapture() { return _deferred.load(std::memory_order_relaxed); }
+
+	//! Текущее время выбранного источника
+	static RecordTime Now();
+
+private:
+	static inline std::atomic<int> _source = (int)ClockSource::System;
+	static inline std::atomic_bool _deferred = false;
+};
+
+} // namespace Logger
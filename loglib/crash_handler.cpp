@@ -0,0 +1,194 @@
+#include "crash_handler.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <mutex>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace Logger
+{
+namespace
+{
+//! Максимальное количество одновременно зарегистрированных буферов (по одному на обработчик)
+constexpr size_t kMaxBuffers = 256;
+constexpr int kSignals[] = {SIGSEGV, SIGABRT, SIGBUS, SIGFPE, SIGILL};
+
+std::atomic<CrashBuffer*> buffers[kMaxBuffers];
+std::atomic<int> crash_fd = -1;
+std::atomic_bool dumped = false;
+struct sigaction old_actions[std::size(kSignals)];
+//! Количество вызовов Install без парного Uninstall (по одному на каждый конвейер)
+std::mutex install_mutex;
+int install_count = 0;
+
+void WriteAll(int fd, const char* data, size_t size)
+{
+	while (size > 0)
+	{
+		ssize_t n = write(fd, data, size);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return;
+		data += n;
+		size -= (size_t)n;
+	}
+}
+
+void WriteNumber(int fd, int value)
+{
+	char text[16];
+	size_t pos = sizeof(text);
+	unsigned v = value < 0 ? (unsigned)-value : (unsigned)value;
+	do
+	{
+		text[--pos] = (char)('0' + v % 10);
+		v /= 10;
+	} while (v > 0 && pos > 1);
+	if (value < 0)
+		text[--pos] = '-';
+	WriteAll(fd, text + pos, sizeof(text) - pos);
+}
+
+void WriteText(int fd, const char* text)
+{
+	WriteAll(fd, text, strlen(text));
+}
+
+void SignalHandler(int sig)
+{
+	int fd = crash_fd.load();
+	if (fd >= 0 && !dumped.exchange(true))
+	{
+		WriteText(fd, "loglib crash dump, signal ");
+		WriteNumber(fd, sig);
+		WriteText(fd, "\n");
+
+		for (auto& b : buffers)
+		{
+			CrashBuffer* buffer = b.load();
+			if (buffer != nullptr)
+				buffer->Dump(fd);
+		}
+		fsync(fd);
+	}
+
+	// возвращаем предыдущий обработчик и повторяем сигнал, чтобы процесс завершился как обычно
+	for (size_t i = 0; i < std::size(kSignals); i++)
+	{
+		if (kSignals[i] == sig)
+			sigaction(sig, &old_actions[i], nullptr);
+	}
+	raise(sig);
+}
+} // namespace
+
+CrashBuffer::CrashBuffer(size_t capacity) : _data(new char[capacity]), _capacity(capacity)
+{
+}
+
+uint64_t CrashBuffer::Append(const std::string& line)
+{
+	uint64_t head = _head.load(std::memory_order_relaxed);
+	uint64_t tail = _tail.load(std::memory_order_acquire);
+	if (line.size() == 0 || line.size() > _capacity - (head - tail))
+		return 0;
+
+	size_t start = head % _capacity;
+	size_t first = std::min(line.size(), _capacity - start);
+	memcpy(_data.get() + start, line.data(), first);
+	memcpy(_data.get(), line.data() + first, line.size() - first);
+
+	_head.store(head + line.size(), std::memory_order_release);
+	return head + line.size();
+}
+
+void CrashBuffer::Release(uint64_t pos)
+{
+	uint64_t tail = _tail.load(std::memory_order_relaxed);
+	while (pos > tail && !_tail.compare_exchange_weak(tail, pos, std::memory_order_release))
+	{
+	}
+}
+
+void CrashBuffer::Dump(int fd) const
+{
+	uint64_t tail = _tail.load(std::memory_order_acquire);
+	uint64_t head = _head.load(std::memory_order_acquire);
+	if (head <= tail)
+		return;
+
+	size_t size = (size_t)std::min<uint64_t>(head - tail, _capacity);
+	size_t start = (head - size) % _capacity;
+	size_t first = std::min(size, _capacity - start);
+	WriteAll(fd, _data.get() + start, first);
+	WriteAll(fd, _data.get(), size - first);
+}
+
+bool CrashHandler::Install(const std::string& file_name)
+{
+	std::lock_guard<std::mutex> lock(install_mutex);
+	if (install_count > 0)
+	{
+		install_count++;
+		return true;
+	}
+
+	int fd = open(file_name.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+	if (fd < 0)
+		return false;
+
+	dumped = false;
+	crash_fd = fd;
+
+	struct sigaction action = {};
+	action.sa_handler = SignalHandler;
+	sigemptyset(&action.sa_mask);
+	for (size_t i = 0; i < std::size(kSignals); i++)
+		sigaction(kSignals[i], &action, &old_actions[i]);
+
+	install_count = 1;
+	return true;
+}
+
+void CrashHandler::Uninstall()
+{
+	std::lock_guard<std::mutex> lock(install_mutex);
+	if (install_count == 0 || --install_count > 0)
+		return;
+
+	int fd = crash_fd.exchange(-1);
+	if (fd < 0)
+		return;
+
+	for (size_t i = 0; i < std::size(kSignals); i++)
+		sigaction(kSignals[i], &old_actions[i], nullptr);
+
+	close(fd);
+}
+
+void CrashHandler::Register(CrashBuffer* buffer)
+{
+	for (auto& b : buffers)
+	{
+		CrashBuffer* expected = nullptr;
+		if (b.compare_exchange_strong(expected, buffer))
+			return;
+	}
+}
+
+void CrashHandler::Unregister(CrashBuffer* buffer)
+{
+	for (auto& b : buffers)
+	{
+		CrashBuffer* expected = buffer;
+		if (b.compare_exchange_strong(expected, nullptr))
+			return;
+	}
+}
+
+} // namespace Logger
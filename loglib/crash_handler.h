@@ -0,0 +1,48 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+
+namespace Logger
+{
+
+//! Кольцевой буфер с сериализованными копиями записей, ожидающих отправки.
+//! Добавление выполняется под блокировкой очереди обработчика, чтение - из обработчика сигнала без блокировок и выделения памяти
+class CrashBuffer
+{
+public:
+	explicit CrashBuffer(size_t capacity);
+
+	//! Добавить строку. Возвращает позицию конца строки или 0, если строка не поместилась.
+	//! Вызывается одним потоком в каждый момент времени
+	uint64_t Append(const std::string& line);
+	//! Освободить все строки, заканчивающиеся до позиции pos включительно
+	void Release(uint64_t pos);
+	//! Записать неосвобожденные строки в файл (async-signal-safe)
+	void Dump(int fd) const;
+
+private:
+	std::unique_ptr<char[]> _data;
+	size_t _capacity;
+	//! Позиция после последней добавленной строки
+	std::atomic<uint64_t> _head = 0;
+	//! Начало первой неосвобожденной строки
+	std::atomic<uint64_t> _tail = 0;
+};
+
+//! Обработчик SIGSEGV, SIGABRT, SIGBUS, SIGFPE, SIGILL, записывающий содержимое зарегистрированных CrashBuffer в заранее открытый файл
+class CrashHandler
+{
+public:
+	//! Открыть файл и установить обработчики сигналов. Возвращает false, если файл не удалось открыть.
+	//! Повторные вызовы только увеличивают счетчик установок, файл остается прежним
+	static bool Install(const std::string& file_name);
+	//! Восстановить предыдущие обработчики и закрыть файл после парного вызова для каждого Install
+	static void Uninstall();
+
+	static void Register(CrashBuffer* buffer);
+	static void Unregister(CrashBuffer* buffer);
+};
+
+} // namespace Logger
@@ -0,0 +1,149 @@
+#include "endpoint_pool.h"
+
+#include <assert.h>
+#include <algorithm>
+
+namespace Logger
+{
+
+EndpointPool::EndpointPool(const std::vector<Endpoint>& endpoints, const EndpointPoolOptions& options) : _options(options)
+{
+	assert(!endpoints.empty());
+
+	for (auto& e : endpoints)
+	{
+		State state;
+		state.endpoint = e;
+		state.endpoint.weight = std::max(1u, e.weight);
+		state.eject_time = _options.eject_time;
+		_states.push_back(state);
+	}
+}
+
+size_t EndpointPool::Size() const
+{
+	return _states.size();
+}
+
+const Endpoint& EndpointPool::At(size_t index) const
+{
+	return _states.at(index).endpoint;
+}
+
+int EndpointPool::Acquire(const std::vector<bool>& tried)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	auto now = std::chrono::steady_clock::now();
+
+	// проба выполняется одним запросом, остальные запросы исключенный узел не получает до ее завершения
+	for (size_t i = 0; i < _states.size(); i++)
+	{
+		auto& s = _states.at(i);
+		if (!tried.at(i) && s.ejected && !s.probing && now >= s.ejected_until)
+		{
+			s.probing = true;
+			s.outstanding++;
+			s.requests++;
+			return (int)i;
+		}
+	}
+
+	// перебор начинается с разных узлов, чтобы при равенстве нагрузка не доставалась первому узлу
+	int selected = -1;
+	int64_t total_weight = 0;
+	_next++;
+	for (size_t n = 0; n < _states.size(); n++)
+	{
+		size_t i = (_next + n) % _states.size();
+		auto& s = _states.at(i);
+		if (tried.at(i) || s.ejected)
+			continue;
+
+		if (_options.balancing == Balancing::WeightedRoundRobin)
+		{
+			// плавный взвешенный перебор: узлы чередуются пропорционально весу, без серий запросов к одному узлу
+			s.current_weight += s.endpoint.weight;
+			total_weight += s.endpoint.weight;
+			if (selected < 0 || s.current_weight > _states.at(selected).current_weight)
+				selected = (int)i;
+		}
+		else if (selected < 0 || s.outstanding * _states.at(selected).endpoint.weight < _states.at(selected).outstanding * s.endpoint.weight)
+		{
+			selected = (int)i;
+		}
+	}
+
+	if (selected >= 0)
+		_states.at(selected).current_weight -= total_weight;
+
+	if (selected < 0)
+	{
+		// все оставшиеся узлы исключены: пробуем тот, который раньше всех должен вернуться, вместо отказа
+		for (size_t i = 0; i < _states.size(); i++)
+		{
+			if (!tried.at(i) && (selected < 0 || _states.at(i).ejected_until < _states.at(selected).ejected_until))
+				selected = (int)i;
+		}
+	}
+
+	if (selected >= 0)
+	{
+		_states.at(selected).outstanding++;
+		_states.at(selected).requests++;
+	}
+	return selected;
+}
+
+void EndpointPool::Release(size_t index, bool ok)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	auto now = std::chrono::steady_clock::now();
+
+	auto& s = _states.at(index);
+	assert(s.outstanding > 0);
+	s.outstanding--;
+
+	if (ok)
+	{
+		s.consecutive_failures = 0;
+		if (s.ejected)
+		{
+			s.ejected = false;
+			s.probing = false;
+			s.eject_time = _options.eject_time;
+		}
+		return;
+	}
+
+	s.failures++;
+	s.consecutive_failures++;
+	if (s.probing)
+	{
+		s.probing = false;
+		s.eject_time = std::min(_options.max_eject_time, s.eject_time * 2);
+		Eject(s, now);
+	}
+	else if (!s.ejected && s.consecutive_failures >= std::max<size_t>(1, _options.failures_to_eject))
+	{
+		Eject(s, now);
+	}
+}
+
+void EndpointPool::Eject(State& state, std::chrono::steady_clock::time_point now)
+{
+	state.ejected = true;
+	state.ejected_until = now + state.eject_time;
+	state.ejections++;
+}
+
+std::vector<EndpointStats> EndpointPool::Stats() const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	std::vector<EndpointStats> stats;
+	for (auto& s : _states)
+		stats.push_back({s.endpoint, !s.ejected, s.outstanding, s.requests, s.failures, s.ejections});
+	return stats;
+}
+
+} // namespace Logger
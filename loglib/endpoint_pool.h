@@ -0,0 +1,99 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <chrono>
+
+namespace Logger
+{
+
+//! Узел сервера логов
+struct Endpoint
+{
+	std::string host;
+	uint16_t port = 0;
+	//! Относительный вес при распределении запросов
+	unsigned weight = 1;
+};
+
+//! Способ распределения запросов между узлами
+enum class Balancing
+{
+	//! Взвешенный циклический перебор
+	WeightedRoundRobin,
+	//! Узел с наименьшим количеством незавершенных запросов (с учетом веса)
+	LeastOutstanding,
+};
+
+//! Настройки пула узлов
+struct EndpointPoolOptions
+{
+	Balancing balancing = Balancing::WeightedRoundRobin;
+	//! Сколько ошибок подряд приводит к исключению узла
+	size_t failures_to_eject = 3;
+	//! Время исключения узла, после которого на него отправляется пробный запрос
+	std::chrono::milliseconds eject_time {5000};
+	//! Время исключения удваивается при каждой неудачной пробе, но не более этого значения
+	std::chrono::milliseconds max_eject_time {60000};
+};
+
+//! Состояние узла
+struct EndpointStats
+{
+	Endpoint endpoint;
+	bool healthy = true;
+	//! Незавершенных запросов
+	size_t outstanding = 0;
+	uint64_t requests = 0;
+	uint64_t failures = 0;
+	//! Сколько раз узел исключался
+	uint64_t ejections = 0;
+};
+
+//! Выбор узла для запроса с учетом их состояния. Потокобезопасен
+class EndpointPool
+{
+public:
+	EndpointPool(const std::vector<Endpoint>& endpoints, const EndpointPoolOptions& options);
+
+	size_t Size() const;
+	const Endpoint& At(size_t index) const;
+
+	//! Выбрать узел среди не отмеченных в tried. Исключенный узел, у которого истекло время исключения, выбирается для пробы.
+	//! Если доступных узлов нет, то выбирается исключенный узел с ближайшим окончанием исключения. Возвращает -1, если перебраны все узлы
+	int Acquire(const std::vector<bool>& tried);
+	//! Завершить запрос к узлу
+	void Release(size_t index, bool ok);
+
+	std::vector<EndpointStats> Stats() const;
+
+private:
+	struct State
+	{
+		Endpoint endpoint;
+		//! Текущий вес для плавного взвешенного перебора
+		int64_t current_weight = 0;
+		size_t outstanding = 0;
+		size_t consecutive_failures = 0;
+		bool ejected = false;
+		//! Выполняется пробный запрос к исключенному узлу
+		bool probing = false;
+		std::chrono::steady_clock::time_point ejected_until;
+		std::chrono::milliseconds eject_time {0};
+		uint64_t requests = 0;
+		uint64_t failures = 0;
+		uint64_t ejections = 0;
+	};
+
+	//! Исключить узел. _mutex должен быть заблокирован
+	void Eject(State& state, std::chrono::steady_clock::time_point now);
+
+	const EndpointPoolOptions _options;
+	mutable std::mutex _mutex;
+	std::vector<State> _states;
+	//! Начало перебора узлов
+	size_t _next = 0;
+};
+
+} // namespace Logger
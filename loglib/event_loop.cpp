@@ -0,0 +1,1019 @@
+#include "event_loop.h"
+#include "thread_options.h"
+
+#include <map>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <thread>
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+#ifdef __linux__
+	#include <unistd.h>
+	#include <netdb.h>
+	#include <sys/epoll.h>
+	#include <sys/eventfd.h>
+	#include <sys/socket.h>
+	#include <netinet/in.h>
+	#include <netinet/tcp.h>
+	#include <cerrno>
+	#define LOGLIB_EPOLL
+#endif
+
+#include "3rdparty/fmtlib/format.h"
+#include "3rdparty/httplib.h"
+
+namespace Logger
+{
+
+namespace
+{
+//! Запрос, переданный в цикл событий. Создается в PostAsync и удаляется при завершении
+struct Request
+{
+	//! host:port
+	std::string key;
+	const Endpoint* endpoint = nullptr;
+	//! Строка запроса и заголовки
+	std::string head;
+	std::shared_ptr<const std::string> body;
+	std::chrono::steady_clock::time_point deadline;
+	//! Запрос уже повторялся через новое соединение после обрыва ранее открытого
+	bool retried = false;
+	//! Обработчик завершения
+	SinkCallback done;
+};
+
+//! Коды ошибок совпадают с HttpSink без цикла событий: приемник отличает ошибки узла от ошибок данных по коду
+SinkResult MakeError(httplib::Error error, const std::string& details = {})
+{
+	return {false, (int)error, details.empty() ? to_string(error) : fmt::format("{}: {}", to_string(error), details)};
+}
+
+//! Завершить запрос и передать результат обработчику завершения
+void Complete(Request* request, const SinkResult& result)
+{
+	// обработчик может сразу отправить следующий запрос, поэтому объект удаляется до вызова
+	auto done = std::move(request->done);
+	delete request;
+	done(result);
+}
+
+//! Ответ сервера. Тело нужно только для текста ошибки
+struct Response
+{
+	int status = 0;
+	std::string reason;
+	std::string body;
+	bool keep_alive = true;
+};
+
+enum class ParseResult
+{
+	Incomplete,
+	Complete,
+	Invalid,
+};
+
+std::string Lower(std::string_view s)
+{
+	std::string result(s);
+	std::transform(result.begin(), result.end(), result.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+	return result;
+}
+
+std::string_view Trim(std::string_view s)
+{
+	while (!s.empty() && (s.front() == ' ' || s.front() == '\t'))
+		s.remove_prefix(1);
+	while (!s.empty() && (s.back() == ' ' || s.back() == '\t'))
+		s.remove_suffix(1);
+	return s;
+}
+
+//! Разбор накопленных данных ответа HTTP/1.1. eof - сервер закрыл соединение
+ParseResult ParseResponse(const std::string& data, bool eof, Response& response)
+{
+	const ParseResult incomplete = eof ? ParseResult::Invalid : ParseResult::Incomplete;
+
+	size_t header_end = data.find("\r\n\r\n");
+	if (header_end == std::string::npos)
+		return incomplete;
+
+	size_t line_end = data.find("\r\n");
+	std::string_view status_line(data.data(), line_end);
+	size_t space = status_line.find(' ');
+	if (status_line.compare(0, 5, "HTTP/") != 0 || space == std::string_view::npos)
+		return ParseResult::Invalid;
+
+	response.status = std::atoi(data.c_str() + space + 1);
+	size_t reason = status_line.find(' ', space + 1);
+	response.reason = reason == std::string_view::npos ? "" : std::string(status_line.substr(reason + 1));
+	response.keep_alive = status_line.compare(0, 8, "HTTP/1.0") != 0;
+
+	int64_t content_length = -1;
+	bool chunked = false;
+	for (size_t pos = line_end + 2; pos < header_end;)
+	{
+		size_t end = data.find("\r\n", pos);
+		std::string_view line(data.data() + pos, end - pos);
+		pos = end + 2;
+
+		size_t colon = line.find(':');
+		if (colon == std::string_view::npos)
+			continue;
+
+		std::string name = Lower(Trim(line.substr(0, colon)));
+		std::string value = Lower(Trim(line.substr(colon + 1)));
+		if (name == "content-length")
+			content_length = std::strtoll(value.c_str(), nullptr, 10);
+		else if (name == "transfer-encoding")
+			chunked = value.find("chunked") != std::string::npos;
+		else if (name == "connection" && value == "close")
+			response.keep_alive = false;
+		else if (name == "connection" && value == "keep-alive")
+			response.keep_alive = true;
+	}
+
+	const size_t body_begin = header_end + 4;
+	response.body.clear();
+	if (response.status == 204 || response.status == 304)
+		return ParseResult::Complete;
+
+	if (chunked)
+	{
+		for (size_t pos = body_begin;;)
+		{
+			size_t size_end = data.find("\r\n", pos);
+			if (size_end == std::string::npos)
+				return incomplete;
+
+			size_t size = std::strtoull(data.c_str() + pos, nullptr, 16);
+			if (size == 0)
+				return data.find("\r\n\r\n", size_end) != std::string::npos ? ParseResult::Complete : incomplete;
+
+			if (data.size() < size_end + 2 + size + 2)
+				return incomplete;
+
+			response.body.append(data, size_end + 2, size);
+			pos = size_end + 2 + size + 2;
+		}
+	}
+
+	if (content_length >= 0)
+	{
+		if (data.size() < body_begin + (size_t)content_length)
+			return incomplete;
+
+		response.body.assign(data, body_begin, (size_t)content_length);
+		return ParseResult::Complete;
+	}
+
+	// без длины тело продолжается до закрытия соединения
+	response.keep_alive = false;
+	if (!eof)
+		return ParseResult::Incomplete;
+
+	response.body.assign(data, body_begin);
+	return ParseResult::Complete;
+}
+} // namespace
+
+#ifdef LOGLIB_EPOLL
+
+//! Поток цикла событий со своими соединениями. Все поля, кроме очереди входящих запросов и счетчиков, используются только потоком цикла
+class HttpEventLoop::Loop
+{
+public:
+	Loop(const EventLoopOptions& options, size_t number);
+	~Loop();
+
+	//! Передать запрос потоку цикла
+	void Submit(Request* request);
+	EventLoopStats Stats() const;
+
+private:
+	enum class State
+	{
+		Connecting,
+		Writing,
+		Reading,
+		//! Соединение открыто и ждет следующего запроса
+		Idle,
+	};
+
+	struct Host;
+	using Address = std::pair<sockaddr_storage, socklen_t>;
+
+	//! Разрешение имени узла в потоке _resolver
+	struct Resolution
+	{
+		//! Ключ узла в _hosts
+		std::string key;
+		std::string name;
+		uint16_t port = 0;
+		std::vector<Address> addresses;
+		//! Текст ошибки, если адресов нет
+		std::string error;
+	};
+
+	struct Connection
+	{
+		//! -1 - соединение закрыто, объект удаляется в конце итерации цикла
+		int fd = -1;
+		Host* host = nullptr;
+		State state = State::Connecting;
+		Request* request = nullptr;
+		//! Передано байт запроса
+		size_t written = 0;
+		std::string response;
+		//! Окончание установки соединения, ожидания ответа или простоя
+		std::chrono::steady_clock::time_point deadline;
+		//! Соединение уже использовалось для другого запроса и могло быть закрыто сервером
+		bool reused = false;
+		//! Отслеживаемые события epoll
+		uint32_t events = 0;
+	};
+
+	//! Узел и его соединения
+	struct Host
+	{
+		std::string key;
+		std::string name;
+		uint16_t port = 0;
+		//! Адреса узла. Определяются при первом запросе и сохраняются, пока новое разрешение имени не вернет другие
+		std::vector<Address> addresses;
+		//! Текущий адрес в addresses
+		size_t address = 0;
+		//! Имя разрешается в потоке _resolver
+		bool resolving = false;
+		//! Начало последнего разрешения имени
+		std::chrono::steady_clock::time_point resolved;
+		//! Открытых соединений, включая устанавливаемые
+		size_t open = 0;
+		std::vector<Connection*> idle;
+		//! Запросы, ожидающие свободного соединения или адресов узла
+		std::deque<Request*> waiting;
+	};
+
+	void Run(size_t number);
+	//! Поток разрешения имен: getaddrinfo блокирует, поэтому не выполняется в потоке цикла
+	void RunResolver(size_t number);
+	//! Передать имя узла потоку разрешения имен, если оно еще не разрешается
+	void Resolve(Host& host);
+	//! Адреса узла получены: ожидающие их запросы отправляются
+	void OnResolved(Resolution& resolution);
+	//! Отправить запрос через свободное или новое соединение, либо поставить в очередь узла
+	void Dispatch(Request* request);
+	//! Открыть соединение для запроса. Адреса узла уже определены
+	void Connect(Host& host, Request* request);
+	//! Соединиться по текущему адресу не удалось: следующие соединения устанавливаются по другому адресу узла.
+	//! Возвращает false, если перебраны все адреса: перебор начинается сначала, а имя разрешается заново не чаще resolve_interval
+	bool NextAddress(Host& host);
+	//! Начать отправку запроса через установленное соединение
+	void Start(Connection* c, Request* request);
+	void OnEvent(Connection* c, uint32_t events);
+	void Write(Connection* c);
+	void Read(Connection* c);
+	//! Ответ получен
+	void Finish(Connection* c, const SinkResult& result, bool keep_alive);
+	//! Ошибка соединения. Если retry и сервер закрыл ранее открытое соединение, не ответив, то запрос повторяется через новое
+	void Fail(Connection* c, const SinkResult& result, bool retry);
+	//! Вернуть соединение в список свободных или отдать ожидающему запросу
+	void Release(Connection* c);
+	//! Закрыть соединение и передать освободившееся место ожидающему запросу
+	void Close(Connection* c);
+	void Watch(Connection* c, uint32_t events);
+	void CheckTimeouts(std::chrono::steady_clock::time_point now);
+	//! Таймаут epoll_wait до ближайшего события по времени, мс
+	int NextTimeout(std::chrono::steady_clock::time_point now) const;
+
+	const EventLoopOptions _options;
+	int _epoll = -1;
+	//! eventfd для пробуждения при поступлении запросов
+	int _wakeup = -1;
+
+	std::mutex _mutex;
+	std::deque<Request*> _incoming;
+	//! Имена для потока _resolver и результаты разрешения для потока цикла. Защищены _mutex
+	std::deque<Resolution> _to_resolve;
+	std::deque<Resolution> _resolved;
+	std::condition_variable _resolve_cv;
+	bool _stop = false;
+
+	std::map<std::string, Host> _hosts;
+	std::vector<std::unique_ptr<Connection>> _connections;
+
+	std::atomic<size_t> _open = 0;
+	std::atomic<uint64_t> _connects = 0;
+	std::atomic<uint64_t> _requests = 0;
+	std::atomic<uint64_t> _reused = 0;
+
+	std::thread _thread;
+	std::thread _resolver;
+};
+
+HttpEventLoop::Loop::Loop(const EventLoopOptions& options, size_t number) : _options(options)
+{
+	_epoll = epoll_create1(EPOLL_CLOEXEC);
+	_wakeup = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (_epoll < 0 || _wakeup < 0)
+		return;
+
+	epoll_event event {};
+	event.events = EPOLLIN;
+	event.data.ptr = nullptr;
+	epoll_ctl(_epoll, EPOLL_CTL_ADD, _wakeup, &event);
+
+	_thread = std::thread([this, number]() { Run(number); });
+	_resolver = std::thread([this, number]() { RunResolver(number); });
+}
+
+HttpEventLoop::Loop::~Loop()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_stop = true;
+	}
+	_resolve_cv.notify_one();
+	if (_resolver.joinable())
+		_resolver.join();
+
+	if (_thread.joinable())
+	{
+		uint64_t one = 1;
+		(void)write(_wakeup, &one, sizeof(one));
+		_thread.join();
+	}
+
+	if (_wakeup >= 0)
+		close(_wakeup);
+	if (_epoll >= 0)
+		close(_epoll);
+}
+
+void HttpEventLoop::Loop::Submit(Request* request)
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (!_stop && _thread.joinable())
+		{
+			_incoming.push_back(request);
+			request = nullptr;
+		}
+	}
+
+	if (request != nullptr)
+	{
+		Complete(request, MakeError(httplib::Error::Canceled, "event loop is not running"));
+		return;
+	}
+
+	uint64_t one = 1;
+	(void)write(_wakeup, &one, sizeof(one));
+}
+
+EventLoopStats HttpEventLoop::Loop::Stats() const
+{
+	EventLoopStats stats;
+	stats.connections = _open;
+	stats.connects = _connects;
+	stats.requests = _requests;
+	stats.reused = _reused;
+	return stats;
+}
+
+void HttpEventLoop::Loop::Run(size_t number)
+{
+	ThreadOptions thread_options;
+	thread_options.name_prefix = "loglib-io";
+	ApplyThreadOptions(thread_options, number);
+
+	epoll_event events[64];
+	while (true)
+	{
+		int count = epoll_wait(_epoll, events, 64, NextTimeout(std::chrono::steady_clock::now()));
+		for (int i = 0; i < count; i++)
+		{
+			if (events[i].data.ptr == nullptr)
+			{
+				uint64_t value;
+				(void)read(_wakeup, &value, sizeof(value));
+			}
+			else
+			{
+				OnEvent(static_cast<Connection*>(events[i].data.ptr), events[i].events);
+			}
+		}
+
+		std::deque<Request*> incoming;
+		std::deque<Resolution> resolved;
+		bool stop;
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			incoming.swap(_incoming);
+			resolved.swap(_resolved);
+			stop = _stop;
+		}
+		if (stop)
+		{
+			for (auto r : incoming)
+				Complete(r, MakeError(httplib::Error::Canceled));
+			break;
+		}
+
+		for (auto& r : resolved)
+			OnResolved(r);
+		for (auto r : incoming)
+			Dispatch(r);
+
+		CheckTimeouts(std::chrono::steady_clock::now());
+
+		// закрытые соединения удаляются только здесь: на них могут ссылаться события текущей итерации
+		_connections.erase(std::remove_if(_connections.begin(), _connections.end(), [](const auto& c) { return c->fd < 0; }), _connections.end());
+	}
+
+	for (auto& c : _connections)
+	{
+		if (c->fd < 0)
+			continue;
+		if (c->request != nullptr)
+			Complete(c->request, MakeError(httplib::Error::Canceled));
+		close(c->fd);
+	}
+	_connections.clear();
+	_open = 0;
+
+	for (auto& [key, host] : _hosts)
+	{
+		for (auto r : host.waiting)
+			Complete(r, MakeError(httplib::Error::Canceled));
+	}
+	_hosts.clear();
+}
+
+void HttpEventLoop::Loop::RunResolver(size_t number)
+{
+	ThreadOptions thread_options;
+	thread_options.name_prefix = "loglib-dns";
+	ApplyThreadOptions(thread_options, number);
+
+	while (true)
+	{
+		Resolution resolution;
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_resolve_cv.wait(lock, [this]() { return _stop || !_to_resolve.empty(); });
+			if (_stop)
+				return;
+
+			resolution = std::move(_to_resolve.front());
+			_to_resolve.pop_front();
+		}
+
+		addrinfo hints {};
+		hints.ai_family = AF_UNSPEC;
+		hints.ai_socktype = SOCK_STREAM;
+		addrinfo* result = nullptr;
+		int err = getaddrinfo(resolution.name.c_str(), std::to_string(resolution.port).c_str(), &hints, &result);
+		if (err != 0 || result == nullptr)
+		{
+			resolution.error = gai_strerror(err);
+		}
+		else
+		{
+			for (auto ai = result; ai != nullptr; ai = ai->ai_next)
+			{
+				sockaddr_storage address {};
+				std::memcpy(&address, ai->ai_addr, ai->ai_addrlen);
+				resolution.addresses.emplace_back(address, ai->ai_addrlen);
+			}
+			freeaddrinfo(result);
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_resolved.push_back(std::move(resolution));
+		}
+		uint64_t one = 1;
+		(void)write(_wakeup, &one, sizeof(one));
+	}
+}
+
+void HttpEventLoop::Loop::Resolve(Host& host)
+{
+	if (host.resolving)
+		return;
+
+	host.resolving = true;
+	host.resolved = std::chrono::steady_clock::now();
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_to_resolve.push_back({host.key, host.name, host.port, {}, {}});
+	}
+	_resolve_cv.notify_one();
+}
+
+void HttpEventLoop::Loop::OnResolved(Resolution& resolution)
+{
+	auto it = _hosts.find(resolution.key);
+	if (it == _hosts.end())
+		return;
+
+	auto& host = it->second;
+	host.resolving = false;
+	// при ошибке остаются прежние адреса: сервер может быть временно недоступен, а адреса - верными
+	if (!resolution.addresses.empty())
+	{
+		host.addresses = std::move(resolution.addresses);
+		host.address = 0;
+	}
+
+	std::deque<Request*> waiting;
+	waiting.swap(host.waiting);
+	for (auto r : waiting)
+	{
+		if (host.addresses.empty())
+			Complete(r, MakeError(httplib::Error::Connection, resolution.error));
+		else
+			Dispatch(r);
+	}
+}
+
+void HttpEventLoop::Loop::Dispatch(Request* request)
+{
+	auto& host = _hosts[request->key];
+	if (host.name.empty())
+	{
+		host.key = request->key;
+		host.name = request->endpoint->host;
+		host.port = request->endpoint->port;
+	}
+
+	if (host.addresses.empty())
+	{
+		host.waiting.push_back(request);
+		Resolve(host);
+		return;
+	}
+
+	if (!host.idle.empty())
+	{
+		auto c = host.idle.back();
+		host.idle.pop_back();
+		Start(c, request);
+		return;
+	}
+
+	if (host.open >= std::max<size_t>(1, _options.max_connections))
+	{
+		host.waiting.push_back(request);
+		return;
+	}
+
+	Connect(host, request);
+}
+
+void HttpEventLoop::Loop::Connect(Host& host, Request* request)
+{
+	const auto& [address, address_size] = host.addresses.at(host.address);
+	int fd = socket(address.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+	{
+		Complete(request, MakeError(httplib::Error::Connection, strerror(errno)));
+		return;
+	}
+
+	int one = 1;
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+	if (connect(fd, reinterpret_cast<const sockaddr*>(&address), address_size) < 0 && errno != EINPROGRESS)
+	{
+		int err = errno;
+		close(fd);
+		if (NextAddress(host))
+			Connect(host, request);
+		else
+			Complete(request, MakeError(httplib::Error::Connection, strerror(err)));
+		return;
+	}
+
+	auto c = std::make_unique<Connection>();
+	c->fd = fd;
+	c->host = &host;
+	c->state = State::Connecting;
+	c->request = request;
+	c->deadline = std::min(std::chrono::steady_clock::now() + _options.connect_timeout, request->deadline);
+	c->events = EPOLLOUT;
+
+	epoll_event event {};
+	event.events = c->events;
+	event.data.ptr = c.get();
+	epoll_ctl(_epoll, EPOLL_CTL_ADD, fd, &event);
+
+	host.open++;
+	_open++;
+	_connections.push_back(std::move(c));
+}
+
+bool HttpEventLoop::Loop::NextAddress(Host& host)
+{
+	if (++host.address < host.addresses.size())
+		return true;
+
+	// адреса сохраняются: пока сервер недоступен, каждое соединение не должно ждать разрешения имени
+	host.address = 0;
+	if (std::chrono::steady_clock::now() - host.resolved >= _options.resolve_interval)
+		Resolve(host);
+	return false;
+}
+
+void HttpEventLoop::Loop::Start(Connection* c, Request* request)
+{
+	c->request = request;
+	c->state = State::Writing;
+	c->written = 0;
+	c->response.clear();
+	c->deadline = request->deadline;
+	Write(c);
+}
+
+void HttpEventLoop::Loop::OnEvent(Connection* c, uint32_t events)
+{
+	if (c->fd < 0)
+		return;
+
+	switch (c->state)
+	{
+		case State::Connecting:
+		{
+			int err = 0;
+			socklen_t size = sizeof(err);
+			getsockopt(c->fd, SOL_SOCKET, SO_ERROR, &err, &size);
+			if (err != 0 || (events & EPOLLERR) != 0)
+			{
+				// запрос еще не отправлен, поэтому пробуется следующий адрес узла
+				auto& host = *c->host;
+				auto request = c->request;
+				if (NextAddress(host))
+				{
+					c->request = nullptr;
+					Close(c);
+					Dispatch(request);
+				}
+				else
+				{
+					Fail(c, MakeError(httplib::Error::Connection, strerror(err != 0 ? err : ECONNREFUSED)), false);
+				}
+				return;
+			}
+
+			_connects++;
+			c->state = State::Writing;
+			Write(c);
+			break;
+		}
+		case State::Writing:
+			Write(c);
+			break;
+		case State::Reading:
+			Read(c);
+			break;
+		case State::Idle:
+			// сервер закрыл соединение по своему таймауту или прислал лишние данные
+			Close(c);
+			break;
+	}
+}
+
+void HttpEventLoop::Loop::Write(Connection* c)
+{
+	const auto& head = c->request->head;
+	const auto& body = *c->request->body;
+	const size_t total = head.size() + body.size();
+
+	// заголовки и тело передаются одним вызовом без копирования тела
+	while (c->written < total)
+	{
+		iovec iov[2];
+		int iov_count = 0;
+		if (c->written < head.size())
+		{
+			iov[iov_count++] = {const_cast<char*>(head.data()) + c->written, head.size() - c->written};
+			iov[iov_count++] = {const_cast<char*>(body.data()), body.size()};
+		}
+		else
+		{
+			size_t offset = c->written - head.size();
+			iov[iov_count++] = {const_cast<char*>(body.data()) + offset, body.size() - offset};
+		}
+
+		msghdr msg {};
+		msg.msg_iov = iov;
+		msg.msg_iovlen = iov_count;
+		ssize_t written = sendmsg(c->fd, &msg, MSG_NOSIGNAL);
+		if (written < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+			{
+				Watch(c, EPOLLOUT);
+				return;
+			}
+
+			Fail(c, MakeError(httplib::Error::Write, strerror(errno)), true);
+			return;
+		}
+		c->written += (size_t)written;
+	}
+
+	c->state = State::Reading;
+	Watch(c, EPOLLIN | EPOLLRDHUP);
+}
+
+void HttpEventLoop::Loop::Read(Connection* c)
+{
+	bool eof = false;
+	char buffer[16384];
+	while (true)
+	{
+		ssize_t size = recv(c->fd, buffer, sizeof(buffer), 0);
+		if (size > 0)
+		{
+			c->response.append(buffer, (size_t)size);
+			continue;
+		}
+		if (size == 0)
+		{
+			eof = true;
+			break;
+		}
+		if (errno == EINTR)
+			continue;
+		if (errno == EAGAIN || errno == EWOULDBLOCK)
+			break;
+
+		Fail(c, MakeError(httplib::Error::Read, strerror(errno)), true);
+		return;
+	}
+
+	Response response;
+	switch (ParseResponse(c->response, eof, response))
+	{
+		case ParseResult::Incomplete:
+			break;
+		case ParseResult::Invalid:
+			Fail(c, MakeError(httplib::Error::Read, c->response.empty() ? "connection closed" : "invalid response"), true);
+			break;
+		case ParseResult::Complete:
+			if (response.status != 201)
+				Finish(c, {false, response.status, response.reason + ", " + response.body}, response.keep_alive && !eof);
+			else
+				Finish(c, {}, response.keep_alive && !eof);
+			break;
+	}
+}
+
+void HttpEventLoop::Loop::Finish(Connection* c, const SinkResult& result, bool keep_alive)
+{
+	auto request = c->request;
+	c->request = nullptr;
+	_requests++;
+	if (c->reused)
+		_reused++;
+	Complete(request, result);
+
+	if (keep_alive)
+		Release(c);
+	else
+		Close(c);
+}
+
+void HttpEventLoop::Loop::Fail(Connection* c, const SinkResult& result, bool retry)
+{
+	auto request = c->request;
+	c->request = nullptr;
+	auto& host = *c->host;
+
+	// сервер мог закрыть соединение, пока оно простаивало: запрос до него не дошел и повторяется один раз.
+	// Остальные свободные соединения с узлом, скорее всего, тоже закрыты (например, сервер перезапущен)
+	bool stale = retry && c->reused && c->response.empty() && !request->retried;
+	Close(c);
+	if (stale)
+	{
+		request->retried = true;
+		while (!host.idle.empty())
+			Close(host.idle.back());
+		Dispatch(request);
+		return;
+	}
+
+	Complete(request, result);
+}
+
+void HttpEventLoop::Loop::Release(Connection* c)
+{
+	c->reused = true;
+	auto& host = *c->host;
+	if (!host.waiting.empty())
+	{
+		auto request = host.waiting.front();
+		host.waiting.pop_front();
+		Start(c, request);
+		return;
+	}
+
+	c->state = State::Idle;
+	c->deadline = std::chrono::steady_clock::now() + _options.idle_timeout;
+	host.idle.push_back(c);
+	Watch(c, EPOLLIN | EPOLLRDHUP);
+}
+
+void HttpEventLoop::Loop::Close(Connection* c)
+{
+	if (c->fd < 0)
+		return;
+
+	epoll_ctl(_epoll, EPOLL_CTL_DEL, c->fd, nullptr);
+	close(c->fd);
+	c->fd = -1;
+	_open--;
+
+	auto& host = *c->host;
+	host.open--;
+	host.idle.erase(std::remove(host.idle.begin(), host.idle.end(), c), host.idle.end());
+
+	if (!host.waiting.empty())
+	{
+		auto request = host.waiting.front();
+		host.waiting.pop_front();
+		Dispatch(request);
+	}
+}
+
+void HttpEventLoop::Loop::Watch(Connection* c, uint32_t events)
+{
+	if (c->events == events)
+		return;
+
+	c->events = events;
+	epoll_event event {};
+	event.events = events;
+	event.data.ptr = c;
+	epoll_ctl(_epoll, EPOLL_CTL_MOD, c->fd, &event);
+}
+
+void HttpEventLoop::Loop::CheckTimeouts(std::chrono::steady_clock::time_point now)
+{
+	// при закрытии соединений в конец _connections могут добавиться новые, поэтому перебор по индексу
+	for (size_t i = 0; i < _connections.size(); i++)
+	{
+		auto c = _connections.at(i).get();
+		if (c->fd < 0 || now < c->deadline)
+			continue;
+
+		switch (c->state)
+		{
+			case State::Idle:
+				Close(c);
+				break;
+			case State::Connecting:
+				NextAddress(*c->host);
+				Fail(c, MakeError(httplib::Error::ConnectionTimeout), false);
+				break;
+			case State::Writing:
+				Fail(c, MakeError(httplib::Error::Write, "timeout"), false);
+				break;
+			case State::Reading:
+				Fail(c, MakeError(httplib::Error::Read, "timeout"), false);
+				break;
+		}
+	}
+
+	for (auto& [key, host] : _hosts)
+	{
+		while (!host.waiting.empty() && now >= host.waiting.front()->deadline)
+		{
+			Complete(host.waiting.front(),
+					 MakeError(httplib::Error::ConnectionTimeout, host.addresses.empty() ? "name is not resolved" : "no free connection"));
+			host.waiting.pop_front();
+		}
+	}
+}
+
+int HttpEventLoop::Loop::NextTimeout(std::chrono::steady_clock::time_point now) const
+{
+	auto next = now + std::chrono::seconds(1);
+	for (auto& c : _connections)
+	{
+		if (c->fd >= 0)
+			next = std::min(next, c->deadline);
+	}
+	for (auto& [key, host] : _hosts)
+	{
+		if (!host.waiting.empty())
+			next = std::min(next, host.waiting.front()->deadline);
+	}
+
+	if (next <= now)
+		return 0;
+	// с округлением вверх, чтобы не просыпаться раньше срока
+	return (int)std::chrono::ceil<std::chrono::milliseconds>(next - now).count();
+}
+
+#else
+
+class HttpEventLoop::Loop
+{
+};
+
+#endif
+
+HttpEventLoop::HttpEventLoop(const EventLoopOptions& options) : _options(options)
+{
+#ifdef LOGLIB_EPOLL
+	for (size_t i = 0; i < std::max<size_t>(1, _options.threads); i++)
+		_loops.push_back(std::make_unique<Loop>(_options, i));
+#endif
+}
+
+HttpEventLoop::~HttpEventLoop()
+{
+	// обработчики завершения, вызванные при остановке потоков, не должны передавать запросы в уже удаленные потоки
+	_stopped = true;
+	_loops.clear();
+}
+
+bool HttpEventLoop::IsSupported()
+{
+#ifdef LOGLIB_EPOLL
+	return true;
+#else
+	return false;
+#endif
+}
+
+void HttpEventLoop::PostAsync(const Endpoint& endpoint, const std::string& path, const std::string& headers,
+							  std::shared_ptr<const std::string> body, SinkCallback done)
+{
+#ifdef LOGLIB_EPOLL
+	if (_stopped)
+	{
+		done(MakeError(httplib::Error::Canceled, "event loop is stopped"));
+		return;
+	}
+
+	auto request = new Request;
+	request->key = fmt::format("{}:{}", endpoint.host, endpoint.port);
+	request->endpoint = &endpoint;
+	request->head = fmt::format("POST {} HTTP/1.1\r\nHost: {}:{}\r\n{}Content-Length: {}\r\nConnection: keep-alive\r\n\r\n",
+								path,
+								endpoint.host,
+								endpoint.port,
+								headers,
+								body->size());
+	request->body = std::move(body);
+	request->deadline = std::chrono::steady_clock::now() + _options.request_timeout;
+	request->done = std::move(done);
+
+	_loops.at(_next++ % _loops.size())->Submit(request);
+#else
+	(void)endpoint;
+	(void)path;
+	(void)headers;
+	(void)body;
+	done(MakeError(httplib::Error::Unknown, "event loop is not supported"));
+#endif
+}
+
+SinkResult HttpEventLoop::Post(const Endpoint& endpoint, const std::string& path, const std::string& headers, const std::string& body)
+{
+	// тело существует до получения ответа, поэтому передается без копирования
+	auto promise = std::make_shared<std::promise<SinkResult>>();
+	auto result = promise->get_future();
+	PostAsync(endpoint, path, headers, std::shared_ptr<const std::string>(&body, [](const std::string*) {}),
+			  [promise](const SinkResult& r) { promise->set_value(r); });
+	return result.get();
+}
+
+EventLoopStats HttpEventLoop::Stats() const
+{
+	EventLoopStats stats;
+#ifdef LOGLIB_EPOLL
+	for (auto& loop : _loops)
+	{
+		auto s = loop->Stats();
+		stats.connections += s.connections;
+		stats.connects += s.connects;
+		stats.requests += s.requests;
+		stats.reused += s.reused;
+	}
+#endif
+	return stats;
+}
+
+} // namespace Logger
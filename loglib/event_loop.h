@@ -0,0 +1,83 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <chrono>
+
+#include "sink.h"
+#include "endpoint_pool.h"
+
+namespace Logger
+{
+
+//! Настройки отправки запросов через цикл событий
+struct EventLoopOptions
+{
+	//! Если false, то обработчик сам отправляет каждый запрос через новое соединение httplib
+	bool enabled = false;
+	//! Потоков цикла событий. Запросы распределяются между ними по очереди
+	size_t threads = 1;
+	//! Максимум соединений одного потока цикла с одним узлом. Запросы сверх него ждут освобождения соединения
+	size_t max_connections = 64;
+	//! Время на установку соединения
+	std::chrono::milliseconds connect_timeout {2000};
+	//! Время от передачи запроса в цикл до получения ответа, включая ожидание свободного соединения
+	std::chrono::milliseconds request_timeout {5000};
+	//! Неиспользуемое соединение закрывается через это время. Должно быть меньше keep-alive таймаута сервера
+	std::chrono::milliseconds idle_timeout {4000};
+	//! Адреса узла определяются в отдельном потоке и сохраняются. Если соединиться не удалось ни по одному из них,
+	//! то имя разрешается заново, но не чаще этого интервала
+	std::chrono::milliseconds resolve_interval {30000};
+	//! Пакетов одного обработчика, переданных в цикл и ожидающих ответа. Обработчик не ждет ответа на каждый пакет и продолжает
+	//! разбирать очередь, пока их меньше этого количества. Ограничивает память под отправляемые пакеты
+	size_t max_pending_batches = 8;
+};
+
+//! Состояние соединений цикла событий
+struct EventLoopStats
+{
+	//! Открытых соединений
+	size_t connections = 0;
+	//! Установлено соединений с момента запуска
+	uint64_t connects = 0;
+	//! Выполнено запросов
+	uint64_t requests = 0;
+	//! Из них через ранее открытые соединения
+	uint64_t reused = 0;
+};
+
+//! Отправка HTTP запросов на неблокирующих сокетах. Несколько потоков epoll обслуживают все соединения с узлами
+//! и держат их открытыми между запросами (keep-alive), а вызывающий поток получает результат в обработчике завершения. Только Linux
+class HttpEventLoop
+{
+public:
+	explicit HttpEventLoop(const EventLoopOptions& options);
+	//! Незавершенные запросы завершаются с ошибкой
+	~HttpEventLoop();
+
+	//! Доступен ли цикл событий на этой платформе
+	static bool IsSupported();
+
+	//! POST запрос без ожидания ответа. headers - строки заголовков, каждая с завершающим \r\n (Host, Content-Length и Connection
+	//! добавляются сами). done вызывается один раз из потока цикла после ответа или ошибки (из вызывающего потока, если цикл
+	//! остановлен) и может отправить следующий запрос. Успешен только ответ 201
+	void PostAsync(const Endpoint& endpoint, const std::string& path, const std::string& headers, std::shared_ptr<const std::string> body,
+				   SinkCallback done);
+	//! POST запрос с ожиданием ответа в вызывающем потоке
+	SinkResult Post(const Endpoint& endpoint, const std::string& path, const std::string& headers, const std::string& body);
+
+	EventLoopStats Stats() const;
+
+private:
+	class Loop;
+
+	const EventLoopOptions _options;
+	std::vector<std::unique_ptr<Loop>> _loops;
+	std::atomic<size_t> _next = 0;
+	//! Потоки цикла останавливаются, новые запросы сразу завершаются с ошибкой
+	std::atomic<bool> _stopped = false;
+};
+
+} // namespace Logger
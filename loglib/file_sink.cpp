@@ -0,0 +1,482 @@
+#include "file_sink.h"
+#include "serializer.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <cstring>
+#include <ctime>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#ifdef LOGLIB_ZLIB
+	#include <zlib.h>
+#endif
+
+#include "3rdparty/fmtlib/format.h"
+
+namespace Logger
+{
+
+namespace
+{
+//! Выравнивание адреса буфера, смещения и длины записи для O_DIRECT
+constexpr size_t kDirectAlignment = 4096;
+
+#ifdef IOV_MAX
+constexpr size_t kMaxIov = IOV_MAX;
+#else
+constexpr size_t kMaxIov = 1024;
+#endif
+
+std::string ErrorText(const std::string& action, const std::string& file_name, int error)
+{
+	return fmt::format("{} {}: {}", action, file_name, std::strerror(error));
+}
+
+bool PwriteAll(int fd, const char* data, size_t size, uint64_t offset)
+{
+	while (size > 0)
+	{
+		ssize_t n = pwrite(fd, data, size, (off_t)offset);
+		if (n < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			return false;
+		}
+		data += n;
+		size -= (size_t)n;
+		offset += (uint64_t)n;
+	}
+	return true;
+}
+
+//! Имя файла после ротации
+std::string RotatedFileName(const std::string& file_name)
+{
+	auto now = std::chrono::system_clock::now();
+	std::time_t t = std::chrono::system_clock::to_time_t(now);
+	std::tm tm {};
+	gmtime_r(&t, &tm);
+	char stamp[32];
+	std::strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &tm);
+	auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count() % 1000;
+
+	std::string name = fmt::format("{}.{}-{:03}", file_name, stamp, ms);
+	std::string result = name;
+	for (int i = 1; std::filesystem::exists(result) || std::filesystem::exists(result + ".gz"); i++)
+		result = fmt::format("{}.{}", name, i);
+	return result;
+}
+
+//! Сжатие файла в <file_name>.gz с удалением исходного
+bool CompressFile(const std::string& file_name, std::string& error)
+{
+#ifdef LOGLIB_ZLIB
+	int fd = open(file_name.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+	{
+		error = ErrorText("unable to open", file_name, errno);
+		return false;
+	}
+
+	const std::string gz_name = file_name + ".gz";
+	gzFile gz = gzopen(gz_name.c_str(), "wb");
+	if (gz == nullptr)
+	{
+		close(fd);
+		error = "unable to create " + gz_name;
+		return false;
+	}
+
+	std::vector<char> buffer(1 << 20);
+	bool ok = true;
+	while (true)
+	{
+		ssize_t n = read(fd, buffer.data(), buffer.size());
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+		{
+			ok = n == 0;
+			break;
+		}
+		if (gzwrite(gz, buffer.data(), (unsigned)n) != (int)n)
+		{
+			ok = false;
+			break;
+		}
+	}
+	close(fd);
+	ok = gzclose(gz) == Z_OK && ok;
+
+	if (!ok)
+	{
+		unlink(gz_name.c_str());
+		error = "unable to compress " + file_name;
+		return false;
+	}
+
+	unlink(file_name.c_str());
+#else
+	(void)file_name;
+	(void)error;
+#endif
+	return true;
+}
+} // namespace
+
+FileSink::FileSink(const std::string& file_name, const FileSinkOptions& file_options, const SinkOptions& options) :
+	Sink(options), _file_name(file_name), _file_options(file_options)
+{
+}
+
+FileSink::~FileSink()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	Close();
+	free(_direct_buffer);
+}
+
+std::string FileSink::Name() const
+{
+	return "file:" + _file_name;
+}
+
+uint64_t FileSink::BytesWritten() const
+{
+	return _bytes_written;
+}
+
+SinkResult FileSink::Write(const std::vector<RecordPtr>& records)
+{
+	// сериализация выполняется до захвата блокировки, параллельно в потоках обработчиков
+	std::vector<std::string> lines;
+	lines.reserve(records.size());
+	size_t bytes = 0;
+	for (auto& r : records)
+	{
+		try
+		{
+			std::string line = _file_options.format == SinkFormat::Json ? SerializeRecord(*r) : FormatRecordText(*r);
+			line += '\n';
+			bytes += line.size();
+			lines.push_back(std::move(line));
+		}
+		catch (...)
+		{
+			// кривые данные? игнорируем
+		}
+	}
+
+	std::vector<iovec> iov;
+	iov.reserve(lines.size());
+	for (auto& line : lines)
+		iov.push_back({(void*)line.data(), line.size()});
+	return Append(iov, bytes);
+}
+
+bool FileSink::AcceptsSerialized() const
+{
+	return _file_options.format == SinkFormat::Json;
+}
+
+SinkResult FileSink::WriteSerialized(const SerializedBatch& batch)
+{
+	// записи не копируются: буферы указывают на них в batch.json, перевод строки у всех общий
+	static const char newline = '\n';
+
+	std::vector<iovec> iov;
+	iov.reserve(batch.Size() * 2);
+	size_t bytes = 0;
+	for (size_t i = 0; i < batch.Size(); i++)
+	{
+		std::string_view record = batch.At(i);
+		iov.push_back({(void*)record.data(), record.size()});
+		iov.push_back({(void*)&newline, 1});
+		bytes += record.size() + 1;
+	}
+	return Append(iov, bytes);
+}
+
+SinkResult FileSink::Append(std::vector<iovec>& iov, size_t bytes)
+{
+	if (iov.empty())
+		return {};
+
+	SinkResult result;
+	std::string rotated_file;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (_fd < 0)
+		{
+			result = Open();
+			if (!result.ok)
+				return result;
+		}
+
+		if ((_file_options.rotate_bytes > 0 && _file_size >= _file_options.rotate_bytes) ||
+			(_file_options.rotate_interval.count() > 0 && std::chrono::steady_clock::now() - _open_time >= _file_options.rotate_interval))
+		{
+			result = Rotate(rotated_file);
+			if (result.ok)
+				result = Open();
+			if (!result.ok)
+				return result;
+		}
+
+		result = WriteLines(iov, bytes);
+	}
+
+	// сжатие и удаление старых файлов выполняются без блокировки, другие обработчики продолжают запись
+	if (!rotated_file.empty())
+	{
+		std::string error;
+		if (_file_options.compress_on_rotate && !CompressFile(rotated_file, error) && result.ok)
+			result = {false, 0, error};
+		RemoveOldFiles();
+	}
+
+	return result;
+}
+
+SinkResult FileSink::Open()
+{
+	_direct = false;
+	if (_file_options.direct_io)
+	{
+		_fd = open(_file_name.c_str(), O_RDWR | O_CREAT | O_CLOEXEC | O_DIRECT, 0644);
+		_direct = _fd >= 0;
+	}
+
+	if (_fd < 0)
+		_fd = open(_file_name.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+
+	if (_fd < 0)
+		return {false, errno, ErrorText("unable to open", _file_name, errno)};
+
+	struct stat st {};
+	if (fstat(_fd, &st) != 0)
+	{
+		int error = errno;
+		close(_fd);
+		_fd = -1;
+		return {false, error, ErrorText("unable to stat", _file_name, error)};
+	}
+
+	_file_size = (uint64_t)st.st_size;
+	_open_time = _sync_time = std::chrono::steady_clock::now();
+
+	if (_direct)
+	{
+		if (_direct_buffer == nullptr)
+		{
+			_direct_buffer_size = std::max(kDirectAlignment, (_file_options.direct_buffer_bytes + kDirectAlignment - 1) / kDirectAlignment * kDirectAlignment);
+			if (posix_memalign((void**)&_direct_buffer, kDirectAlignment, _direct_buffer_size) != 0)
+			{
+				_direct_buffer = nullptr;
+				close(_fd);
+				_fd = -1;
+				return {false, ENOMEM, ErrorText("unable to allocate buffer for", _file_name, ENOMEM)};
+			}
+		}
+
+		// неполный последний блок существующего файла дописывается из буфера
+		_direct_offset = _file_size / kDirectAlignment * kDirectAlignment;
+		_direct_used = _direct_written = (size_t)(_file_size - _direct_offset);
+		if (_direct_used > 0 && pread(_fd, _direct_buffer, kDirectAlignment, (off_t)_direct_offset) < (ssize_t)_direct_used)
+		{
+			int error = errno;
+			close(_fd);
+			_fd = -1;
+			return {false, error, ErrorText("unable to read", _file_name, error)};
+		}
+	}
+
+	return {};
+}
+
+void FileSink::Close()
+{
+	if (_fd < 0)
+		return;
+
+	if (_direct)
+		WriteDirectTail();
+	if (_file_options.sync != FileSyncPolicy::None)
+		fdatasync(_fd);
+
+	close(_fd);
+	_fd = -1;
+	_direct_used = 0;
+	_direct_written = 0;
+}
+
+SinkResult FileSink::Rotate(std::string& rotated_file)
+{
+	Close();
+
+	rotated_file = RotatedFileName(_file_name);
+	if (rename(_file_name.c_str(), rotated_file.c_str()) != 0)
+	{
+		int error = errno;
+		rotated_file.clear();
+		return {false, error, ErrorText("unable to rotate", _file_name, error)};
+	}
+	return {};
+}
+
+SinkResult FileSink::WriteLines(std::vector<iovec>& iov, size_t bytes)
+{
+	bool ok = _direct ? WriteDirect(iov) : WriteVector(iov);
+
+	if (!ok)
+	{
+		int error = errno;
+		// при следующей записи файл будет открыт заново
+		Close();
+		return {false, error, ErrorText("unable to write", _file_name, error)};
+	}
+
+	_file_size += bytes;
+	_bytes_written += bytes;
+	Sync(false);
+	return {};
+}
+
+bool FileSink::WriteVector(std::vector<iovec>& iov)
+{
+	size_t index = 0;
+	while (index < iov.size())
+	{
+		ssize_t n = writev(_fd, &iov[index], (int)std::min(kMaxIov, iov.size() - index));
+		if (n < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			return false;
+		}
+
+		// частичная запись: пропускаем записанные буферы и сдвигаем начало текущего
+		size_t written = (size_t)n;
+		while (index < iov.size() && written >= iov[index].iov_len)
+		{
+			written -= iov[index].iov_len;
+			index++;
+		}
+		if (written > 0)
+		{
+			iov[index].iov_base = (char*)iov[index].iov_base + written;
+			iov[index].iov_len -= written;
+		}
+	}
+	return true;
+}
+
+bool FileSink::WriteDirect(const std::vector<iovec>& iov)
+{
+	for (auto& buffer : iov)
+	{
+		const char* data = (const char*)buffer.iov_base;
+		size_t left = buffer.iov_len;
+		while (left > 0)
+		{
+			size_t n = std::min(left, _direct_buffer_size - _direct_used);
+			std::memcpy(_direct_buffer + _direct_used, data, n);
+			_direct_used += n;
+			data += n;
+			left -= n;
+
+			if (_direct_used == _direct_buffer_size)
+			{
+				if (!PwriteAll(_fd, _direct_buffer, _direct_buffer_size, _direct_offset))
+					return false;
+				_direct_offset += _direct_buffer_size;
+				_direct_used = 0;
+				_direct_written = 0;
+			}
+		}
+	}
+
+	// пакет считается записанным, только когда он в файле: иначе при падении процесса он потеряется,
+	// а читающий файл (например сборщик логов) не увидит его до заполнения буфера
+	return WriteDirectTail();
+}
+
+bool FileSink::WriteDirectTail()
+{
+	if (_direct_used == _direct_written)
+		return true;
+
+	// полные блоки записываются окончательно, и в буфере остается только неполный последний блок
+	const size_t full = _direct_used / kDirectAlignment * kDirectAlignment;
+	if (full > 0)
+	{
+		if (!PwriteAll(_fd, _direct_buffer, full, _direct_offset))
+			return false;
+		_direct_offset += full;
+		_direct_used -= full;
+		std::memmove(_direct_buffer, _direct_buffer + full, _direct_used);
+	}
+
+	// O_DIRECT требует выровненной длины: дополняем последний блок нулями, затем обрезаем файл до логического размера.
+	// Позиция не сдвигается, следующая запись перезапишет этот блок
+	if (_direct_used > 0)
+	{
+		std::memset(_direct_buffer + _direct_used, 0, kDirectAlignment - _direct_used);
+		if (!PwriteAll(_fd, _direct_buffer, kDirectAlignment, _direct_offset))
+			return false;
+	}
+	if (ftruncate(_fd, (off_t)(_direct_offset + _direct_used)) != 0)
+		return false;
+
+	_direct_written = _direct_used;
+	return true;
+}
+
+void FileSink::Sync(bool force)
+{
+	auto now = std::chrono::steady_clock::now();
+	bool required = force || _file_options.sync == FileSyncPolicy::Batch ||
+					(_file_options.sync == FileSyncPolicy::Interval && now - _sync_time >= _file_options.sync_interval);
+	if (!required)
+		return;
+
+	if (_direct)
+		WriteDirectTail();
+	fdatasync(_fd);
+	_sync_time = now;
+}
+
+void FileSink::RemoveOldFiles() const
+{
+	if (_file_options.max_files == 0)
+		return;
+
+	std::filesystem::path path(_file_name);
+	std::filesystem::path dir = path.has_parent_path() ? path.parent_path() : std::filesystem::path(".");
+	const std::string prefix = path.filename().string() + ".";
+
+	// имена после ротации содержат время, поэтому сортировка по имени соответствует порядку ротации
+	std::vector<std::filesystem::path> files;
+	std::error_code ec;
+	for (auto& entry : std::filesystem::directory_iterator(dir, ec))
+	{
+		std::string name = entry.path().filename().string();
+		if (name.size() > prefix.size() && name.compare(0, prefix.size(), prefix) == 0)
+			files.push_back(entry.path());
+	}
+
+	if (files.size() <= _file_options.max_files)
+		return;
+
+	std::sort(files.begin(), files.end());
+	for (size_t i = 0; i < files.size() - _file_options.max_files; i++)
+		std::filesystem::remove(files.at(i), ec);
+}
+
+} // namespace Logger
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "sink.h"
+
+struct iovec;
+
+namespace Logger
+{
+
+//! Когда выполнять fdatasync
+enum class FileSyncPolicy
+{
+	//! Не выполнять (данные сбрасываются на диск системой)
+	None,
+	//! После каждого пакета
+	Batch,
+	//! Не чаще, чем раз в FileSinkOptions::sync_interval (проверяется при записи пакета)
+	Interval,
+};
+
+//! Настройки FileSink
+struct FileSinkOptions
+{
+	SinkFormat format = SinkFormat::Json;
+	//! Запись через O_DIRECT из выровненного буфера (минуя кэш страниц). Если файловая система не поддерживает O_DIRECT, то обычная запись.
+	//! Каждый пакет записывается в файл до возврата, поэтому неполный последний блок (до 4 КБ) перезаписывается следующим пакетом
+	//! и после каждого пакета выполняется ftruncate
+	bool direct_io = false;
+	//! Размер выровненного буфера для O_DIRECT: ограничение объема одного вызова pwrite для больших пакетов
+	size_t direct_buffer_bytes = 1 << 20;
+	FileSyncPolicy sync = FileSyncPolicy::None;
+	std::chrono::milliseconds sync_interval {1000};
+	//! Ротация по размеру файла. Если 0, то не выполняется
+	size_t rotate_bytes = 0;
+	//! Ротация по времени с момента открытия файла. Если 0, то не выполняется
+	std::chrono::seconds rotate_interval {0};
+	//! Сколько файлов после ротации хранить. Если 0, то все
+	size_t max_files = 0;
+	//! Сжимать файл после ротации (gzip). Игнорируется, если библиотека собрана без zlib
+	bool compress_on_rotate = false;
+};
+
+//! Запись пакетов в локальный файл по строке на запись. Строки сериализуются в потоках обработчиков
+//! и записываются одним вызовом writev без промежуточного объединения.
+//! Файл после ротации переименовывается в <file_name>.<YYYYmmdd-HHMMSS-mmm>[.gz]
+class FileSink : public Sink
+{
+public:
+	explicit FileSink(const std::string& file_name, const FileSinkOptions& file_options = {}, const SinkOptions& options = {});
+	~FileSink();
+
+	std::string Name() const override;
+
+	//! Записано байт с момента создания
+	uint64_t BytesWritten() const;
+	//! Если формат SinkFormat::Json
+	bool AcceptsSerialized() const override;
+
+protected:
+	SinkResult Write(const std::vector<RecordPtr>& records) override;
+	SinkResult WriteSerialized(const SerializedBatch& batch) override;
+
+private:
+	//! Запись готовых строк (буферы iov общим объемом bytes) с открытием файла и ротацией
+	SinkResult Append(std::vector<iovec>& iov, size_t bytes);
+	//! Открыть файл. _mutex должен быть заблокирован
+	SinkResult Open();
+	//! Дописать буфер O_DIRECT и закрыть файл. _mutex должен быть заблокирован
+	void Close();
+	//! Переименовать текущий файл, сжать и удалить старые. _mutex должен быть заблокирован
+	SinkResult Rotate(std::string& rotated_file);
+	//! Запись строк в файл. _mutex должен быть заблокирован
+	SinkResult WriteLines(std::vector<iovec>& iov, size_t bytes);
+	//! Запись массива буферов целиком с учетом частичной записи и ограничения IOV_MAX
+	bool WriteVector(std::vector<iovec>& iov);
+	//! Запись через выровненный буфер O_DIRECT
+	bool WriteDirect(const std::vector<iovec>& iov);
+	//! Записать полные блоки буфера O_DIRECT и неполный последний блок, не сдвигая позицию для него
+	bool WriteDirectTail();
+	//! Выполнить fdatasync в соответствии с политикой. _mutex должен быть заблокирован
+	void Sync(bool force);
+	//! Удалить старые файлы сверх max_files
+	void RemoveOldFiles() const;
+
+	const std::string _file_name;
+	const FileSinkOptions _file_options;
+
+	std::mutex _mutex;
+	int _fd = -1;
+	//! Логический размер файла
+	uint64_t _file_size = 0;
+	std::chrono::steady_clock::time_point _open_time;
+	std::chrono::steady_clock::time_point _sync_time;
+	std::atomic<uint64_t> _bytes_written = 0;
+
+	//! Файл открыт с O_DIRECT
+	bool _direct = false;
+	//! Выровненный буфер O_DIRECT
+	char* _direct_buffer = nullptr;
+	size_t _direct_buffer_size = 0;
+	size_t _direct_used = 0;
+	//! Сколько байт из начала буфера уже записано в файл
+	size_t _direct_written = 0;
+	//! Выровненное смещение начала буфера в файле
+	uint64_t _direct_offset = 0;
+};
+
+} // namespace Logger
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <algorithm>
+
+namespace Logger
+{
+
+//! Лог-линейная гистограмма значений (например задержек). Точность около 6%, фиксированный размер, без выделения памяти
+class Histogram
+{
+public:
+	void Add(uint64_t value, uint64_t count = 1)
+	{
+		_buckets.at(Index(value)) += count;
+		_count += count;
+		_sum += value * count;
+		_max = std::max(_max, value);
+	}
+
+	void Merge(const Histogram& h)
+	{
+		for (size_t i = 0; i < _buckets.size(); i++)
+			_buckets[i] += h._buckets[i];
+		_count += h._count;
+		_sum += h._sum;
+		_max = std::max(_max, h._max);
+	}
+
+	void Clear() { *this = Histogram(); }
+
+	uint64_t Count() const { return _count; }
+	uint64_t Max() const { return _max; }
+	double Mean() const { return _count > 0 ? (double)_sum / (double)_count : 0; }
+
+	//! Значение перцентиля p [0..100]
+	uint64_t Percentile(double p) const
+	{
+		if (_count == 0)
+			return 0;
+
+		uint64_t rank = (uint64_t)(p / 100.0 * (double)_count);
+		if (rank >= _count)
+			rank = _count - 1;
+
+		uint64_t seen = 0;
+		for (size_t i = 0; i < _buckets.size(); i++)
+		{
+			seen += _buckets[i];
+			if (seen > rank)
+				return std::min(UpperBound(i), _max);
+		}
+		return _max;
+	}
+
+private:
+	//! Количество младших значащих бит внутри степени двойки
+	static constexpr int kSubBits = 4;
+	static constexpr size_t kSubCount = 1 << kSubBits;
+
+	static size_t Index(uint64_t value)
+	{
+		if (value < kSubCount)
+			return (size_t)value;
+
+		int msb = 63 - __builtin_clzll(value);
+		size_t sub = (size_t)((value >> (msb - kSubBits)) & (kSubCount - 1));
+		return (size_t)(msb - kSubBits + 1) * kSubCount + sub;
+	}
+
+	static uint64_t UpperBound(size_t index)
+	{
+		if (index < kSubCount)
+			return index;
+
+		int msb = (int)(index / kSubCount) + kSubBits - 1;
+		uint64_t sub = index % kSubCount;
+		return ((kSubCount + sub + 1) << (msb - kSubBits)) - 1;
+	}
+
+	std::array<uint64_t, (64 - kSubBits + 1) * kSubCount> _buckets {};
+	uint64_t _count = 0;
+	uint64_t _sum = 0;
+	uint64_t _max = 0;
+};
+
+} // namespace Logger
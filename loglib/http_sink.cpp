@@ -0,0 +1,460 @@
+#include "http_sink.h"
+#include "serializer.h"
+
+#include <assert.h>
+#include <algorithm>
+
+#include "3rdparty/fmtlib/format.h"
+#include "3rdparty/httplib.h"
+
+namespace Logger
+{
+
+HttpSink::HttpSink(const std::string& token, const std::string& host, uint16_t port, bool concat_records, size_t max_body_bytes,
+				   const SinkOptions& options, size_t stream_chunk_bytes) :
+	HttpSink(token, {{host, port}}, {}, concat_records, max_body_bytes, options, stream_chunk_bytes)
+{
+}
+
+HttpSink::HttpSink(const std::string& token, const std::vector<Endpoint>& endpoints, const EndpointPoolOptions& pool_options, bool concat_records,
+				   size_t max_body_bytes, const SinkOptions& options, size_t stream_chunk_bytes, const EventLoopOptions& event_loop) :
+	Sink(options),
+	_token(token),
+	_pool(endpoints, pool_options),
+	_concat_records(concat_records),
+	_max_body_bytes(max_body_bytes),
+	_stream_chunk_bytes(stream_chunk_bytes),
+	_headers(fmt::format("X-Authorization: {}\r\nContent-Type: application/json\r\nUser-Agent: loglib\r\n", token))
+{
+	if (event_loop.enabled && HttpEventLoop::IsSupported())
+	{
+		_event_loop = std::make_unique<HttpEventLoop>(event_loop);
+		_max_pending_batches = std::max<size_t>(1, event_loop.max_pending_batches);
+	}
+
+	assert(std::all_of(endpoints.begin(), endpoints.end(), [](const Endpoint& e) { return !e.host.empty() && e.port > 0; }));
+}
+
+std::string HttpSink::Name() const
+{
+	std::string name;
+	for (size_t i = 0; i < _pool.Size(); i++)
+		name += fmt::format("{}http://{}:{}", i > 0 ? ", " : "", _pool.At(i).host, _pool.At(i).port);
+	return name;
+}
+
+std::vector<EndpointStats> HttpSink::GetEndpointStats() const
+{
+	return _pool.Stats();
+}
+
+EventLoopStats HttpSink::GetEventLoopStats() const
+{
+	return _event_loop != nullptr ? _event_loop->Stats() : EventLoopStats();
+}
+
+SinkResult HttpSink::Write(const std::vector<RecordPtr>& records)
+{
+	if (_concat_records)
+		return SendToServer(records);
+
+	for (auto i = records.begin(); i != records.end(); ++i)
+	{
+		auto result = SendToServer({*i});
+		if (!result.ok)
+		{
+			// предыдущие записи уже приняты сервером
+			result.delivered = (size_t)(i - records.begin());
+			return result;
+		}
+	}
+	return {};
+}
+
+bool HttpSink::AcceptsSerialized() const
+{
+	return true;
+}
+
+size_t HttpSink::MaxPendingBatches() const
+{
+	return _max_pending_batches;
+}
+
+SinkResult HttpSink::WriteSerialized(const SerializedBatch& batch)
+{
+	if (_concat_records)
+		return SendToServer(batch);
+
+	for (size_t i = 0; i < batch.Size(); i++)
+	{
+		auto result = SendToServer(batch.Slice(i, i + 1));
+		if (!result.ok)
+		{
+			result.delivered = i;
+			return result;
+		}
+	}
+	return {};
+}
+
+SinkResult HttpSink::SendToServer(const std::vector<RecordPtr>& records)
+{
+	// цикл событий передает тело одним буфером
+	if (_stream_chunk_bytes > 0 && _event_loop == nullptr)
+	{
+		// размер тела известен только во время передачи, поэтому пакет делится по _max_body_bytes на последовательные запросы
+		size_t begin = 0;
+		while (begin < records.size())
+		{
+			size_t end = begin;
+			auto result = SendToEndpoints([&](const Endpoint& endpoint) { return PostStream(endpoint, records, begin, end); });
+			if (!result.ok)
+			{
+				result.delivered += begin;
+				return result;
+			}
+			begin = end;
+		}
+		return {};
+	}
+
+	std::string body;
+	try
+	{
+		body = SerializeRecords(records);
+	}
+	catch (...)
+	{
+		// кривые данные? игнорируем
+		return {false, 400, "invalid data"};
+	}
+
+	// оценка объема при формировании пакета приблизительная, поэтому ограничение проверяется после сериализации
+	if (_max_body_bytes > 0 && body.size() > _max_body_bytes && records.size() > 1)
+	{
+		auto middle = records.begin() + records.size() / 2;
+		auto result = SendToServer({records.begin(), middle});
+		if (!result.ok)
+			return result;
+
+		// первая половина уже принята сервером: при ошибке повторяется и сохраняется в файл ошибок только вторая
+		result = SendToServer({middle, records.end()});
+		if (!result.ok)
+			result.delivered += (size_t)(middle - records.begin());
+		return result;
+	}
+
+	return SendToEndpoints([&](const Endpoint& endpoint) { return Post(endpoint, body); });
+}
+
+SinkResult HttpSink::SendToServer(const SerializedBatch& batch)
+{
+	// тело запроса уже собрано, потоковая отправка не требуется
+	if (_max_body_bytes > 0 && batch.json.size() > _max_body_bytes && batch.Size() > 1)
+	{
+		size_t middle = batch.Size() / 2;
+		auto result = SendToServer(batch.Slice(0, middle));
+		if (!result.ok)
+			return result;
+
+		result = SendToServer(batch.Slice(middle, batch.Size()));
+		if (!result.ok)
+			result.delivered += middle;
+		return result;
+	}
+
+	return SendToEndpoints([&](const Endpoint& endpoint) { return Post(endpoint, batch.json); });
+}
+
+template <class PostFunc>
+SinkResult HttpSink::SendToEndpoints(const PostFunc& post)
+{
+	std::vector<bool> tried(_pool.Size());
+	SinkResult result;
+	for (int index; (index = _pool.Acquire(tried)) >= 0;)
+	{
+		tried.at(index) = true;
+		result = post(_pool.At(index));
+
+		// ошибки в данных или авторизации не зависят от узла, поэтому не влияют на его состояние и не повторяются
+		bool endpoint_error = !result.ok && (result.error_code < 400 || result.error_code >= 500);
+		_pool.Release(index, !endpoint_error);
+		if (!endpoint_error)
+			return result;
+	}
+	return result;
+}
+
+SinkResult HttpSink::Post(const Endpoint& endpoint, const std::string& body) const
+{
+	if (_event_loop != nullptr)
+		return _event_loop->Post(endpoint, "/api/add", _headers, body);
+
+	httplib::Client cli(endpoint.host, endpoint.port);
+	//	cli.set_connection_timeout(2);
+	//	cli.set_read_timeout(5, 0);
+	//	cli.set_write_timeout(5, 0);
+
+	try
+	{
+		auto res = cli.Post("/api/add",
+							{
+								{"X-Authorization", _token},
+								{"Connection", "keep-alive"},
+								{"Content-Type", "application/json"},
+								{"User-Agent", "loglib"},
+							},
+							body,
+							"application/json");
+		if (!res)
+			return {false, (int)res.error(), to_string(res.error())};
+
+		if (res->status != 201)
+			return {false, res->status, res->reason + ", " + res->body};
+	}
+	catch (...)
+	{
+		// кривые данные? игнорируем
+		return {false, 400, "invalid data"};
+	}
+	return {};
+}
+
+SinkResult HttpSink::PostStream(const Endpoint& endpoint, const std::vector<RecordPtr>& records, size_t begin, size_t& end) const
+{
+	httplib::Client cli(endpoint.host, endpoint.port);
+
+	// состояние передачи: провайдер вызывается, пока не будет вызван sink.done(), и за один вызов отдает один буфер
+	size_t index = begin;
+	size_t body_size = 0;
+	bool finished = false;
+	bool invalid = false;
+	std::string buffer;
+	buffer.reserve(_stream_chunk_bytes + 1024);
+
+	auto provider = [&](size_t, httplib::DataSink& sink) -> bool {
+		buffer.clear();
+		if (body_size == 0)
+			buffer += '[';
+
+		while (!finished && buffer.size() < _stream_chunk_bytes)
+		{
+			if (index == records.size())
+			{
+				finished = true;
+				break;
+			}
+
+			std::string json;
+			try
+			{
+				json = SerializeRecord(*records.at(index));
+			}
+			catch (...)
+			{
+				// кривые данные? отправка завершается перед записью, и она вместе со следующими возвращается как не обработанная
+				invalid = finished = true;
+				break;
+			}
+
+			// запятая и закрывающая скобка
+			if (_max_body_bytes > 0 && index > begin && body_size + buffer.size() + json.size() + 2 > _max_body_bytes)
+			{
+				finished = true;
+				break;
+			}
+
+			if (index > begin)
+				buffer += ',';
+			buffer += json;
+			index++;
+		}
+
+		// некорректна первая запись: отправлять нечего, запрос отменяется
+		if (invalid && index == begin)
+			return false;
+
+		if (finished)
+			buffer += ']';
+		body_size += buffer.size();
+
+		if (!sink.write(buffer.data(), buffer.size()))
+			return false;
+
+		if (finished)
+			sink.done();
+		return true;
+	};
+
+	auto res = cli.Post("/api/add",
+						{
+							{"X-Authorization", _token},
+							{"Connection", "keep-alive"},
+							{"User-Agent", "loglib"},
+						},
+						provider,
+						"application/json");
+	end = index;
+	if (invalid && end == begin)
+		return {false, 400, "invalid data"};
+
+	if (!res)
+		return {false, (int)res.error(), to_string(res.error())};
+
+	if (res->status != 201)
+		return {false, res->status, res->reason + ", " + res->body};
+
+	// записи до некорректной приняты сервером
+	if (invalid)
+		return {false, 400, "invalid data", end - begin};
+
+	return {};
+}
+
+//! Части пакета отправляются по очереди, каждая - на доступные узлы, пока ошибка зависит от узла (как в SendToEndpoints)
+struct HttpSink::AsyncSend
+{
+	std::shared_ptr<const SerializedBatch> batch;
+	//! Записи [begin, end) каждого запроса
+	std::vector<std::pair<size_t, size_t>> parts;
+	//! Отправляемая часть
+	size_t part = 0;
+	//! Тело запроса текущей части
+	std::shared_ptr<const std::string> body;
+	//! Узлы, на которые уже отправлялась текущая часть
+	std::vector<bool> tried;
+	//! Результат последней отправки текущей части
+	SinkResult result;
+	//! Результат после отправки всех частей
+	SinkResult last;
+	SinkCallback done;
+};
+
+void HttpSink::ProcessAsync(const std::shared_ptr<const std::vector<RecordPtr>>& records, const SinkCallback& done)
+{
+	if (_event_loop == nullptr)
+	{
+		Sink::ProcessAsync(records, done);
+		return;
+	}
+
+	auto batch = std::make_shared<SerializedBatch>();
+	SinkResult last;
+	for (size_t i = 0; i < records->size(); i++)
+	{
+		try
+		{
+			batch->Append(SerializeRecord(*records->at(i)));
+		}
+		catch (...)
+		{
+			// кривые данные? записи до некорректной отправляются, а она вместе со следующими возвращается как не обработанная
+			last = {false, 400, "invalid data", i};
+			break;
+		}
+	}
+	StartAsync(batch, last, done);
+}
+
+void HttpSink::ProcessAsync(const std::shared_ptr<const SerializedBatch>& batch, const SinkCallback& done)
+{
+	if (_event_loop == nullptr)
+		Sink::ProcessAsync(batch, done);
+	else
+		StartAsync(batch, {}, done);
+}
+
+void HttpSink::StartAsync(const std::shared_ptr<const SerializedBatch>& batch, const SinkResult& last, const SinkCallback& done)
+{
+	auto send = std::make_shared<AsyncSend>();
+	send->batch = batch;
+	send->last = last;
+	send->done = done;
+
+	const size_t size = batch->Size();
+	const size_t step = MaxRecords() > 0 ? MaxRecords() : std::max<size_t>(1, size);
+	for (size_t i = 0; i < size; i += step)
+		AddParts(*batch, i, std::min(size, i + step), send->parts);
+
+	SendPart(send);
+}
+
+void HttpSink::AddParts(const SerializedBatch& batch, size_t begin, size_t end, std::vector<std::pair<size_t, size_t>>& parts) const
+{
+	if (!_concat_records)
+	{
+		for (size_t i = begin; i < end; i++)
+			parts.push_back({i, i + 1});
+		return;
+	}
+
+	// тело запроса - записи с разделителями и скобки массива
+	size_t to = end < batch.Size() ? batch.offsets.at(end) - 1 : batch.json.size() - 1;
+	size_t body_size = to - batch.offsets.at(begin) + 2;
+	if (_max_body_bytes > 0 && body_size > _max_body_bytes && end - begin > 1)
+	{
+		size_t middle = begin + (end - begin) / 2;
+		AddParts(batch, begin, middle, parts);
+		AddParts(batch, middle, end, parts);
+		return;
+	}
+
+	parts.push_back({begin, end});
+}
+
+void HttpSink::SendPart(const std::shared_ptr<AsyncSend>& send)
+{
+	if (send->part == send->parts.size())
+	{
+		send->done(send->last);
+		return;
+	}
+
+	auto [begin, end] = send->parts.at(send->part);
+	if (begin == 0 && end == send->batch->Size())
+		send->body = std::shared_ptr<const std::string>(send->batch, &send->batch->json);
+	else
+		send->body = std::make_shared<std::string>(send->batch->Slice(begin, end).json);
+	send->tried.assign(_pool.Size(), false);
+	send->result = {};
+	PostPart(send);
+}
+
+void HttpSink::PostPart(const std::shared_ptr<AsyncSend>& send)
+{
+	int index = _pool.Acquire(send->tried);
+	if (index < 0)
+	{
+		// все узлы вернули ошибку: предыдущие части уже приняты сервером
+		auto result = send->result;
+		result.delivered = send->parts.at(send->part).first;
+		send->done(result);
+		return;
+	}
+
+	send->tried.at(index) = true;
+	_event_loop->PostAsync(_pool.At(index), "/api/add", _headers, send->body, [this, send, index](const SinkResult& result) {
+		bool endpoint_error = !result.ok && (result.error_code < 400 || result.error_code >= 500);
+		_pool.Release(index, !endpoint_error);
+		if (endpoint_error)
+		{
+			send->result = result;
+			PostPart(send);
+			return;
+		}
+
+		if (!result.ok)
+		{
+			auto failed = result;
+			failed.delivered = send->parts.at(send->part).first;
+			send->done(failed);
+			return;
+		}
+
+		send->part++;
+		SendPart(send);
+	});
+}
+
+} // namespace Logger
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "sink.h"
+#include "endpoint_pool.h"
+#include "event_loop.h"
+
+namespace Logger
+{
+
+//! Отправка пакетов на сервер логов (POST /api/add)
+class HttpSink : public Sink
+{
+public:
+	HttpSink(
+		//! Токен доступа
+		const std::string& token,
+		//! Адрес сервера
+		const std::string& host,
+		//! Порт сервера
+		uint16_t port,
+		//! Отправлять пакет одним запросом. Если false, то каждая запись отправляется отдельно
+		bool concat_records = true,
+		//! Максимальный размер тела запроса. Пакет, превысивший его после сериализации, отправляется частями. Если 0, то не ограничен
+		size_t max_body_bytes = 0,
+		const SinkOptions& options = {},
+		//! Размер буфера потоковой отправки (chunked transfer encoding). Если 0, то пакет сериализуется целиком
+		size_t stream_chunk_bytes = 0);
+	//! Отправка на несколько узлов сервера логов с распределением нагрузки. При ошибке соединения или 5xx пакет отправляется на другой узел
+	HttpSink(
+		//! Токен доступа
+		const std::string& token,
+		//! Узлы сервера логов
+		const std::vector<Endpoint>& endpoints,
+		//! Распределение запросов и исключение неработающих узлов
+		const EndpointPoolOptions& pool_options,
+		//! Отправлять пакет одним запросом. Если false, то каждая запись отправляется отдельно
+		bool concat_records = true,
+		//! Максимальный размер тела запроса. Пакет, превысивший его после сериализации, отправляется частями. Если 0, то не ограничен
+		size_t max_body_bytes = 0,
+		const SinkOptions& options = {},
+		//! Размер буфера потоковой отправки (chunked transfer encoding). Если 0, то пакет сериализуется целиком.
+		//! С циклом событий не используется
+		size_t stream_chunk_bytes = 0,
+		//! Отправка через цикл событий с постоянными соединениями вместо нового соединения на каждый запрос
+		const EventLoopOptions& event_loop = {});
+
+	std::string Name() const override;
+	//! Состояние узлов
+	std::vector<EndpointStats> GetEndpointStats() const;
+	//! Состояние соединений цикла событий
+	EventLoopStats GetEventLoopStats() const;
+	bool AcceptsSerialized() const override;
+	//! EventLoopOptions::max_pending_batches, если используется цикл событий
+	size_t MaxPendingBatches() const override;
+	//! Записи сериализуются в вызывающем потоке, а части пакета отправляются через цикл событий
+	void ProcessAsync(const std::shared_ptr<const std::vector<RecordPtr>>& records, const SinkCallback& done) override;
+	void ProcessAsync(const std::shared_ptr<const SerializedBatch>& batch, const SinkCallback& done) override;
+
+protected:
+	SinkResult Write(const std::vector<RecordPtr>& records) override;
+	SinkResult WriteSerialized(const SerializedBatch& batch) override;
+
+private:
+	//! Отправка пакета одним запросом
+	SinkResult SendToServer(const std::vector<RecordPtr>& records);
+	//! Отправка пакета сериализованных записей одним запросом
+	SinkResult SendToServer(const SerializedBatch& batch);
+	//! Отправка на доступные узлы по очереди, пока ошибка зависит от узла
+	template <class PostFunc>
+	SinkResult SendToEndpoints(const PostFunc& post);
+	//! Отправка тела запроса на узел
+	SinkResult Post(const Endpoint& endpoint, const std::string& body) const;
+	//! Потоковая отправка записей пакета, начиная с begin, на узел. Запрос завершается перед записью, с которой тело превысило бы
+	//! _max_body_bytes, или перед записью с некорректными данными (тогда ошибка 400). В end возвращается конец отправленных записей
+	SinkResult PostStream(const Endpoint& endpoint, const std::vector<RecordPtr>& records, size_t begin, size_t& end) const;
+
+	//! Пакет, отправляемый через цикл событий
+	struct AsyncSend;
+	//! Асинхронная отправка пакета. last - результат после отправки всех частей
+	void StartAsync(const std::shared_ptr<const SerializedBatch>& batch, const SinkResult& last, const SinkCallback& done);
+	//! Разбиение записей [begin, end) на запросы так же, как при синхронной отправке
+	void AddParts(const SerializedBatch& batch, size_t begin, size_t end, std::vector<std::pair<size_t, size_t>>& parts) const;
+	//! Отправка следующей части пакета или завершение
+	void SendPart(const std::shared_ptr<AsyncSend>& send);
+	//! Отправка текущей части на следующий доступный узел
+	void PostPart(const std::shared_ptr<AsyncSend>& send);
+
+	//! Токен доступа
+	const std::string _token;
+	//! Узлы сервера логов
+	EndpointPool _pool;
+	const bool _concat_records;
+	const size_t _max_body_bytes;
+	const size_t _stream_chunk_bytes;
+	//! Заголовки запроса для цикла событий
+	const std::string _headers;
+	//! Пакетов обработчика, ожидающих ответа (0 - отправка синхронная)
+	size_t _max_pending_batches = 0;
+	//! nullptr, если цикл событий отключен или не поддерживается
+	std::unique_ptr<HttpEventLoop> _event_loop;
+};
+
+} // namespace Logger
@@ -0,0 +1,454 @@
+#include "json_escape.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define LOGLIB_JSON_X86
+#include <immintrin.h>
+#define LOGLIB_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace Logger
+{
+
+namespace
+{
+
+//! Длина корректной последовательности UTF-8, начинающейся с p[0], или 0, если она некорректна
+size_t Utf8SequenceLength(const unsigned char* p, size_t size)
+{
+	unsigned char c = p[0];
+	if (c < 0x80)
+		return 1;
+	// продолжение без начала или overlong двухбайтовой последовательности
+	if (c < 0xC2)
+		return 0;
+
+	if (c < 0xE0)
+		return size >= 2 && (p[1] & 0xC0) == 0x80 ? 2 : 0;
+
+	if (c < 0xF0)
+	{
+		if (size < 3 || (p[1] & 0xC0) != 0x80 || (p[2] & 0xC0) != 0x80)
+			return 0;
+		// overlong и суррогаты
+		if ((c == 0xE0 && p[1] < 0xA0) || (c == 0xED && p[1] > 0x9F))
+			return 0;
+		return 3;
+	}
+
+	if (c < 0xF5)
+	{
+		if (size < 4 || (p[1] & 0xC0) != 0x80 || (p[2] & 0xC0) != 0x80 || (p[3] & 0xC0) != 0x80)
+			return 0;
+		// overlong и коды больше U+10FFFF
+		if ((c == 0xF0 && p[1] < 0x90) || (c == 0xF4 && p[1] > 0x8F))
+			return 0;
+		return 4;
+	}
+
+	return 0;
+}
+
+bool IsValidUtf8Scalar(const char* data, size_t size)
+{
+	auto p = reinterpret_cast<const unsigned char*>(data);
+	for (size_t i = 0; i < size;)
+	{
+		size_t len = Utf8SequenceLength(p + i, size - i);
+		if (len == 0)
+			return false;
+		i += len;
+	}
+	return true;
+}
+
+inline bool NeedEscape(unsigned char c)
+{
+	return c < 0x20 || c == '"' || c == '\\';
+}
+
+void AppendEscaped(std::string& out, unsigned char c)
+{
+	switch (c)
+	{
+		case '"':
+			out += "\\\"";
+			break;
+		case '\\':
+			out += "\\\\";
+			break;
+		case '\b':
+			out += "\\b";
+			break;
+		case '\f':
+			out += "\\f";
+			break;
+		case '\n':
+			out += "\\n";
+			break;
+		case '\r':
+			out += "\\r";
+			break;
+		case '\t':
+			out += "\\t";
+			break;
+		default:
+		{
+			// остальные управляющие символы как в nlohmann: \u00xx строчными
+			static const char* hex = "0123456789abcdef";
+			char buf[6] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0x0F]};
+			out.append(buf, sizeof(buf));
+		}
+	}
+}
+
+//! Побайтовое экранирование data[pos..size). start - начало еще не скопированного участка
+void AppendEscapedTail(std::string& out, const char* data, size_t size, size_t pos, size_t start)
+{
+	for (; pos < size; pos++)
+	{
+		if (!NeedEscape((unsigned char)data[pos]))
+			continue;
+
+		out.append(data + start, pos - start);
+		AppendEscaped(out, (unsigned char)data[pos]);
+		start = pos + 1;
+	}
+	out.append(data + start, size - start);
+}
+
+//! Экранирование символов блока по маске их позиций
+inline void AppendEscapedMask(std::string& out, const char* data, size_t block, uint32_t mask, size_t& start)
+{
+	while (mask != 0)
+	{
+		size_t pos = block + __builtin_ctz(mask);
+		out.append(data + start, pos - start);
+		AppendEscaped(out, (unsigned char)data[pos]);
+		start = pos + 1;
+		mask &= mask - 1;
+	}
+}
+
+void AppendEscapedScalar(std::string& out, const char* data, size_t size)
+{
+	AppendEscapedTail(out, data, size, 0, 0);
+}
+
+#ifdef LOGLIB_JSON_X86
+
+// SSE2 входит в базовый набор x86-64, поэтому проверка процессора не нужна
+
+void AppendEscapedSse2(std::string& out, const char* data, size_t size)
+{
+	const __m128i quote = _mm_set1_epi8('"');
+	const __m128i backslash = _mm_set1_epi8('\\');
+	const __m128i control = _mm_set1_epi8(0x1F);
+
+	// участки без экранируемых символов копируются целиком
+	size_t start = 0;
+	size_t i = 0;
+	for (; i + 16 <= size; i += 16)
+	{
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+		// беззнаковое v <= 0x1F: min(v, 0x1F) == v
+		__m128i m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash)),
+								 _mm_cmpeq_epi8(_mm_min_epu8(v, control), v));
+		AppendEscapedMask(out, data, i, (uint32_t)_mm_movemask_epi8(m), start);
+	}
+	AppendEscapedTail(out, data, size, i, start);
+}
+
+bool IsValidUtf8Sse2(const char* data, size_t size)
+{
+	auto p = reinterpret_cast<const unsigned char*>(data);
+	size_t i = 0;
+	while (i + 16 <= size)
+	{
+		// ASCII пропускается блоками, блок с многобайтовыми последовательностями проверяется побайтово
+		int mask = _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i)));
+		if (mask == 0)
+		{
+			i += 16;
+			continue;
+		}
+
+		size_t end = i + 16;
+		for (i += __builtin_ctz(mask); i < end;)
+		{
+			size_t len = Utf8SequenceLength(p + i, size - i);
+			if (len == 0)
+				return false;
+			i += len;
+		}
+	}
+	return IsValidUtf8Scalar(data + i, size - i);
+}
+
+LOGLIB_TARGET_AVX2 void AppendEscapedAvx2(std::string& out, const char* data, size_t size)
+{
+	const __m256i quote = _mm256_set1_epi8('"');
+	const __m256i backslash = _mm256_set1_epi8('\\');
+	const __m256i control = _mm256_set1_epi8(0x1F);
+
+	size_t start = 0;
+	size_t i = 0;
+	for (; i + 32 <= size; i += 32)
+	{
+		__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+		__m256i m = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, quote), _mm256_cmpeq_epi8(v, backslash)),
+									_mm256_cmpeq_epi8(_mm256_min_epu8(v, control), v));
+		AppendEscapedMask(out, data, i, (uint32_t)_mm256_movemask_epi8(m), start);
+	}
+	AppendEscapedTail(out, data, size, i, start);
+}
+
+// Проверка UTF-8 по таблицам (J. Keiser, D. Lemire, "Validating UTF-8 In Less Than One Instruction Per Byte").
+// Каждая пара соседних байт классифицируется по старшему полубайту предыдущего, младшему полубайту предыдущего
+// и старшему полубайту текущего; пересечение трех таблиц дает биты ошибок. Третий и четвертый байты
+// последовательностей проверяются отдельно по байтам на 2 и 3 позиции назад
+
+constexpr uint8_t kTooShort = 1 << 0;
+constexpr uint8_t kTooLong = 1 << 1;
+constexpr uint8_t kOverlong3 = 1 << 2;
+constexpr uint8_t kTooLarge = 1 << 3;
+constexpr uint8_t kSurrogate = 1 << 4;
+constexpr uint8_t kOverlong2 = 1 << 5;
+constexpr uint8_t kTooLarge1000 = 1 << 6;
+constexpr uint8_t kOverlong4 = 1 << 6;
+constexpr uint8_t kTwoConts = 1 << 7;
+constexpr uint8_t kCarry = kTooShort | kTooLong | kTwoConts;
+
+alignas(16) constexpr uint8_t kByte1High[16] = {
+	// 0_______ ________
+	kTooLong, kTooLong, kTooLong, kTooLong, kTooLong, kTooLong, kTooLong, kTooLong,
+	// 10______ ________
+	kTwoConts, kTwoConts, kTwoConts, kTwoConts,
+	// 1100____ ________
+	kTooShort | kOverlong2,
+	// 1101____ ________
+	kTooShort,
+	// 1110____ ________
+	kTooShort | kOverlong3 | kSurrogate,
+	// 1111____ ________
+	kTooShort | kTooLarge | kTooLarge1000 | kOverlong4,
+};
+
+alignas(16) constexpr uint8_t kByte1Low[16] = {
+	// ____0000 ________
+	kCarry | kOverlong3 | kOverlong2 | kOverlong4,
+	// ____0001 ________
+	kCarry | kOverlong2,
+	// ____001_ ________
+	kCarry,
+	kCarry,
+	// ____0100 ________
+	kCarry | kTooLarge,
+	// ____0101 ________
+	kCarry | kTooLarge | kTooLarge1000,
+	// ____011_ ________
+	kCarry | kTooLarge | kTooLarge1000,
+	kCarry | kTooLarge | kTooLarge1000,
+	// ____1___ ________
+	kCarry | kTooLarge | kTooLarge1000,
+	kCarry | kTooLarge | kTooLarge1000,
+	kCarry | kTooLarge | kTooLarge1000,
+	kCarry | kTooLarge | kTooLarge1000,
+	kCarry | kTooLarge | kTooLarge1000,
+	// ____1101 ________
+	kCarry | kTooLarge | kTooLarge1000 | kSurrogate,
+	kCarry | kTooLarge | kTooLarge1000,
+	kCarry | kTooLarge | kTooLarge1000,
+};
+
+alignas(16) constexpr uint8_t kByte2High[16] = {
+	// ________ 0_______
+	kTooShort, kTooShort, kTooShort, kTooShort, kTooShort, kTooShort, kTooShort, kTooShort,
+	// ________ 1000____
+	kTooLong | kOverlong2 | kTwoConts | kOverlong3 | kTooLarge1000 | kOverlong4,
+	// ________ 1001____
+	kTooLong | kOverlong2 | kTwoConts | kOverlong3 | kTooLarge,
+	// ________ 101_____
+	kTooLong | kOverlong2 | kTwoConts | kSurrogate | kTooLarge,
+	kTooLong | kOverlong2 | kTwoConts | kSurrogate | kTooLarge,
+	// ________ 11______
+	kTooShort, kTooShort, kTooShort, kTooShort,
+};
+
+//! Байты, после которых в конце блока последовательность не может быть завершена: начала 2, 3 и 4-байтовых
+//! последовательностей на последних позициях
+alignas(32) constexpr uint8_t kIncompleteMax[32] = {
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xF0 - 1, 0xE0 - 1, 0xC0 - 1,
+};
+
+LOGLIB_TARGET_AVX2 inline __m256i LoadTableAvx2(const uint8_t* table)
+{
+	return _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(table)));
+}
+
+//! Байты input, сдвинутые на N позиций назад с захватом конца предыдущего блока
+template <int N>
+LOGLIB_TARGET_AVX2 inline __m256i PrevAvx2(__m256i input, __m256i prev_input)
+{
+	return _mm256_alignr_epi8(input, _mm256_permute2x128_si256(prev_input, input, 0x21), 16 - N);
+}
+
+struct Utf8StateAvx2
+{
+	__m256i error;
+	__m256i prev_input;
+	__m256i prev_incomplete;
+};
+
+LOGLIB_TARGET_AVX2 inline void CheckBlockAvx2(__m256i input, Utf8StateAvx2& state)
+{
+	if (_mm256_movemask_epi8(input) == 0)
+	{
+		// ASCII не может продолжать последовательность из предыдущего блока
+		state.error = _mm256_or_si256(state.error, state.prev_incomplete);
+		state.prev_input = input;
+		return;
+	}
+
+	const __m256i low_nibble = _mm256_set1_epi8(0x0F);
+
+	__m256i prev1 = PrevAvx2<1>(input, state.prev_input);
+	__m256i byte_1_high = _mm256_shuffle_epi8(LoadTableAvx2(kByte1High), _mm256_and_si256(_mm256_srli_epi16(prev1, 4), low_nibble));
+	__m256i byte_1_low = _mm256_shuffle_epi8(LoadTableAvx2(kByte1Low), _mm256_and_si256(prev1, low_nibble));
+	__m256i byte_2_high = _mm256_shuffle_epi8(LoadTableAvx2(kByte2High), _mm256_and_si256(_mm256_srli_epi16(input, 4), low_nibble));
+	__m256i special = _mm256_and_si256(_mm256_and_si256(byte_1_high, byte_1_low), byte_2_high);
+
+	// третий байт после 111_____ и четвертый после 1111____ должны быть продолжениями (бит kTwoConts)
+	__m256i prev2 = PrevAvx2<2>(input, state.prev_input);
+	__m256i prev3 = PrevAvx2<3>(input, state.prev_input);
+	__m256i must23 = _mm256_or_si256(_mm256_subs_epu8(prev2, _mm256_set1_epi8((char)(0xE0 - 0x80))),
+									 _mm256_subs_epu8(prev3, _mm256_set1_epi8((char)(0xF0 - 0x80))));
+	__m256i must23_80 = _mm256_and_si256(must23, _mm256_set1_epi8((char)0x80));
+
+	state.error = _mm256_or_si256(state.error, _mm256_xor_si256(must23_80, special));
+	state.prev_incomplete = _mm256_subs_epu8(input, _mm256_load_si256(reinterpret_cast<const __m256i*>(kIncompleteMax)));
+	state.prev_input = input;
+}
+
+LOGLIB_TARGET_AVX2 bool IsValidUtf8Avx2(const char* data, size_t size)
+{
+	Utf8StateAvx2 state {_mm256_setzero_si256(), _mm256_setzero_si256(), _mm256_setzero_si256()};
+
+	size_t i = 0;
+	for (; i + 32 <= size; i += 32)
+		CheckBlockAvx2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i)), state);
+
+	// остаток дополняется нулями; незавершенная в конце строки последовательность дает ошибку на первом нуле
+	alignas(32) char tail[32] = {};
+	std::memcpy(tail, data + i, size - i);
+	CheckBlockAvx2(_mm256_load_si256(reinterpret_cast<const __m256i*>(tail)), state);
+
+	return _mm256_testz_si256(state.error, state.error) != 0;
+}
+
+#endif // LOGLIB_JSON_X86
+
+JsonKernel SupportedKernel(JsonKernel kernel)
+{
+#ifdef LOGLIB_JSON_X86
+	if (kernel == JsonKernel::Avx2 && !__builtin_cpu_supports("avx2"))
+		return JsonKernel::Sse2;
+	return kernel;
+#else
+	(void)kernel;
+	return JsonKernel::Scalar;
+#endif
+}
+
+std::atomic<JsonKernel>& Kernel()
+{
+	static std::atomic<JsonKernel> kernel {DetectJsonKernel()};
+	return kernel;
+}
+
+bool IsValidUtf8(const char* data, size_t size)
+{
+	switch (Kernel().load(std::memory_order_relaxed))
+	{
+#ifdef LOGLIB_JSON_X86
+		case JsonKernel::Avx2:
+			return IsValidUtf8Avx2(data, size);
+		case JsonKernel::Sse2:
+			return IsValidUtf8Sse2(data, size);
+#endif
+		default:
+			return IsValidUtf8Scalar(data, size);
+	}
+}
+
+void AppendEscapedString(std::string& out, const char* data, size_t size)
+{
+	switch (Kernel().load(std::memory_order_relaxed))
+	{
+#ifdef LOGLIB_JSON_X86
+		case JsonKernel::Avx2:
+			AppendEscapedAvx2(out, data, size);
+			break;
+		case JsonKernel::Sse2:
+			AppendEscapedSse2(out, data, size);
+			break;
+#endif
+		default:
+			AppendEscapedScalar(out, data, size);
+	}
+}
+
+} // namespace
+
+JsonKernel DetectJsonKernel()
+{
+	static const JsonKernel kernel = SupportedKernel(JsonKernel::Avx2);
+	return kernel;
+}
+
+JsonKernel ActiveJsonKernel()
+{
+	return Kernel();
+}
+
+void SetJsonKernel(JsonKernel kernel)
+{
+	Kernel() = SupportedKernel(kernel);
+}
+
+bool IsValidUtf8(std::string_view value)
+{
+	return IsValidUtf8(value.data(), value.size());
+}
+
+void AppendJsonString(std::string& out, std::string_view value)
+{
+	if (!IsValidUtf8(value.data(), value.size()))
+		throw std::invalid_argument("invalid UTF-8 string");
+
+	out.reserve(out.size() + value.size() + 2);
+	out += '"';
+	AppendEscapedString(out, value.data(), value.size());
+	out += '"';
+}
+
+void AppendJsonObject(std::string& out, const std::map<std::string, std::string>& values)
+{
+	out += '{';
+	for (auto i = values.begin(); i != values.end(); ++i)
+	{
+		if (i != values.begin())
+			out += ',';
+		AppendJsonString(out, i->first);
+		out += ':';
+		AppendJsonString(out, i->second);
+	}
+	out += '}';
+}
+
+} // namespace Logger
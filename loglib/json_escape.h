@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <map>
+
+namespace Logger
+{
+
+//! Реализация поиска символов для экранирования и проверки UTF-8
+enum class JsonKernel
+{
+	//! Побайтовая обработка
+	Scalar,
+	//! Поиск экранируемых символов и пропуск ASCII блоками по 16 байт, проверка многобайтовых последовательностей побайтово
+	Sse2,
+	//! Поиск экранируемых символов и проверка UTF-8 блоками по 32 байта
+	Avx2,
+};
+
+//! Лучшая реализация, поддерживаемая процессором. Определяется один раз при первом обращении
+JsonKernel DetectJsonKernel();
+//! Текущая реализация
+JsonKernel ActiveJsonKernel();
+//! Выбор реализации (для сравнения в тестах и бенчмарках). Неподдерживаемая процессором заменяется на лучшую доступную
+void SetJsonKernel(JsonKernel kernel);
+
+//! Проверка корректности UTF-8 (без overlong, суррогатов и кодов больше U+10FFFF)
+bool IsValidUtf8(std::string_view value);
+
+//! Добавление строки в кавычках с экранированием по правилам JSON. Результат совпадает с nlohmann::json::dump().
+//! Бросает std::invalid_argument, если строка не является корректным UTF-8
+void AppendJsonString(std::string& out, std::string_view value);
+//! Добавление JSON-объекта со строковыми значениями. Бросает std::invalid_argument, как AppendJsonString
+void AppendJsonObject(std::string& out, const std::map<std::string, std::string>& values);
+
+} // namespace Logger
@@ -0,0 +1,130 @@
+#include "latency.h"
+
+#include <algorithm>
+
+namespace Logger
+{
+
+namespace
+{
+//! Интервал между отметками. Отметки разных источников времени (например Coarse) могут идти не по порядку
+uint64_t Elapsed(int64_t from, int64_t to)
+{
+	return to > from ? (uint64_t)(to - from) : 0;
+}
+
+RecordTime ToTime(int64_t us)
+{
+	return RecordTime(std::chrono::microseconds(us));
+}
+} // namespace
+
+LatencyTracker::LatencyTracker(const LatencyOptions& options) : _options(options)
+{
+	// по адресу нельзя: новый объект может занять память удаленного
+	static std::atomic<uint64_t> next_id = 1;
+	_id = next_id++;
+}
+
+uint32_t LatencyTracker::Key(std::string_view service, std::string_view level)
+{
+	// поток обычно добавляет записи одного сервиса и уровня, поэтому последний ключ запоминается
+	thread_local struct
+	{
+		uint64_t tracker = 0;
+		std::string service;
+		std::string level;
+		uint32_t key = 0;
+	} last;
+	if (last.tracker == _id && last.service == service && last.level == level)
+		return last.key;
+
+	last.tracker = _id;
+	last.service = service;
+	last.level = level;
+	last.key = FindKey(service, level);
+	return last.key;
+}
+
+uint32_t LatencyTracker::FindKey(std::string_view service, std::string_view level)
+{
+	{
+		std::shared_lock<std::shared_mutex> lock(_keys_mutex);
+		auto it = _keys.find(KeyView(service, level));
+		if (it != _keys.end())
+			return it->second;
+	}
+
+	std::unique_lock<std::shared_mutex> lock(_keys_mutex);
+	auto it = _keys.find(KeyView(service, level));
+	if (it != _keys.end())
+		return it->second;
+
+	std::lock_guard<std::mutex> stats_lock(_stats_mutex);
+	auto& stats = _stats.emplace_back();
+	stats.service = service;
+	stats.level = level;
+	uint32_t key = (uint32_t)(_stats.size() - 1);
+	_keys.emplace(KeyView(stats.service, stats.level), key);
+	return key;
+}
+
+bool LatencyTracker::Sample()
+{
+	return _options.sample_every > 0 && _sample_counter.fetch_add(1, std::memory_order_relaxed) % _options.sample_every == 0;
+}
+
+void LatencyTracker::Register(const std::vector<RecordStamps>& stamps, RecordTime dequeued, RecordTime serialized, RecordTime acked, bool ok)
+{
+	const int64_t dequeued_us = dequeued.time_since_epoch().count();
+	const int64_t acked_us = acked.time_since_epoch().count();
+
+	std::lock_guard<std::mutex> lock(_stats_mutex);
+	for (auto& s : stamps)
+	{
+		auto& stats = _stats.at(s.key);
+		if (ok)
+		{
+			stats.enqueue.Add(Elapsed(s.created, s.enqueued));
+			stats.queue.Add(Elapsed(s.enqueued, dequeued_us));
+			stats.send.Add(Elapsed(dequeued_us, acked_us));
+			stats.total.Add(Elapsed(s.created, acked_us));
+		}
+		else
+		{
+			stats.failed++;
+		}
+
+		if (!s.sampled || _options.max_traces == 0)
+			continue;
+
+		if (_traces.size() >= _options.max_traces)
+			_traces.pop_front();
+
+		auto& trace = _traces.emplace_back();
+		trace.service = stats.service;
+		trace.level = stats.level;
+		trace.created = ToTime(s.created);
+		trace.enqueued = ToTime(s.enqueued);
+		trace.serialized = s.serialized != 0 ? ToTime(s.serialized) : serialized;
+		trace.dequeued = dequeued;
+		trace.acked = acked;
+		trace.ok = ok;
+	}
+}
+
+std::vector<LatencyStats> LatencyTracker::Stats() const
+{
+	std::lock_guard<std::mutex> lock(_stats_mutex);
+	return std::vector<LatencyStats>(_stats.begin(), _stats.end());
+}
+
+std::vector<RecordTrace> LatencyTracker::TakeTraces()
+{
+	std::lock_guard<std::mutex> lock(_stats_mutex);
+	std::vector<RecordTrace> traces(std::make_move_iterator(_traces.begin()), std::make_move_iterator(_traces.end()));
+	_traces.clear();
+	return traces;
+}
+
+} // namespace Logger
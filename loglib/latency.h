@@ -0,0 +1,121 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <shared_mutex>
+#include <atomic>
+
+#include "clock.h"
+#include "histogram.h"
+
+namespace Logger
+{
+
+//! Настройки измерения задержки доставки записей
+struct LatencyOptions
+{
+	//! Если false, то время этапов не фиксируется и запись в очереди не занимает дополнительной памяти на отметки
+	bool enabled = false;
+	//! Сохранять время всех этапов для каждой sample_every-й записи. Если 0, то трассировка отключена
+	size_t sample_every = 0;
+	//! Сколько последних трассировок хранить до вызова TakeTraces
+	size_t max_traces = 1000;
+};
+
+//! Задержки доставленных записей одного сервиса и уровня, микросекунды
+struct LatencyStats
+{
+	std::string service;
+	std::string level;
+	//! От создания записи (Record::time) до добавления в очередь обработчика
+	Histogram enqueue;
+	//! Ожидание в очереди обработчика
+	Histogram queue;
+	//! Отправка пакета: от извлечения из очереди до подтверждения приемником
+	Histogram send;
+	//! От создания записи до подтверждения приемником
+	Histogram total;
+	//! Записей, которые приемник не смог обработать (в гистограммы не попадают)
+	uint64_t failed = 0;
+};
+
+//! Время этапов одной записи
+struct RecordTrace
+{
+	std::string service;
+	std::string level;
+	//! Создание записи (Record::time)
+	RecordTime created;
+	//! Добавление в очередь обработчика (начало Worker::AddRecord)
+	RecordTime enqueued;
+	//! JSON записи готов: при BatchOptions::pre_serialize - после сериализации в AddRecord,
+	//! иначе - после отложенного форматирования в обработчике (сериализация выполняется приемником и входит в отправку)
+	RecordTime serialized;
+	//! Извлечение из очереди
+	RecordTime dequeued;
+	//! Подтверждение приемником (для HttpSink - ответ сервера логов)
+	RecordTime acked;
+	//! Приемник обработал пакет без ошибок
+	bool ok = false;
+};
+
+//! Отметки времени записи в очереди обработчика, микросекунды от эпохи
+struct RecordStamps
+{
+	int64_t created = 0;
+	int64_t enqueued = 0;
+	//! Заполняется только для трассируемых записей
+	int64_t serialized = 0;
+	//! Идентификатор сервиса и уровня (LatencyTracker::Key)
+	uint32_t key = 0;
+	bool sampled = false;
+};
+
+//! Сбор задержек записей конвейера. Используется всеми обработчиками конвейера
+class LatencyTracker
+{
+public:
+	explicit LatencyTracker(const LatencyOptions& options);
+
+	const LatencyOptions& Options() const { return _options; }
+	//! Идентификатор сервиса и уровня. Новые сочетания регистрируются, существующие ищутся под разделяемой блокировкой
+	uint32_t Key(std::string_view service, std::string_view level);
+	//! Нужно ли трассировать очередную запись
+	bool Sample();
+
+	//! Учесть обработанный пакет. serialized - время для трассировок записей без собственной отметки
+	void Register(const std::vector<RecordStamps>& stamps, RecordTime dequeued, RecordTime serialized, RecordTime acked, bool ok);
+
+	//! Задержки по сервисам и уровням с момента запуска
+	std::vector<LatencyStats> Stats() const;
+	//! Забрать накопленные трассировки
+	std::vector<RecordTrace> TakeTraces();
+
+private:
+	//! Поиск или регистрация ключа в _keys
+	uint32_t FindKey(std::string_view service, std::string_view level);
+
+	//! Сервис и уровень. Поиск выполняется без создания строк
+	using KeyView = std::pair<std::string_view, std::string_view>;
+
+	const LatencyOptions _options;
+	//! Уникальный номер объекта для кэша последнего ключа в Key
+	uint64_t _id = 0;
+
+	mutable std::shared_mutex _keys_mutex;
+	//! Строки ключей хранятся в _stats, в map только ссылки на них
+	std::map<KeyView, uint32_t> _keys;
+
+	mutable std::mutex _stats_mutex;
+	//! Индекс - идентификатор ключа. Элементы deque не перемещаются при добавлении
+	std::deque<LatencyStats> _stats;
+	std::deque<RecordTrace> _traces;
+
+	std::atomic<uint64_t> _sample_counter = 0;
+};
+
+} // namespace Logger
@@ -0,0 +1,100 @@
+#include "level.h"
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <algorithm>
+
+namespace Logger
+{
+namespace
+{
+//! Пороги уровней. Снимок не изменяется после публикации, изменение порогов публикует новый
+struct Levels
+{
+	Level global = Level::Trace;
+	std::map<std::string, Level, std::less<>> services;
+};
+
+//! Последовательное изменение снимка
+std::mutex levels_mutex;
+std::shared_ptr<const Levels> levels = std::make_shared<const Levels>();
+
+//! Изменить копию текущего снимка и опубликовать ее. levels_mutex должен быть заблокирован
+template <class ModifyFunc>
+void PublishLevels(const ModifyFunc& modify)
+{
+	auto changed = std::make_shared<Levels>(*std::atomic_load(&levels));
+	modify(*changed);
+	std::atomic_store(&levels, std::shared_ptr<const Levels>(std::move(changed)));
+}
+} // namespace
+
+const char* LevelName(Level level)
+{
+	switch (level)
+	{
+		case Level::Trace:
+			return "TRACE";
+		case Level::Debug:
+			return "DEBUG";
+		case Level::Info:
+			return "INFO";
+		case Level::Warning:
+			return "WARNING";
+		case Level::Error:
+			return "ERROR";
+		case Level::Critical:
+			return "CRITICAL";
+		case Level::Off:
+			break;
+	}
+	return "";
+}
+
+void LevelFilter::SetMinLevel(Level level)
+{
+	std::lock_guard<std::mutex> lock(levels_mutex);
+	PublishLevels([level](Levels& l) { l.global = level; });
+	Update();
+}
+
+Level LevelFilter::MinLevel()
+{
+	return std::atomic_load(&levels)->global;
+}
+
+void LevelFilter::SetServiceMinLevel(const std::string& service, Level level)
+{
+	std::lock_guard<std::mutex> lock(levels_mutex);
+	PublishLevels([&](Levels& l) { l.services[service] = level; });
+	Update();
+}
+
+void LevelFilter::ResetServiceMinLevel(const std::string& service)
+{
+	std::lock_guard<std::mutex> lock(levels_mutex);
+	PublishLevels([&](Levels& l) { l.services.erase(service); });
+	Update();
+}
+
+bool LevelFilter::IsServiceEnabled(Level level, std::string_view service)
+{
+	// читается неизменяемый снимок, поэтому проверка не ждет изменения порогов и не мешает другим потокам
+	auto l = std::atomic_load(&levels);
+	auto i = l->services.find(service);
+	return level >= (i != l->services.end() ? i->second : l->global);
+}
+
+void LevelFilter::Update()
+{
+	auto l = std::atomic_load(&levels);
+	int floor = (int)l->global;
+	for (auto& [service, level] : l->services)
+		floor = std::min(floor, (int)level);
+
+	_floor = floor;
+	_has_service_levels = !l->services.empty();
+}
+
+} // namespace Logger
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <string_view>
+
+// Уровни для LOGLIB_MIN_LEVEL: вызовы LOG_* ниже этого уровня полностью удаляются при компиляции
+#define LOGLIB_LEVEL_TRACE    0
+#define LOGLIB_LEVEL_DEBUG    1
+#define LOGLIB_LEVEL_INFO     2
+#define LOGLIB_LEVEL_WARNING  3
+#define LOGLIB_LEVEL_ERROR    4
+#define LOGLIB_LEVEL_CRITICAL 5
+
+#ifndef LOGLIB_MIN_LEVEL
+	#define LOGLIB_MIN_LEVEL LOGLIB_LEVEL_TRACE
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+	#define LOGLIB_UNLIKELY(x) __builtin_expect(!!(x), 0)
+#else
+	#define LOGLIB_UNLIKELY(x) (x)
+#endif
+
+namespace Logger
+{
+
+enum class Level : int
+{
+	Trace = LOGLIB_LEVEL_TRACE,
+	Debug = LOGLIB_LEVEL_DEBUG,
+	Info = LOGLIB_LEVEL_INFO,
+	Warning = LOGLIB_LEVEL_WARNING,
+	Error = LOGLIB_LEVEL_ERROR,
+	Critical = LOGLIB_LEVEL_CRITICAL,
+	//! Отключить все уровни
+	Off,
+};
+
+//! Текстовое представление уровня для Record::level
+const char* LevelName(Level level);
+
+//! Пороговый уровень логирования: глобальный и для отдельных сервисов.
+//! Проверка выполняется до создания записи
+class LevelFilter
+{
+public:
+	//! Глобальный минимальный уровень
+	static void SetMinLevel(Level level);
+	static Level MinLevel();
+	//! Минимальный уровень для сервиса. Имеет приоритет над глобальным
+	static void SetServiceMinLevel(const std::string& service, Level level);
+	//! Вернуть сервис к глобальному уровню
+	static void ResetServiceMinLevel(const std::string& service);
+
+	//! Будет ли запись с таким уровнем принята. Если уровень ниже всех порогов, то стоит одно атомарное чтение и одно условие
+	static bool IsEnabled(Level level, std::string_view service)
+	{
+		if (LOGLIB_UNLIKELY((int)level < _floor.load(std::memory_order_relaxed)))
+			return false;
+		if (!_has_service_levels.load(std::memory_order_relaxed))
+			return true;
+		return IsServiceEnabled(level, service);
+	}
+
+private:
+	static bool IsServiceEnabled(Level level, std::string_view service);
+	//! Пересчитать _floor и _has_service_levels. Вызывается под блокировкой
+	static void Update();
+
+	//! Минимальный из глобального и всех сервисных порогов
+	static inline std::atomic<int> _floor = (int)Level::Trace;
+	static inline std::atomic_bool _has_service_levels = false;
+};
+
+} // namespace Logger
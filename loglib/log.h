@@ -0,0 +1,166 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+#include "manager.h"
+#include "level.h"
+#include "3rdparty/fmtlib/args.h"
+
+namespace Logger
+{
+
+//! Аргументы форматирования, сохраненные в записи. Строка формата не копируется и должна существовать
+//! до обработки записи (макросы LOG_* допускают только строковые литералы)
+class FmtDeferredFormat : public DeferredFormat
+{
+public:
+	template <typename... Args>
+	explicit FmtDeferredFormat(fmt::string_view format, Args&&... args) : _format(format)
+	{
+		_args.reserve(sizeof...(Args), 0);
+		(Push(std::forward<Args>(args)), ...);
+	}
+
+	std::string Format() const override { return fmt::vformat(_format, _args); }
+	size_t MemorySize() const override { return _memory_size; }
+
+private:
+	template <typename T>
+	void Push(T&& arg)
+	{
+		using Type = std::decay_t<T>;
+		// строки копируются в dynamic_format_arg_store в отдельные узлы списка
+		constexpr size_t node_size = 2 * sizeof(void*) + sizeof(std::string);
+		_memory_size += sizeof(fmt::basic_format_arg<fmt::format_context>);
+
+		// string_view хранится в dynamic_format_arg_store по ссылке, поэтому копируем
+		if constexpr (std::is_same_v<Type, std::string_view> || std::is_same_v<Type, fmt::string_view>)
+		{
+			_memory_size += node_size + arg.size();
+			_args.push_back(std::string(arg.data(), arg.size()));
+		}
+		else if constexpr (std::is_array_v<std::remove_reference_t<T>>)
+		{
+			_memory_size += node_size + std::char_traits<char>::length(arg);
+			_args.push_back(static_cast<const char*>(arg));
+		}
+		else
+		{
+			if constexpr (std::is_same_v<Type, std::string>)
+				_memory_size += node_size + arg.size();
+			else if constexpr (std::is_same_v<Type, const char*> || std::is_same_v<Type, char*>)
+				_memory_size += node_size + (arg != nullptr ? std::char_traits<char>::length(arg) : 0);
+			_args.push_back(arg);
+		}
+	}
+
+	fmt::string_view _format;
+	fmt::dynamic_format_arg_store<fmt::format_context> _args;
+	//! Приблизительный объем памяти, занимаемой аргументами
+	size_t _memory_size = sizeof(*this);
+};
+
+//! Добавить запись с отложенным форматированием info. Возвращает false, если запись не была принята.
+//! Уровень не проверяется, для этого используются макросы LOG_* или LevelFilter::IsEnabled
+template <typename... Args>
+bool Log(const std::string& service, Level level, fmt::string_view format, Args&&... args)
+{
+	auto record = std::make_shared<Record>();
+	record->service = service;
+	record->level = LevelName(level);
+	record->deferredInfo = std::make_shared<FmtDeferredFormat>(format, std::forward<Args>(args)...);
+	return Manager::AddRecord(record);
+}
+
+//! То же, что Log, но запись добавляется в указанный конвейер
+template <typename... Args>
+bool Log(Pipeline& pipeline, const std::string& service, Level level, fmt::string_view format, Args&&... args)
+{
+	auto record = std::make_shared<Record>();
+	record->service = service;
+	record->level = LevelName(level);
+	record->deferredInfo = std::make_shared<FmtDeferredFormat>(format, std::forward<Args>(args)...);
+	return pipeline.AddRecord(record);
+}
+
+//! Добавить запись с постоянными полями из шаблона и отложенным форматированием info
+template <typename... Args>
+bool Log(const RecordTemplatePtr& record_template, Level level, fmt::string_view format, Args&&... args)
+{
+	auto record = std::make_shared<Record>(record_template);
+	record->level = LevelName(level);
+	record->deferredInfo = std::make_shared<FmtDeferredFormat>(format, std::forward<Args>(args)...);
+	return Manager::AddRecord(record);
+}
+
+//! То же, что Log с шаблоном, но запись добавляется в указанный конвейер
+template <typename... Args>
+bool Log(Pipeline& pipeline, const RecordTemplatePtr& record_template, Level level, fmt::string_view format, Args&&... args)
+{
+	auto record = std::make_shared<Record>(record_template);
+	record->level = LevelName(level);
+	record->deferredInfo = std::make_shared<FmtDeferredFormat>(format, std::forward<Args>(args)...);
+	return pipeline.AddRecord(record);
+}
+
+//! Имя сервиса для LevelFilter: строка или шаблон записи
+inline std::string_view ServiceName(std::string_view service)
+{
+	return service;
+}
+
+inline std::string_view ServiceName(const RecordTemplatePtr& record_template)
+{
+	return record_template->Service();
+}
+
+//! Вызов, удаленный при компиляции через LOGLIB_MIN_LEVEL
+constexpr bool LogDisabled()
+{
+	return false;
+}
+
+} // namespace Logger
+
+// Аргументы копируются в запись, форматирование выполняется в потоке обработчика.
+// Если уровень отключен через LevelFilter, то запись не создается и аргументы не вычисляются.
+// Вместо имени сервиса можно передать шаблон записи (RecordTemplatePtr), выражение service вычисляется один раз
+#define LOG_RECORD(service, level, format, ...) \
+	([&](const auto& log_service_) { \
+		return ::Logger::LevelFilter::IsEnabled(level, ::Logger::ServiceName(log_service_)) && \
+			   ::Logger::Log(log_service_, level, "" format, ##__VA_ARGS__); \
+	}(service))
+
+#if LOGLIB_MIN_LEVEL <= LOGLIB_LEVEL_TRACE
+	#define LOG_TRACE(service, format, ...) LOG_RECORD(service, ::Logger::Level::Trace, format, ##__VA_ARGS__)
+#else
+	#define LOG_TRACE(service, format, ...) ::Logger::LogDisabled()
+#endif
+
+#if LOGLIB_MIN_LEVEL <= LOGLIB_LEVEL_DEBUG
+	#define LOG_DEBUG(service, format, ...) LOG_RECORD(service, ::Logger::Level::Debug, format, ##__VA_ARGS__)
+#else
+	#define LOG_DEBUG(service, format, ...) ::Logger::LogDisabled()
+#endif
+
+#if LOGLIB_MIN_LEVEL <= LOGLIB_LEVEL_INFO
+	#define LOG_INFO(service, format, ...) LOG_RECORD(service, ::Logger::Level::Info, format, ##__VA_ARGS__)
+#else
+	#define LOG_INFO(service, format, ...) ::Logger::LogDisabled()
+#endif
+
+#if LOGLIB_MIN_LEVEL <= LOGLIB_LEVEL_WARNING
+	#define LOG_WARNING(service, format, ...) LOG_RECORD(service, ::Logger::Level::Warning, format, ##__VA_ARGS__)
+#else
+	#define LOG_WARNING(service, format, ...) ::Logger::LogDisabled()
+#endif
+
+#if LOGLIB_MIN_LEVEL <= LOGLIB_LEVEL_ERROR
+	#define LOG_ERROR(service, format, ...) LOG_RECORD(service, ::Logger::Level::Error, format, ##__VA_ARGS__)
+#else
+	#define LOG_ERROR(service, format, ...) ::Logger::LogDisabled()
+#endif
+
+#define LOG_CRITICAL(service, format, ...) LOG_RECORD(service, ::Logger::Level::Critical, format, ##__VA_ARGS__)
@@ -1,273 +1,187 @@
 #include "manager.h"
-#include "worker.h"
-#include <iostream>
-#include <assert.h>
-#include <regex>
-#include <chrono>
-
-#include "3rdparty/fmtlib/format.h"
-#include "3rdparty/fmtlib/chrono.h"
-#include "3rdparty/fmtlib/ranges.h"
-#include "3rdparty/httplib.h"
 
 namespace Logger
 {
-std::string Manager::_host;
-uint16_t Manager::_port = 0;
-
-std::mutex Manager::_manager_mutex;
-std::shared_ptr<Manager> Manager::_manager;
-std::unique_ptr<std::thread> Manager::_manager_thread;
-size_t Manager::_max_buffer_size = 0;
-
-std::mutex Manager::_cout_locker;
-
-std::mutex Manager::_file_locker;
-std::string Manager::_error_file_name;
-std::ofstream Manager::_log_file;
 
-ErrorFunc Manager::_error_func = nullptr;
-std::chrono::seconds Manager::_error_period;
-std::mutex Manager::_last_error_mutex;
-std::unique_ptr<std::chrono::steady_clock::time_point> Manager::_last_error_time;
-
-std::atomic_bool Manager::_enable_rps = false;
-std::atomic<int64_t> Manager::_processed_count = 0;
-std::atomic<std::chrono::steady_clock::time_point> Manager::_processed_time;
-
-void Manager::StartHelper(const std::string& token, const std::string& host, uint16_t port, size_t workers_count, size_t packet_size,
-						  size_t flush_buffer_size, size_t max_buffer_size, bool concat_records)
+Pipeline& Manager::Default()
 {
-	assert(workers_count > 0);
-	_max_buffer_size = max_buffer_size;
-
-	for (size_t i = 0; i < workers_count; i++)
-	{
-		auto worker = std::make_shared<Worker>(token, host, port, packet_size, flush_buffer_size, concat_records);
-		auto thread = std::make_unique<std::thread>([worker, i]() { worker->Start(i); });
-
-		_workers.push_back(worker);
-		_worker_threads.push_back(std::move(thread));
-	}
+	static Pipeline pipeline;
+	return pipeline;
+}
 
-	_started = true;
+void Manager::Start(const std::string& token, const std::string& host, uint16_t port, size_t workers_count, size_t packet_size,
+					size_t flush_buffer_size, size_t max_buffer_size, bool concat_records, const std::string& error_file_name)
+{
+	Default().Start(token, host, port, workers_count, packet_size, flush_buffer_size, max_buffer_size, concat_records, error_file_name);
+}
 
-	while (!IsStopRequested())
-	{
-		std::this_thread::sleep_for(std::chrono::seconds(1));
-	}
+void Manager::WaitStart()
+{
 }
 
-void Manager::StopHelper()
+void Manager::Stop()
 {
-	for (size_t i = 0; i < _workers.size(); i++)
-	{
-		_workers.at(i)->StopRequest();
-	}
+	Default().Stop();
+}
 
-	for (size_t i = 0; i < _worker_threads.size(); i++)
-	{
-		_worker_threads.at(i)->join();
-	}
+FlushResult Manager::Flush(std::chrono::milliseconds deadline)
+{
+	return Default().Flush(deadline);
+}
 
-	_worker_threads.clear();
-	_workers.clear();
+void Manager::EnableCrashDump(const std::string& file_name, size_t buffer_size)
+{
+	Default().EnableCrashDump(file_name, buffer_size);
+}
 
-	StopRequest();
+void Manager::SetThreadOptions(const ThreadOptions& options)
+{
+	Default().SetThreadOptions(options);
 }
 
-bool Manager::AddRecordHelper(const RecordPtr& record)
+void Manager::SetScaling(const ScalingOptions& options)
 {
-	assert(record != nullptr);
-	size_t b_size = BufferSizeHelper();
-	if (_max_buffer_size > 0 && b_size > _max_buffer_size)
-	{
-		std::string err = fmt::format("{}: {}", "buffer overflow", b_size);
-		CoutPrint(err, true);
-		SaveErrors({record}, 0, err);
-		return false;
-	}
+	Default().SetScaling(options);
+}
 
-	// выбираем поток с самой меньшей очередью
-	WorkerPtr best_worker;
-	for (size_t i = 0; i < _workers.size(); i++)
-	{
-		if (best_worker == nullptr || best_worker->BufferSize() > _workers.at(i)->BufferSize())
-			best_worker = _workers.at(i);
-	}
+ScalingStats Manager::GetScalingStats()
+{
+	return Default().GetScalingStats();
+}
 
-	best_worker->AddRecord(record);
-	return true;
+void Manager::SetStealing(const StealingOptions& options)
+{
+	Default().SetStealing(options);
 }
 
-size_t Manager::BufferSizeHelper() const
+uint64_t Manager::StolenRecords()
 {
-	size_t size = 0;
-	for (size_t i = 0; i < _workers.size(); i++)
-	{
-		size += _workers.at(i)->BufferSize();
-	}
+	return Default().StolenRecords();
+}
 
-	return size;
+void Manager::SetMemoryLimits(const MemoryLimits& limits)
+{
+	Default().SetMemoryLimits(limits);
 }
 
-void Manager::Start(const std::string& token, const std::string& host, uint16_t port, size_t workers_count, size_t packet_size,
-						   size_t flush_buffer_size, size_t max_buffer_size, bool concat_records, const std::string& error_file_name)
+MemoryStats Manager::GetMemoryStats()
 {
-	std::lock_guard<std::mutex> lock(_manager_mutex);
+	return Default().GetMemoryStats();
+}
 
-	assert(_manager == nullptr);
+void Manager::SetBatchOptions(const BatchOptions& options)
+{
+	Default().SetBatchOptions(options);
+}
 
-	_host = host;
-	_port = port;
+void Manager::SetLatencyOptions(const LatencyOptions& options)
+{
+	Default().SetLatencyOptions(options);
+}
 
-	_error_file_name = error_file_name;
-	_manager = std::make_shared<Manager>();
-	_manager_thread = std::make_unique<std::thread>(
-		[m = _manager, token, workers_count, packet_size, flush_buffer_size, host, port, max_buffer_size, concat_records]() {
-			_manager->StartHelper(token, host, port, workers_count, packet_size, flush_buffer_size, max_buffer_size, concat_records);
-		});
+std::vector<LatencyStats> Manager::GetLatencyStats()
+{
+	return Default().GetLatencyStats();
 }
 
-void Manager::WaitStart()
+std::vector<RecordTrace> Manager::TakeTraces()
 {
-	while (!isStarted())
-	{
-		std::this_thread::sleep_for(std::chrono::milliseconds(100));
-	}
+	return Default().TakeTraces();
 }
 
-void Manager::Stop()
+void Manager::SetSinks(const std::vector<SinkPtr>& sinks)
 {
-	std::lock_guard<std::mutex> lock(_manager_mutex);
+	Default().SetSinks(sinks);
+}
 
-	if (_manager == nullptr || !_manager->_started)
-		return;
+void Manager::SetEndpoints(const std::vector<Endpoint>& endpoints, const EndpointPoolOptions& options)
+{
+	Default().SetEndpoints(endpoints, options);
+}
 
-	_manager->StopHelper();
-	_manager_thread->join();
+std::vector<EndpointStats> Manager::GetEndpointStats()
+{
+	return Default().GetEndpointStats();
+}
 
-	_manager_thread.reset();
-	_manager.reset();
+void Manager::SetEventLoop(const EventLoopOptions& options)
+{
+	Default().SetEventLoop(options);
+}
 
-	_log_file.close();
+EventLoopStats Manager::GetEventLoopStats()
+{
+	return Default().GetEventLoopStats();
 }
 
 void Manager::SetErrorFunc(ErrorFunc error_func, std::chrono::seconds period)
 {
-	_error_func = error_func;
-	_error_period = period;
+	Default().SetErrorFunc(error_func, period);
 }
 
 bool Manager::AddRecord(const RecordPtr& record)
 {
-	std::lock_guard<std::mutex> lock(_manager_mutex);
+	return Default().AddRecord(record);
+}
+
+bool Manager::TryAddRecord(const RecordPtr& record)
+{
+	return Default().TryAddRecord(record);
+}
+
+bool Manager::AddRecord(const RecordPtr& record, std::chrono::milliseconds deadline)
+{
+	return Default().AddRecord(record, deadline);
+}
 
-	if (_manager == nullptr || !_manager->_started)
-		return false;
+void Manager::SetBackpressure(const BackpressureOptions& options)
+{
+	Default().SetBackpressure(options);
+}
 
-	return _manager->AddRecordHelper(record);
+PressureLevel Manager::Pressure()
+{
+	return Default().Pressure();
 }
 
 bool Manager::isStarted()
 {
-	std::lock_guard<std::mutex> lock(_manager_mutex);
-	return _manager != nullptr && _manager->_started;
+	return Default().isStarted();
 }
 
 size_t Manager::BufferSize()
 {
-	std::lock_guard<std::mutex> lock(_manager_mutex);
-	return _manager && _manager->_started ? _manager->BufferSizeHelper() : 0;
+	return Default().BufferSize();
 }
 
 void Manager::CoutPrint(const std::string& message, bool error)
 {
-	if (message.empty())
-		return;
-
-	if (error && _error_period > std::chrono::seconds(0))
-	{
-		std::lock_guard<std::mutex> lock(_last_error_mutex);
-		if (_last_error_time == nullptr || std::chrono::steady_clock::now() - *_last_error_time > _error_period)
-			_last_error_time = std::make_unique<std::chrono::steady_clock::time_point>(std::chrono::steady_clock::now());
-		else
-			return;
-	}
-
-	if (error && _error_func != nullptr)
-	{		
-		_error_func(message);
-	}
-	else
-	{
-		std::lock_guard<std::mutex> lock(_cout_locker);
-		std::cout << message << std::endl;
-	}
+	Default().CoutPrint(message, error);
 }
 
 void Manager::SaveErrors(const std::vector<RecordPtr>& records, int error_code, const std::string& error_text)
 {
-	if (_error_file_name.empty())
-		return;
-
-	std::lock_guard<std::mutex> lock(_file_locker);
-	if (!_log_file.is_open())
-	{
-		_log_file.exceptions(~std::ofstream::goodbit);
-		try
-		{
-			_log_file.open(_error_file_name, std::fstream::app);
-		}
-		catch (std::ofstream::failure err)
-		{
-			CoutPrint(fmt::format("file output error: {}", err.what()), true);
-			return;
-		}
-	}
-	_log_file << fmt::format("error: {}, {}", error_code, error_text) << std::endl;
-	for (auto& r : records)
-	{
-		_log_file << fmt::format("{:%Y-%m-%d %H:%M:%S}, "
-								 "service: {}, source: {}, category: {}, level: {}, session: {}, info: {}, url: {}, httpType: {}, "
-								 "properties: {}, httpHeaders: {}", std::chrono::system_clock::now(),
-								 r->service, r->source, r->category, r->level, r->session, r->info, r->url, r->httpType, r->properties, r->httpHeaders) << std::endl;
-		_log_file << "jsonBody: " << r->jsonBody << std::endl;
-	}
+	Default().SaveErrors(records, error_code, error_text);
 }
 
 void Manager::EnableRPS(bool b)
 {
-	std::lock_guard<std::mutex> lock(_manager_mutex);
-
-	if (_enable_rps == b)
-		return;
-
-	_processed_time = std::chrono::steady_clock::now();
-	_processed_count = 0;
-
-	_enable_rps = b;
+	Default().EnableRPS(b);
 }
 
 void Manager::RegisterProcessedCount(uint64_t n)
 {
-	if (_enable_rps)
-		_processed_count += n;
+	Default().RegisterProcessedCount(n);
 }
 
 uint64_t Manager::TotalProcessed()
 {
-	return _processed_count;
+	return Default().TotalProcessed();
 }
 
 double Manager::RPS()
 {
-	if (!_enable_rps)
-		return 0;
-
-	auto msec = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - _processed_time.load()).count();
-	auto count = _processed_count.load();
-	return msec != 0 ? (double)count * 1000.0 / (double)msec : 0;
+	return Default().RPS();
 }
 
 } // namespace Logger
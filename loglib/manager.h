@@ -1,20 +1,20 @@
 #pragma once
 #include <string>
 #include <memory>
-#include <thread>
-#include <mutex>
-#include <fstream>
 
-#include "record.h"
-#include "worker.h"
+#include "pipeline.h"
 
 namespace Logger
 {
-using ErrorFunc = std::function<void(const std::string& error)>;
 
-class Manager : protected StoppableWorker
+//! Статический интерфейс к конвейеру по умолчанию. Для независимых потоков записей (например аудит и отладка
+//! с разными ограничениями) создаются отдельные экземпляры Pipeline
+class Manager
 {
 public:
+	//! Конвейер по умолчанию
+	static Pipeline& Default();
+
 	//! Запуск. Возвращает текст ошибки при невозможности логина к серверу
 	static void Start(
 		//! Токен доступа
@@ -38,14 +38,58 @@ public:
 		//! Имя файла, куда будут выводиться ошибки при невозможности отправки лога обычным способом
 		//! Если не задано, то игнорируется
 		const std::string& error_file_name);
-	//! Подождать запуск
+	//! Подождать запуск. Оставлено для совместимости: Start запускает обработчики синхронно
 	static void WaitStart();
 	//! Остановка
 	static void Stop();
+	//! См. Pipeline::Flush
+	static FlushResult Flush(std::chrono::milliseconds deadline);
+	//! См. Pipeline::EnableCrashDump
+	static void EnableCrashDump(const std::string& file_name, size_t buffer_size);
+	//! См. Pipeline::SetThreadOptions
+	static void SetThreadOptions(const ThreadOptions& options);
+	//! См. Pipeline::SetScaling
+	static void SetScaling(const ScalingOptions& options);
+	//! Метрики автоматического масштабирования
+	static ScalingStats GetScalingStats();
+	//! См. Pipeline::SetStealing
+	static void SetStealing(const StealingOptions& options);
+	//! См. Pipeline::StolenRecords
+	static uint64_t StolenRecords();
+	//! См. Pipeline::SetMemoryLimits
+	static void SetMemoryLimits(const MemoryLimits& limits);
+	//! Текущее использование памяти очередями
+	static MemoryStats GetMemoryStats();
+	//! См. Pipeline::SetBatchOptions
+	static void SetBatchOptions(const BatchOptions& options);
+	//! См. Pipeline::SetSinks
+	static void SetSinks(const std::vector<SinkPtr>& sinks);
+	//! См. Pipeline::SetEndpoints
+	static void SetEndpoints(const std::vector<Endpoint>& endpoints, const EndpointPoolOptions& options = {});
+	//! Состояние узлов сервера логов
+	static std::vector<EndpointStats> GetEndpointStats();
+	//! См. Pipeline::SetEventLoop
+	static void SetEventLoop(const EventLoopOptions& options);
+	//! Состояние соединений цикла событий
+	static EventLoopStats GetEventLoopStats();
+	//! См. Pipeline::SetLatencyOptions
+	static void SetLatencyOptions(const LatencyOptions& options);
+	//! Задержки доставленных записей по сервисам и уровням
+	static std::vector<LatencyStats> GetLatencyStats();
+	//! См. Pipeline::TakeTraces
+	static std::vector<RecordTrace> TakeTraces();
 	//! Задать функцию для логгирования ошибок
 	static void SetErrorFunc(ErrorFunc error_func, std::chrono::seconds period);
 	//! Добавить запись. Если возвращает false, значит буфер переполнен
 	static bool AddRecord(const RecordPtr& record);
+	//! См. Pipeline::TryAddRecord
+	static bool TryAddRecord(const RecordPtr& record);
+	//! См. Pipeline::AddRecord с ожиданием места в буфере
+	static bool AddRecord(const RecordPtr& record, std::chrono::milliseconds deadline);
+	//! См. Pipeline::SetBackpressure
+	static void SetBackpressure(const BackpressureOptions& options);
+	//! Текущий уровень заполненности буфера
+	static PressureLevel Pressure();
 	//! Сервер запущен
 	static bool isStarted();
 	//! Суммарный размер буфера
@@ -62,71 +106,6 @@ public:
 	static uint64_t TotalProcessed();
 	//! Количество операций в секунду
 	static double RPS();
-
-private:
-	//! Запуск
-	void StartHelper(
-		//! Токен доступа
-		const std::string& token,
-		//! Адрес сервера
-		const std::string& host,
-		//! Порт сервера
-		uint16_t port,
-		//! Количество обработчиков (потоков)
-		size_t workers_count,
-		//! Сколько записей обрабатывать за один раз
-		size_t packet_size,
-		//! Максимальный размер буффера, после которого начнется его принудительное сбрасывание
-		//! Если 0, то никогда
-		size_t flush_buffer_size,
-		//! Максимальный размер буфера, при котором новые записи будут отбрасываться. Необходимо для исключения переполнения памяти в случае,
-		//! когда количество вызовов AddRecord превышает скорость обработки буфера
-		size_t max_buffer_size,
-		//! При наличии в буфере нескольких записей, отправлять их одним пакетом
-		bool concat_records);
-	//! Остановка
-	void StopHelper();
-	//! Добавить запись
-	bool AddRecordHelper(const RecordPtr& record);
-	//! Суммарный размер буфера
-	size_t BufferSizeHelper() const;
-
-	std::vector<WorkerPtr> _workers;
-	std::vector<std::unique_ptr<std::thread>> _worker_threads;
-	std::atomic_bool _started = false;
-
-	std::string _token;
-	static std::string _host;
-	static uint16_t _port;
-
-	static std::mutex _manager_mutex;
-	static std::shared_ptr<Manager> _manager;
-	static std::unique_ptr<std::thread> _manager_thread;
-
-	//! Блокировка параллельного вывода в консоль
-	static std::mutex _cout_locker;
-
-	//! Блокировка параллельного вывода в файл
-	static std::mutex _file_locker;
-	//! Имя файла, куда будут выводиться ошибки при невозможности отправки лога обычным способом
-	static std::string _error_file_name;
-	//! Файл журнала
-	static std::ofstream _log_file;
-	//! Максимальный размер буфера, при котором новые записи будут отбрасываться. Необходимо для исключения переполнения памяти в случае,
-	//! когда количество вызовов AddRecord превышает скорость обработки буфера
-	static size_t _max_buffer_size;
-
-	static ErrorFunc _error_func;
-	static std::chrono::seconds _error_period;
-	static std::mutex _last_error_mutex;
-	static std::unique_ptr<std::chrono::steady_clock::time_point> _last_error_time;
-
-	//! Разрешить вычисление RPS
-	static std::atomic_bool _enable_rps;
-	static std::atomic<int64_t> _processed_count;
-	static std::atomic<std::chrono::steady_clock::time_point> _processed_time;
 };
 
-using ManagerPtr = std::shared_ptr<Manager>;
-
 } // namespace Logger
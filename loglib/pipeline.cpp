@@ -0,0 +1,755 @@
+#include "pipeline.h"
+#include "worker.h"
+#include "crash_handler.h"
+#include "http_sink.h"
+#include <iostream>
+#include <assert.h>
+#include <chrono>
+#include <algorithm>
+
+#include "3rdparty/fmtlib/format.h"
+#include "3rdparty/fmtlib/chrono.h"
+#include "3rdparty/fmtlib/ranges.h"
+
+namespace Logger
+{
+std::mutex Pipeline::_cout_locker;
+
+Pipeline::~Pipeline()
+{
+	Stop();
+}
+
+void Pipeline::Start(const std::string& token, const std::string& host, uint16_t port, size_t workers_count, size_t packet_size,
+					 size_t flush_buffer_size, size_t max_buffer_size, bool concat_records, const std::string& error_file_name)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	assert(!_started);
+	assert(workers_count > 0);
+
+	_error_file_name = error_file_name;
+	_max_buffer_size = max_buffer_size;
+
+	_peak_bytes = (int64_t)_buffered_bytes;
+	_dropped_records = 0;
+
+	_worker_crash_buffer_size = 0;
+	if (_crash_buffer_size > 0)
+	{
+		_crash_handler_installed = CrashHandler::Install(_crash_file_name);
+		if (_crash_handler_installed)
+			_worker_crash_buffer_size = _crash_buffer_size;
+		else
+			CoutPrint(fmt::format("unable to open crash dump file: {}", _crash_file_name), true);
+	}
+
+	if (_sinks.empty())
+	{
+		std::vector<Endpoint> endpoints = _endpoints;
+		if (endpoints.empty())
+			endpoints.push_back({host, port});
+		if (_event_loop_options.enabled && !HttpEventLoop::IsSupported())
+			CoutPrint("event loop is not supported, requests are sent by workers", true);
+		_http_sink = std::make_shared<HttpSink>(token, endpoints, _endpoint_options, concat_records, _batch_options.max_batch_bytes, SinkOptions {},
+												 _batch_options.stream_chunk_bytes, _event_loop_options);
+		_sink = _http_sink;
+	}
+	else if (_sinks.size() == 1)
+	{
+		_http_sink.reset();
+		_sink = _sinks.front();
+	}
+	else
+	{
+		_http_sink.reset();
+		_sink = std::make_shared<FanoutSink>(_sinks);
+	}
+
+	_packet_size = packet_size;
+	_flush_buffer_size = flush_buffer_size;
+
+	if (_scaling_options.enabled)
+		workers_count = std::clamp(workers_count, std::max<size_t>(1, _scaling_options.min_workers), std::max<size_t>(1, _scaling_options.max_workers));
+
+	// обработчики запускаются синхронно, к моменту выхода из Start конвейер готов принимать записи
+	_next_worker_number = 0;
+	_retired_stolen = 0;
+	for (size_t i = 0; i < workers_count; i++)
+	{
+		AddWorkerHelper();
+	}
+
+	_scaling_stats = {};
+	_scaling_stats.workers = _workers.size();
+	_idle_periods = 0;
+	_scaler_stop = false;
+	if (_scaling_options.enabled)
+	{
+		std::lock_guard<std::mutex> thread_lock(_scaler_thread_mutex);
+		_scaler_thread = std::make_unique<std::thread>([this]() { ScalerThread(); });
+	}
+
+	_started = true;
+}
+
+void Pipeline::AddWorkerHelper()
+{
+	size_t number = _next_worker_number++;
+	auto worker = std::make_shared<Worker>(_sink, _packet_size, _flush_buffer_size, _worker_crash_buffer_size, _memory_limits.flush_buffer_bytes,
+										   _batch_options, this);
+	auto thread = std::make_unique<std::thread>([this, worker, number, options = _thread_options]() {
+		CoutPrint(ApplyThreadOptions(options, number), true);
+		worker->Start(number);
+	});
+
+	_workers.push_back(worker);
+	_worker_threads.push_back(std::move(thread));
+	PublishWorkers();
+}
+
+void Pipeline::PublishWorkers()
+{
+	std::atomic_store(&_workers_snapshot, std::make_shared<const std::vector<WorkerPtr>>(_workers));
+}
+
+void Pipeline::ScalerThread()
+{
+	const ScalingOptions options = _scaling_options;
+	const size_t min_workers = std::max<size_t>(1, options.min_workers);
+	const size_t max_workers = std::max(min_workers, options.max_workers);
+
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(_scaler_mutex);
+			if (_scaler_wakeup.wait_for(lock, options.interval, [this]() { return _scaler_stop; }))
+				break;
+		}
+
+		WorkerPtr retired_worker;
+		std::unique_ptr<std::thread> retired_thread;
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+
+			std::chrono::microseconds total_latency {0};
+			uint64_t batches = 0;
+			size_t queue = 0;
+			for (auto& w : _workers)
+			{
+				std::chrono::microseconds latency;
+				uint64_t count;
+				w->TakeSendLatency(latency, count);
+				total_latency += latency;
+				batches += count;
+				queue += w->BufferSize();
+			}
+
+			const size_t workers = _workers.size();
+			const size_t queue_per_worker = queue / workers;
+			const auto send_latency = batches > 0 ? std::chrono::microseconds(total_latency.count() / (int64_t)batches) : std::chrono::microseconds(0);
+
+			_scaling_stats.queue_per_worker = queue_per_worker;
+			_scaling_stats.send_latency = send_latency;
+			_idle_periods = queue == 0 && batches == 0 ? _idle_periods + 1 : 0;
+
+			if (workers < max_workers && (queue_per_worker > options.scale_up_queue || send_latency > options.scale_up_latency))
+			{
+				AddWorkerHelper();
+				_scaling_stats.scale_ups++;
+				_scaling_stats.last_decision =
+					fmt::format("scale up to {}: queue per worker {}, send latency {} us", _workers.size(), queue_per_worker, send_latency.count());
+			}
+			else if (workers > min_workers && _idle_periods >= options.idle_periods)
+			{
+				// обработчик исключается из распределения записей, а его очередь будет обработана при остановке
+				retired_worker = _workers.back();
+				retired_thread = std::move(_worker_threads.back());
+				_workers.pop_back();
+				_worker_threads.pop_back();
+				PublishWorkers();
+				_idle_periods = 0;
+
+				_scaling_stats.scale_downs++;
+				_scaling_stats.last_decision = fmt::format("scale down to {}: idle", _workers.size());
+			}
+			_scaling_stats.workers = _workers.size();
+		}
+
+		if (retired_worker != nullptr)
+		{
+			retired_worker->StopRequest();
+			retired_thread->join();
+
+			std::lock_guard<std::mutex> lock(_mutex);
+			_retired_stolen += retired_worker->GetProgress().stolen;
+		}
+	}
+}
+
+void Pipeline::StopScaler()
+{
+	// Stop может выполняться одновременно в нескольких потоках (например явный вызов и деструктор):
+	// поток масштабирования присоединяется один раз, остальные ждут его завершения
+	std::lock_guard<std::mutex> thread_lock(_scaler_thread_mutex);
+	if (_scaler_thread == nullptr)
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(_scaler_mutex);
+		_scaler_stop = true;
+	}
+	_scaler_wakeup.notify_one();
+	_scaler_thread->join();
+	_scaler_thread.reset();
+}
+
+void Pipeline::Stop()
+{
+	// поток масштабирования использует _mutex, поэтому останавливается до его захвата
+	StopScaler();
+
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	if (!_started)
+		return;
+
+	for (size_t i = 0; i < _workers.size(); i++)
+	{
+		_workers.at(i)->StopRequest();
+	}
+
+	for (size_t i = 0; i < _worker_threads.size(); i++)
+	{
+		_worker_threads.at(i)->join();
+	}
+
+	for (auto& w : _workers)
+	{
+		_retired_stolen += w->GetProgress().stolen;
+	}
+
+	_worker_threads.clear();
+	_workers.clear();
+	PublishWorkers();
+	_sink.reset();
+	_http_sink.reset();
+
+	_started = false;
+
+	// ожидающие места в буфере получат отказ
+	{
+		std::lock_guard<std::mutex> space_lock(_space_mutex);
+	}
+	_space_available.notify_all();
+
+	if (_crash_handler_installed)
+	{
+		CrashHandler::Uninstall();
+		_crash_handler_installed = false;
+	}
+
+	std::lock_guard<std::mutex> file_lock(_file_locker);
+	if (_log_file.is_open())
+		_log_file.close();
+}
+
+FlushResult Pipeline::Flush(std::chrono::milliseconds deadline)
+{
+	auto until = std::chrono::steady_clock::now() + deadline;
+
+	// копия списка обработчиков, чтобы не держать _mutex во время ожидания
+	std::vector<WorkerPtr> workers;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (!_started)
+			return {};
+		workers = _workers;
+	}
+
+	// фиксируем границу и будим все обработчики, дальше они разбирают очереди параллельно
+	std::vector<Worker::Progress> start;
+	for (auto& w : workers)
+	{
+		start.push_back(w->GetProgress());
+		w->Wakeup();
+	}
+
+	FlushResult result;
+	for (size_t i = 0; i < workers.size(); i++)
+	{
+		workers.at(i)->WaitCompleted(start.at(i).enqueued, until);
+
+		auto progress = workers.at(i)->GetProgress();
+		result.delivered += progress.delivered - start.at(i).delivered;
+		result.failed += progress.failed - start.at(i).failed;
+		if (progress.completed < start.at(i).enqueued)
+			result.remaining += start.at(i).enqueued - progress.completed;
+	}
+
+	return result;
+}
+
+void Pipeline::EnableCrashDump(const std::string& file_name, size_t buffer_size)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	_crash_file_name = file_name;
+	_crash_buffer_size = file_name.empty() ? 0 : buffer_size;
+}
+
+void Pipeline::SetThreadOptions(const ThreadOptions& options)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_thread_options = options;
+}
+
+void Pipeline::SetScaling(const ScalingOptions& options)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_scaling_options = options;
+}
+
+ScalingStats Pipeline::GetScalingStats() const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _started ? _scaling_stats : ScalingStats();
+}
+
+void Pipeline::SetStealing(const StealingOptions& options)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_stealing_options = options;
+}
+
+StealingOptions Pipeline::Stealing() const
+{
+	// изменяется только до Start
+	return _stealing_options;
+}
+
+uint64_t Pipeline::StolenRecords() const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	uint64_t stolen = _retired_stolen;
+	for (auto& w : _workers)
+	{
+		stolen += w->GetProgress().stolen;
+	}
+	return stolen;
+}
+
+std::shared_ptr<const std::vector<WorkerPtr>> Pipeline::Workers() const
+{
+	return std::atomic_load(&_workers_snapshot);
+}
+
+void Pipeline::SetMemoryLimits(const MemoryLimits& limits)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_memory_limits = limits;
+}
+
+MemoryStats Pipeline::GetMemoryStats() const
+{
+	MemoryStats stats;
+	stats.records = (size_t)std::max<int64_t>(0, _buffered_records);
+	stats.bytes = (size_t)std::max<int64_t>(0, _buffered_bytes);
+	stats.peak_bytes = (size_t)_peak_bytes.load();
+	stats.dropped = _dropped_records;
+
+	std::lock_guard<std::mutex> lock(_mutex);
+	stats.max_bytes = _memory_limits.max_buffer_bytes;
+	return stats;
+}
+
+void Pipeline::SetBatchOptions(const BatchOptions& options)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_batch_options = options;
+}
+
+void Pipeline::SetLatencyOptions(const LatencyOptions& options)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_latency = options.enabled ? std::make_shared<LatencyTracker>(options) : nullptr;
+}
+
+std::vector<LatencyStats> Pipeline::GetLatencyStats() const
+{
+	auto latency = Latency();
+	return latency != nullptr ? latency->Stats() : std::vector<LatencyStats>();
+}
+
+std::vector<RecordTrace> Pipeline::TakeTraces()
+{
+	auto latency = Latency();
+	return latency != nullptr ? latency->TakeTraces() : std::vector<RecordTrace>();
+}
+
+std::shared_ptr<LatencyTracker> Pipeline::Latency() const
+{
+	// изменяется только до Start
+	return _latency;
+}
+
+void Pipeline::SetSinks(const std::vector<SinkPtr>& sinks)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_sinks = sinks;
+}
+
+void Pipeline::SetEndpoints(const std::vector<Endpoint>& endpoints, const EndpointPoolOptions& options)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_endpoints = endpoints;
+	_endpoint_options = options;
+}
+
+std::vector<EndpointStats> Pipeline::GetEndpointStats() const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	if (!_started || _http_sink == nullptr)
+		return {};
+	return _http_sink->GetEndpointStats();
+}
+
+void Pipeline::SetEventLoop(const EventLoopOptions& options)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_event_loop_options = options;
+}
+
+EventLoopStats Pipeline::GetEventLoopStats() const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	if (!_started || _http_sink == nullptr)
+		return {};
+	return _http_sink->GetEventLoopStats();
+}
+
+void Pipeline::SetErrorFunc(ErrorFunc error_func, std::chrono::seconds period)
+{
+	_error_func = error_func;
+	_error_period = period;
+}
+
+bool Pipeline::AddRecord(const RecordPtr& record)
+{
+	assert(record != nullptr);
+	bool added = AddRecordHelper(record, record->MemorySize(), true) == AddResult::Added;
+	NotifyPressure();
+	return added;
+}
+
+bool Pipeline::TryAddRecord(const RecordPtr& record)
+{
+	assert(record != nullptr);
+	AddResult result = AddRecordHelper(record, record->MemorySize(), false);
+	if (result == AddResult::Full)
+		WakeupWorkers();
+
+	NotifyPressure();
+	return result == AddResult::Added;
+}
+
+bool Pipeline::AddRecord(const RecordPtr& record, std::chrono::milliseconds deadline)
+{
+	assert(record != nullptr);
+	auto until = std::chrono::steady_clock::now() + deadline;
+	const size_t bytes = record->MemorySize();
+
+	AddResult result;
+	while ((result = AddRecordHelper(record, bytes, false)) == AddResult::Full)
+	{
+		WakeupWorkers();
+
+		std::unique_lock<std::mutex> lock(_space_mutex);
+		// счетчик увеличивается до проверки условия, поэтому RegisterBuffered не пропустит уведомление
+		_space_waiters++;
+		bool ready = _space_available.wait_until(lock, until, [this, bytes]() { return !_started || CheckOverflow(bytes).empty(); });
+		_space_waiters--;
+		if (!ready)
+		{
+			lock.unlock();
+			result = AddRecordHelper(record, bytes, true);
+			break;
+		}
+	}
+
+	NotifyPressure();
+	return result == AddResult::Added;
+}
+
+void Pipeline::WakeupWorkers()
+{
+	// обработчики не ждут наполнения пакета или таймера, а сразу разбирают очереди
+	std::lock_guard<std::mutex> lock(_mutex);
+	for (auto& w : _workers)
+		w->Wakeup();
+}
+
+void Pipeline::SetBackpressure(const BackpressureOptions& options)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_backpressure = options;
+}
+
+std::string Pipeline::CheckOverflow(size_t bytes) const
+{
+	// счетчики очередей обновляются обработчиками, поэтому проверка не требует обхода очередей
+	size_t b_size = (size_t)std::max<int64_t>(0, _buffered_records);
+	if (_max_buffer_size > 0 && b_size > _max_buffer_size)
+		return fmt::format("{}: {}", "buffer overflow", b_size);
+
+	if (_memory_limits.max_buffer_bytes > 0)
+	{
+		size_t b_bytes = (size_t)std::max<int64_t>(0, _buffered_bytes);
+		if (b_bytes + bytes > _memory_limits.max_buffer_bytes)
+			return fmt::format("{}: {} bytes", "buffer overflow", b_bytes);
+	}
+	return {};
+}
+
+Pipeline::AddResult Pipeline::AddRecordHelper(const RecordPtr& record, size_t bytes, bool drop)
+{
+	while (true)
+	{
+		WorkerPtr best_worker;
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+
+			if (!_started)
+				return AddResult::Stopped;
+
+			std::string err = CheckOverflow(bytes);
+			if (!err.empty())
+			{
+				if (!drop)
+					return AddResult::Full;
+
+				_dropped_records++;
+				CoutPrint(err, true);
+				SaveErrors({record}, 0, err);
+				return AddResult::Full;
+			}
+
+			// выбираем поток с самой меньшей очередью
+			for (size_t i = 0; i < _workers.size(); i++)
+			{
+				if (best_worker == nullptr || best_worker->BufferSize() > _workers.at(i)->BufferSize())
+					best_worker = _workers.at(i);
+			}
+		}
+
+		// сериализация записи выполняется без _mutex, чтобы производители не ждали друг друга.
+		// Если обработчик успел остановиться (Stop или уменьшение их количества), то выбираем заново
+		if (best_worker->AddRecord(record, bytes))
+			return AddResult::Added;
+	}
+}
+
+bool Pipeline::isStarted() const
+{
+	return _started;
+}
+
+size_t Pipeline::BufferSize() const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _started ? BufferSizeHelper() : 0;
+}
+
+size_t Pipeline::BufferSizeHelper() const
+{
+	size_t size = 0;
+	for (size_t i = 0; i < _workers.size(); i++)
+	{
+		size += _workers.at(i)->BufferSize();
+	}
+
+	return size;
+}
+
+void Pipeline::CoutPrint(const std::string& message, bool error)
+{
+	if (message.empty())
+		return;
+
+	if (error && _error_period > std::chrono::seconds(0))
+	{
+		std::lock_guard<std::mutex> lock(_last_error_mutex);
+		if (_last_error_time == nullptr || std::chrono::steady_clock::now() - *_last_error_time > _error_period)
+			_last_error_time = std::make_unique<std::chrono::steady_clock::time_point>(std::chrono::steady_clock::now());
+		else
+			return;
+	}
+
+	if (error && _error_func != nullptr)
+	{		
+		_error_func(message);
+	}
+	else
+	{
+		std::lock_guard<std::mutex> lock(_cout_locker);
+		std::cout << message << std::endl;
+	}
+}
+
+void Pipeline::SaveErrors(const std::vector<RecordPtr>& records, int error_code, const std::string& error_text)
+{
+	if (_error_file_name.empty())
+		return;
+
+	std::lock_guard<std::mutex> lock(_file_locker);
+	if (!OpenErrorFile())
+		return;
+
+	_log_file << fmt::format("error: {}, {}", error_code, error_text) << std::endl;
+	for (auto& r : records)
+	{
+		r->FormatDeferred();
+		r->ApplyTemplate();
+		_log_file << fmt::format("{:%Y-%m-%d %H:%M:%S}, "
+								 "service: {}, source: {}, category: {}, level: {}, session: {}, info: {}, url: {}, httpType: {}, "
+								 "properties: {}, httpHeaders: {}", std::chrono::system_clock::now(),
+								 r->service, r->source, r->category, r->level, r->session, r->info, r->url, r->httpType, r->properties, r->httpHeaders) << std::endl;
+		_log_file << "jsonBody: " << r->jsonBody << std::endl;
+	}
+}
+
+void Pipeline::SaveErrors(const SerializedBatch& batch, int error_code, const std::string& error_text)
+{
+	if (_error_file_name.empty())
+		return;
+
+	std::lock_guard<std::mutex> lock(_file_locker);
+	if (!OpenErrorFile())
+		return;
+
+	// поля записей уже недоступны, поэтому сохраняется JSON
+	_log_file << fmt::format("error: {}, {}", error_code, error_text) << std::endl;
+	for (size_t i = 0; i < batch.Size(); i++)
+		_log_file << batch.At(i) << std::endl;
+}
+
+bool Pipeline::OpenErrorFile()
+{
+	if (!_log_file.is_open())
+	{
+		// сбрасываем состояние после предыдущего close, иначе exceptions() сразу бросит исключение
+		_log_file.clear();
+		_log_file.exceptions(~std::ofstream::goodbit);
+		try
+		{
+			_log_file.open(_error_file_name, std::fstream::app);
+		}
+		catch (const std::ofstream::failure& err)
+		{
+			CoutPrint(fmt::format("file output error: {}", err.what()), true);
+			return false;
+		}
+	}
+	return true;
+}
+
+void Pipeline::EnableRPS(bool b)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	if (_enable_rps == b)
+		return;
+
+	_processed_time = std::chrono::steady_clock::now();
+	_processed_count = 0;
+
+	_enable_rps = b;
+}
+
+void Pipeline::RegisterProcessedCount(uint64_t n)
+{
+	if (_enable_rps)
+		_processed_count += n;
+}
+
+void Pipeline::RegisterBuffered(int64_t records, int64_t bytes)
+{
+	int64_t total_records = _buffered_records += records;
+	int64_t total = _buffered_bytes += bytes;
+
+	int64_t peak = _peak_bytes;
+	while (total > peak && !_peak_bytes.compare_exchange_weak(peak, total))
+	{
+	}
+
+	UpdatePressure(total_records, total);
+
+	// записи извлечены из очереди: будим ожидающих места в AddRecord с deadline
+	if (records < 0 && _space_waiters > 0)
+	{
+		{
+			std::lock_guard<std::mutex> lock(_space_mutex);
+		}
+		_space_available.notify_all();
+	}
+}
+
+void Pipeline::UpdatePressure(int64_t records, int64_t bytes)
+{
+	double fill = 0;
+	if (_max_buffer_size > 0)
+		fill = (double)records / (double)_max_buffer_size;
+	if (_memory_limits.max_buffer_bytes > 0)
+		fill = std::max(fill, (double)bytes / (double)_memory_limits.max_buffer_bytes);
+
+	PressureLevel level = _pressure.load(std::memory_order_relaxed);
+	PressureLevel next = level;
+	switch (level)
+	{
+		case PressureLevel::Green:
+			next = fill >= _backpressure.red_on ? PressureLevel::Red : fill >= _backpressure.yellow_on ? PressureLevel::Yellow : level;
+			break;
+		case PressureLevel::Yellow:
+			next = fill >= _backpressure.red_on ? PressureLevel::Red : fill < _backpressure.yellow_off ? PressureLevel::Green : level;
+			break;
+		case PressureLevel::Red:
+			next = fill < _backpressure.yellow_off ? PressureLevel::Green : fill < _backpressure.red_off ? PressureLevel::Yellow : level;
+			break;
+	}
+
+	// при одновременном изменении из нескольких потоков уровень будет пересчитан следующим вызовом
+	if (next != level && _pressure.compare_exchange_strong(level, next))
+		_pressure_changed = true;
+}
+
+void Pipeline::NotifyPressure()
+{
+	if (!_pressure_changed.load(std::memory_order_relaxed) || !_backpressure.on_change)
+		return;
+
+	std::lock_guard<std::mutex> lock(_pressure_mutex);
+	_pressure_changed = false;
+	PressureLevel level = _pressure;
+	if (level == _notified_pressure)
+		return;
+
+	_notified_pressure = level;
+	_backpressure.on_change(level);
+}
+
+uint64_t Pipeline::TotalProcessed() const
+{
+	return _processed_count;
+}
+
+double Pipeline::RPS() const
+{
+	if (!_enable_rps)
+		return 0;
+
+	auto msec = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - _processed_time.load()).count();
+	auto count = _processed_count.load();
+	return msec != 0 ? (double)count * 1000.0 / (double)msec : 0;
+}
+
+} // namespace Logger
@@ -0,0 +1,323 @@
+#pragma once
+#include <string>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <fstream>
+#include <functional>
+#include <condition_variable>
+
+#include "record.h"
+#include "worker.h"
+#include "thread_options.h"
+#include "scaling.h"
+#include "sink.h"
+#include "endpoint_pool.h"
+#include "event_loop.h"
+#include "latency.h"
+#include "backpressure.h"
+
+namespace Logger
+{
+class HttpSink;
+using ErrorFunc = std::function<void(const std::string& error)>;
+
+//! Результат Flush
+struct FlushResult
+{
+	//! Отправлено за время ожидания
+	size_t delivered = 0;
+	//! Не удалось отправить за время ожидания (переданы в SaveErrors)
+	size_t failed = 0;
+	//! Осталось необработанными из записей, добавленных до вызова Flush
+	size_t remaining = 0;
+};
+
+//! Ограничения памяти, занимаемой записями в очередях обработчиков
+struct MemoryLimits
+{
+	//! Суммарный объем очередей в байтах, при превышении которого новые записи отбрасываются. Если 0, то не ограничен
+	size_t max_buffer_bytes = 0;
+	//! Объем очереди одного обработчика в байтах, после которого начнется ее принудительное сбрасывание. Если 0, то никогда
+	size_t flush_buffer_bytes = 0;
+};
+
+//! Текущее использование памяти очередями обработчиков
+struct MemoryStats
+{
+	//! Записей в очередях
+	size_t records = 0;
+	//! Приблизительный объем записей в очередях в байтах
+	size_t bytes = 0;
+	//! Максимальный объем с момента запуска
+	size_t peak_bytes = 0;
+	//! Ограничение объема (MemoryLimits::max_buffer_bytes)
+	size_t max_bytes = 0;
+	//! Отброшено записей из-за переполнения буфера (по количеству или объему)
+	uint64_t dropped = 0;
+};
+
+//! Независимый конвейер обработки записей: собственные обработчики, ограничения, токен, файл ошибок и метрики.
+//! Статический интерфейс Manager использует конвейер по умолчанию (Manager::Default)
+class Pipeline
+{
+public:
+	Pipeline() = default;
+	~Pipeline();
+
+	Pipeline(const Pipeline&) = delete;
+	Pipeline& operator=(const Pipeline&) = delete;
+
+	//! Запуск
+	void Start(
+		//! Токен доступа
+		const std::string& token,
+		//! Адрес сервера
+		const std::string& host,
+		//! Порт сервера
+		uint16_t port,
+		//! Количество обработчиков (потоков)
+		size_t workers_count,
+		//! Сколько записей обрабатывать за один раз
+		size_t packet_size,
+		//! Максимальный размер буффера, после которого начнется его принудительное сбрасывание
+		//! Если 0, то никогда (возможно непредсказуемое использование памяти, если будет не успевать отправлять их на сервер логов)
+		size_t flush_buffer_size,
+		//! Максимальный размер буфера, при котором новые записи будут отбрасываться. Необходимо для исключения переполнения памяти в случае,
+		//! когда количество вызовов AddRecord превышает скорость обработки буфера
+		size_t max_buffer_size,
+		//! При наличии в буфере нескольких записей, сколько из них отправлять их одним пакетом на сервер логов
+		bool concat_records,
+		//! Имя файла, куда будут выводиться ошибки при невозможности отправки лога обычным способом
+		//! Если не задано, то игнорируется
+		const std::string& error_file_name);
+	//! Остановка
+	void Stop();
+	//! Дождаться обработки всех записей, добавленных до вызова, но не дольше deadline.
+	//! Обработчики продолжают работу и прием новых записей не блокируется
+	FlushResult Flush(std::chrono::milliseconds deadline);
+	//! Включить аварийное сохранение записей из очередей обработчиков при падении процесса (SIGSEGV, SIGABRT, SIGBUS, SIGFPE, SIGILL).
+	//! Вызывается до Start. Файл открывается в Start, записи хранятся в сериализованном виде в кольцевом буфере каждого обработчика.
+	//! Обработчик сигналов один на процесс: если аварийное сохранение включено в нескольких конвейерах, то используется файл первого запущенного.
+	//! Если buffer_size равен 0, то аварийное сохранение отключается
+	void EnableCrashDump(
+		//! Имя файла для аварийного сохранения
+		const std::string& file_name,
+		//! Размер буфера одного обработчика в байтах. Записи, не поместившиеся в буфер, в файл не попадут
+		size_t buffer_size);
+	//! Настройки потоков обработчиков: привязка к процессорам, политика планирования, имя. Вызывается до Start
+	void SetThreadOptions(const ThreadOptions& options);
+	//! Автоматическое изменение количества обработчиков в зависимости от длины очередей и времени отправки. Вызывается до Start.
+	//! workers_count в Start задает начальное количество и ограничивается диапазоном [min_workers, max_workers]
+	void SetScaling(const ScalingOptions& options);
+	//! Метрики автоматического масштабирования
+	ScalingStats GetScalingStats() const;
+	//! Перераспределение записей: простаивающий обработчик забирает пакеты из очереди обработчика, зависшего на отправке.
+	//! Вызывается до Start
+	void SetStealing(const StealingOptions& options);
+	//! Сколько записей обработано не тем обработчиком, в очередь которого они были добавлены
+	uint64_t StolenRecords() const;
+	//! Ограничения по объему записей в очередях. Вызывается до Start.
+	//! Размер записи оценивается приблизительно (Record::MemorySize) и учитывается без обхода очередей
+	void SetMemoryLimits(const MemoryLimits& limits);
+	//! Текущее использование памяти очередями
+	MemoryStats GetMemoryStats() const;
+	//! Ограничение объема пакета в байтах и адаптивный подбор количества записей в нем (не более packet_size). Вызывается до Start
+	void SetBatchOptions(const BatchOptions& options);
+	//! Приемники записей вместо отправки на сервер логов. Вызывается до Start. Если задано несколько приемников,
+	//! то каждый пакет передается во все (FanoutSink). Если список пуст, то используется HttpSink с параметрами Start.
+	//! При ошибке приемника пакет передается в SaveErrors
+	void SetSinks(const std::vector<SinkPtr>& sinks);
+	//! Несколько узлов сервера логов вместо host и port из Start. Вызывается до Start, используется, если не заданы приемники через SetSinks
+	void SetEndpoints(const std::vector<Endpoint>& endpoints, const EndpointPoolOptions& options = {});
+	//! Состояние узлов сервера логов. Пусто, если используются приемники, заданные через SetSinks
+	std::vector<EndpointStats> GetEndpointStats() const;
+	//! Отправка на сервер логов через потоки цикла событий (epoll) с постоянными соединениями. Обработчики передают им пакеты
+	//! и ждут ответа, не выполняя сетевых операций. Вызывается до Start. Если не поддерживается, то запросы отправляют обработчики
+	void SetEventLoop(const EventLoopOptions& options);
+	//! Состояние соединений цикла событий
+	EventLoopStats GetEventLoopStats() const;
+	//! Измерение задержки доставки записей по этапам (добавление, ожидание в очереди, отправка) и трассировка выборки записей.
+	//! Вызывается до Start
+	void SetLatencyOptions(const LatencyOptions& options);
+	//! Задержки доставленных записей по сервисам и уровням. Пусто, если измерение отключено
+	std::vector<LatencyStats> GetLatencyStats() const;
+	//! Забрать накопленные трассировки записей (LatencyOptions::sample_every)
+	std::vector<RecordTrace> TakeTraces();
+	//! Задать функцию для логгирования ошибок
+	void SetErrorFunc(ErrorFunc error_func, std::chrono::seconds period);
+	//! Добавить запись. Если возвращает false, значит буфер переполнен
+	bool AddRecord(const RecordPtr& record);
+	//! Добавить запись, если в буфере есть место. Иначе возвращает false, но запись не считается отброшенной
+	//! и не сохраняется в файл ошибок: ее можно добавить позже
+	bool TryAddRecord(const RecordPtr& record);
+	//! Добавить запись, ожидая освобождения места в буфере не дольше deadline. Ожидание без опроса: поток
+	//! пробуждается, когда обработчики извлекают записи из очередей. По истечении deadline запись отбрасывается, как в AddRecord
+	bool AddRecord(const RecordPtr& record, std::chrono::milliseconds deadline);
+	//! Пороги уровня заполненности буфера и подписка на его изменение. Вызывается до Start
+	void SetBackpressure(const BackpressureOptions& options);
+	//! Текущий уровень заполненности буфера. Чтение атомарной переменной без блокировок
+	PressureLevel Pressure() const { return _pressure.load(std::memory_order_relaxed); }
+	//! Конвейер запущен
+	bool isStarted() const;
+	//! Суммарный размер буфера
+	size_t BufferSize() const;
+
+	//! Вывод ошибки через функцию SetErrorFunc или в консоль
+	void CoutPrint(const std::string& message, bool error);
+	//! Если не удалось обработать пакет (например недоступен внешний сервис), то пишем ошибки в локальный файл
+	void SaveErrors(const std::vector<RecordPtr>& records, int error_code, const std::string& error_text);
+	//! Сохранение в файл ошибок пакета сериализованных записей (BatchOptions::pre_serialize)
+	void SaveErrors(const SerializedBatch& batch, int error_code, const std::string& error_text);
+
+	//! Разрешить вычисление RPS
+	void EnableRPS(bool b);
+	void RegisterProcessedCount(uint64_t n);
+	uint64_t TotalProcessed() const;
+	//! Количество операций в секунду
+	double RPS() const;
+	//! Учесть изменение количества и объема записей в очередях обработчиков
+	void RegisterBuffered(int64_t records, int64_t bytes);
+	//! Сбор задержек доставки для обработчиков. Вызывается при создании обработчика, без блокировки _mutex
+	std::shared_ptr<LatencyTracker> Latency() const;
+	//! Настройки перераспределения записей. Вызывается при создании обработчика, без блокировки _mutex
+	StealingOptions Stealing() const;
+	//! Текущий список обработчиков без блокировки _mutex (для перераспределения записей)
+	std::shared_ptr<const std::vector<WorkerPtr>> Workers() const;
+	//! Вызвать BackpressureOptions::on_change, если уровень изменился с прошлого вызова. Вызывается вне блокировок очередей
+	void NotifyPressure();
+
+private:
+	//! Создать и запустить обработчик. _mutex должен быть заблокирован
+	void AddWorkerHelper();
+	//! Обновить копию списка обработчиков для Workers. _mutex должен быть заблокирован
+	void PublishWorkers();
+	//! Поток автоматического масштабирования
+	void ScalerThread();
+	//! Остановить поток масштабирования. Вызывается без блокировки _mutex
+	void StopScaler();
+	//! Суммарный размер буфера. _mutex должен быть заблокирован
+	size_t BufferSizeHelper() const;
+	//! Открыть файл ошибок, если он еще не открыт. _file_locker должен быть заблокирован
+	bool OpenErrorFile();
+
+	//! Результат AddRecordHelper
+	enum class AddResult
+	{
+		Added,
+		Stopped,
+		Full,
+	};
+	//! Добавление записи размером bytes. Если drop, то при переполнении запись отбрасывается с сохранением в файл ошибок
+	AddResult AddRecordHelper(const RecordPtr& record, size_t bytes, bool drop);
+	//! Разбудить обработчики для немедленной обработки очередей (буфер переполнен)
+	void WakeupWorkers();
+	//! Описание переполнения буфера для записи размером bytes или пустая строка, если место есть. Без блокировки _mutex
+	std::string CheckOverflow(size_t bytes) const;
+	//! Пересчитать уровень заполненности после изменения счетчиков буфера
+	void UpdatePressure(int64_t records, int64_t bytes);
+
+	mutable std::mutex _mutex;
+
+	std::vector<WorkerPtr> _workers;
+	//! Копия _workers, читаемая обработчиками без блокировки (std::atomic_load)
+	std::shared_ptr<const std::vector<WorkerPtr>> _workers_snapshot = std::make_shared<const std::vector<WorkerPtr>>();
+	std::vector<std::unique_ptr<std::thread>> _worker_threads;
+	std::atomic_bool _started = false;
+	//! Номер следующего обработчика (для имени потока)
+	size_t _next_worker_number = 0;
+
+	//! Параметры создания обработчиков
+	SinkPtr _sink;
+	size_t _packet_size = 0;
+	size_t _flush_buffer_size = 0;
+	//! Размер буфера аварийного сохранения каждого обработчика, если обработчик сигналов установлен
+	size_t _worker_crash_buffer_size = 0;
+	//! Отправка на сервер логов, если не заданы приемники через SetSinks
+	std::shared_ptr<HttpSink> _http_sink;
+	//! Максимальный размер буфера, при котором новые записи будут отбрасываться. Необходимо для исключения переполнения памяти в случае,
+	//! когда количество вызовов AddRecord превышает скорость обработки буфера
+	size_t _max_buffer_size = 0;
+
+	//! Автоматическое масштабирование
+	std::unique_ptr<std::thread> _scaler_thread;
+	//! Защищает _scaler_thread. Поток масштабирования его не использует, поэтому удерживается на время ожидания потока
+	std::mutex _scaler_thread_mutex;
+	std::mutex _scaler_mutex;
+	std::condition_variable _scaler_wakeup;
+	bool _scaler_stop = false;
+	ScalingStats _scaling_stats;
+	size_t _idle_periods = 0;
+
+	//! Блокировка параллельного вывода в консоль (общая для всех конвейеров)
+	static std::mutex _cout_locker;
+
+	//! Блокировка параллельного вывода в файл
+	std::mutex _file_locker;
+	//! Имя файла, куда будут выводиться ошибки при невозможности отправки лога обычным способом
+	std::string _error_file_name;
+	//! Файл журнала
+	std::ofstream _log_file;
+
+	//! Настройки потоков обработчиков
+	ThreadOptions _thread_options;
+	//! Настройки автоматического масштабирования
+	ScalingOptions _scaling_options;
+	//! Настройки перераспределения записей
+	StealingOptions _stealing_options;
+	//! Записи, обработанные остановленными обработчиками не из своей очереди (для StolenRecords)
+	uint64_t _retired_stolen = 0;
+	//! Ограничения по объему записей
+	MemoryLimits _memory_limits;
+	//! Настройки формирования пакетов
+	BatchOptions _batch_options;
+	//! Приемники записей, заданные через SetSinks
+	std::vector<SinkPtr> _sinks;
+	//! Узлы сервера логов, заданные через SetEndpoints
+	std::vector<Endpoint> _endpoints;
+	EndpointPoolOptions _endpoint_options;
+	//! Настройки цикла событий HttpSink
+	EventLoopOptions _event_loop_options;
+	//! Сбор задержек доставки. Создается в SetLatencyOptions, nullptr если отключен
+	std::shared_ptr<LatencyTracker> _latency;
+
+	//! Количество и объем записей во всех очередях обработчиков
+	std::atomic<int64_t> _buffered_records = 0;
+	std::atomic<int64_t> _buffered_bytes = 0;
+	std::atomic<int64_t> _peak_bytes = 0;
+	//! Отброшено записей из-за переполнения буфера
+	std::atomic<uint64_t> _dropped_records = 0;
+
+	//! Пороги заполненности буфера
+	BackpressureOptions _backpressure;
+	std::atomic<PressureLevel> _pressure = PressureLevel::Green;
+	//! Уровень, переданный в on_change последним. Защищен _pressure_mutex
+	PressureLevel _notified_pressure = PressureLevel::Green;
+	std::atomic_bool _pressure_changed = false;
+	std::mutex _pressure_mutex;
+	//! Ожидание места в буфере в AddRecord с deadline
+	std::mutex _space_mutex;
+	std::condition_variable _space_available;
+	std::atomic<int> _space_waiters = 0;
+
+	//! Файл аварийного сохранения
+	std::string _crash_file_name;
+	//! Размер буфера аварийного сохранения каждого обработчика
+	size_t _crash_buffer_size = 0;
+	//! Обработчик сигналов установлен этим конвейером
+	bool _crash_handler_installed = false;
+
+	ErrorFunc _error_func;
+	std::chrono::seconds _error_period {0};
+	std::mutex _last_error_mutex;
+	std::unique_ptr<std::chrono::steady_clock::time_point> _last_error_time;
+
+	//! Разрешить вычисление RPS
+	std::atomic_bool _enable_rps = false;
+	std::atomic<int64_t> _processed_count = 0;
+	std::atomic<std::chrono::steady_clock::time_point> _processed_time;
+};
+
+using PipelinePtr = std::shared_ptr<Pipeline>;
+
+} // namespace Logger
@@ -1,7 +1,92 @@
 #include "record.h"
+#include "json_escape.h"
+
+#include <exception>
+#include <utility>
 
 namespace Logger
 {
 
+namespace
+{
+//! Память, выделенная строкой вне объекта. Короткие строки хранятся во внутреннем буфере
+size_t StringHeapSize(const std::string& s)
+{
+	static const size_t inplace_capacity = std::string().capacity();
+	return s.capacity() > inplace_capacity ? s.capacity() + 1 : 0;
+}
+
+size_t MapHeapSize(const std::map<std::string, std::string>& m)
+{
+	// узел красно-черного дерева: три указателя, цвет и значение
+	constexpr size_t node_size = 4 * sizeof(void*) + sizeof(std::pair<const std::string, std::string>);
+
+	size_t size = 0;
+	for (auto& [key, value] : m)
+		size += node_size + StringHeapSize(key) + StringHeapSize(value);
+	return size;
+}
+} // namespace
+
+RecordTemplate::RecordTemplate(const std::string& service, const std::string& source, const std::string& category,
+							   const std::map<std::string, std::string>& httpHeaders) :
+	_service(service),
+	_source(source),
+	_category(category),
+	_httpHeaders(httpHeaders)
+{
+	// ключи в том же порядке, что и в остальной записи (по алфавиту)
+	_fragment += "\"category\":";
+	AppendJsonString(_fragment, _category);
+	_fragment += ",\"httpHeaders\":";
+	AppendJsonObject(_fragment, _httpHeaders);
+	_fragment += ",\"service\":";
+	AppendJsonString(_fragment, _service);
+	_fragment += ",\"source\":";
+	AppendJsonString(_fragment, _source);
+}
+
+void Record::FormatDeferred()
+{
+	if (deferredInfo == nullptr)
+		return;
+
+	try
+	{
+		info = deferredInfo->Format();
+	}
+	catch (const std::exception& e)
+	{
+		// некорректная строка формата не должна приводить к потере записи
+		info = std::string("format error: ") + e.what();
+	}
+	deferredInfo.reset();
+}
+
+void Record::ApplyTemplate()
+{
+	if (recordTemplate == nullptr)
+		return;
+
+	service = recordTemplate->Service();
+	source = recordTemplate->Source();
+	category = recordTemplate->Category();
+	httpHeaders = recordTemplate->HttpHeaders();
+	recordTemplate.reset();
+}
+
+size_t Record::MemorySize() const
+{
+	// запись создается через make_shared, поэтому учитываем и блок управления
+	constexpr size_t control_block_size = 2 * sizeof(void*);
+
+	size_t size = sizeof(Record) + control_block_size;
+	for (auto s : {&service, &source, &category, &level, &session, &info, &url, &httpType, &jsonBody})
+		size += StringHeapSize(*s);
+	size += MapHeapSize(properties) + MapHeapSize(httpHeaders);
+	if (deferredInfo != nullptr)
+		size += control_block_size + deferredInfo->MemorySize();
+	return size;
+}
 
 } // namespace Logger
@@ -6,14 +6,55 @@
 #include <string>
 #include <map>
 
+#include "clock.h"
+
 namespace Logger
 {
 
+//! Отложенное форматирование поля info. Выполняется в потоке обработчика, а не в потоке, добавившем запись
+class DeferredFormat
+{
+public:
+	virtual ~DeferredFormat() = default;
+	virtual std::string Format() const = 0;
+	//! Приблизительный объем занимаемой памяти в байтах
+	virtual size_t MemorySize() const { return sizeof(*this); }
+};
+
+//! Постоянные поля записей одного компонента. JSON этих полей формируется один раз при создании шаблона,
+//! и сериализатор вставляет его в каждую запись вместо повторного экранирования
+class RecordTemplate
+{
+public:
+	//! Бросает std::invalid_argument, если поля не являются корректным UTF-8
+	explicit RecordTemplate(const std::string& service, const std::string& source = {}, const std::string& category = {},
+							const std::map<std::string, std::string>& httpHeaders = {});
+
+	const std::string& Service() const { return _service; }
+	const std::string& Source() const { return _source; }
+	const std::string& Category() const { return _category; }
+	const std::map<std::string, std::string>& HttpHeaders() const { return _httpHeaders; }
+	//! Поля шаблона в виде JSON без фигурных скобок: "category":...,"httpHeaders":{...},"service":...,"source":...
+	const std::string& Fragment() const { return _fragment; }
+
+private:
+	const std::string _service;
+	const std::string _source;
+	const std::string _category;
+	const std::map<std::string, std::string> _httpHeaders;
+	std::string _fragment;
+};
+
+using RecordTemplatePtr = std::shared_ptr<const RecordTemplate>;
+
 struct Record
 {
-	Record() : time(std::chrono::system_clock::now()) {}
+	Record() : time(CaptureTime()) {}
+	//! Запись с постоянными полями из шаблона
+	explicit Record(const RecordTemplatePtr& record_template) : time(CaptureTime()), recordTemplate(record_template) {}
 
-	std::chrono::time_point<std::chrono::system_clock>  time;
+	//! Время создания записи. При Clock::DeferredCapture() остается нулевым до добавления в очередь обработчика
+	RecordTime time;
 	std::string service;
 	std::string source;
 	std::string category;
@@ -28,6 +69,27 @@ struct Record
 
 	std::map<std::string, std::string> properties;
 	std::map<std::string, std::string> httpHeaders;
+
+	//! Если задано, то info будет сформировано из него при обработке записи (см. log.h)
+	std::shared_ptr<const DeferredFormat> deferredInfo;
+	//! Если задано, то service, source, category и httpHeaders берутся из шаблона, а собственные значения этих полей не используются
+	RecordTemplatePtr recordTemplate;
+
+	//! Зафиксировать время, если оно не было получено при создании
+	void StampTime()
+	{
+		if (time.time_since_epoch().count() == 0)
+			time = Clock::Now();
+	}
+	//! Выполнить отложенное форматирование info
+	void FormatDeferred();
+	//! Скопировать поля шаблона в запись и отвязать ее от шаблона (для вывода, которому нужны отдельные поля)
+	void ApplyTemplate();
+	//! Приблизительный объем памяти, занимаемой записью, в байтах (с учетом емкости строк и узлов map)
+	size_t MemorySize() const;
+
+private:
+	static RecordTime CaptureTime() { return Clock::DeferredCapture() ? RecordTime() : Clock::Now(); }
 };
 
 using RecordPtr = std::shared_ptr<Record>;
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+
+namespace Logger
+{
+
+//! Настройки автоматического изменения количества обработчиков
+struct ScalingOptions
+{
+	//! Если false, то количество обработчиков постоянно и равно workers_count
+	bool enabled = false;
+	size_t min_workers = 1;
+	size_t max_workers = 1;
+	//! Период принятия решений
+	std::chrono::milliseconds interval {1000};
+	//! Добавить обработчик, если средняя длина очереди одного обработчика больше
+	size_t scale_up_queue = 1000;
+	//! Добавить обработчик, если среднее время обработки пакета больше
+	std::chrono::milliseconds scale_up_latency {500};
+	//! Удалить обработчик, если очереди были пустыми указанное количество периодов подряд
+	size_t idle_periods = 30;
+};
+
+//! Настройки перераспределения записей между обработчиками
+struct StealingOptions
+{
+	//! Если true, то обработчик с пустой очередью забирает пакет с конца самой длинной очереди обработчика,
+	//! который дольше stall занят отправкой (медленный ответ, таймаут соединения)
+	bool enabled = false;
+	//! Через сколько отправка пакета считается зависшей. Также период, с которым простаивающий обработчик проверяет соседей
+	std::chrono::milliseconds stall {100};
+};
+
+//! Метрики автоматического масштабирования
+struct ScalingStats
+{
+	//! Текущее количество обработчиков
+	size_t workers = 0;
+	//! Сколько раз обработчики добавлялись
+	uint64_t scale_ups = 0;
+	//! Сколько раз обработчики удалялись
+	uint64_t scale_downs = 0;
+	//! Средняя длина очереди одного обработчика на момент последнего решения
+	size_t queue_per_worker = 0;
+	//! Среднее время обработки пакета за последний период
+	std::chrono::microseconds send_latency {0};
+	//! Описание последнего решения
+	std::string last_decision;
+};
+
+} // namespace Logger
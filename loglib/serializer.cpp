@@ -0,0 +1,133 @@
+#include "serializer.h"
+#include "json_escape.h"
+
+#include "3rdparty/date.h"
+#include "3rdparty/json.hpp"
+#include "3rdparty/fmtlib/format.h"
+#include "3rdparty/fmtlib/ranges.h"
+
+namespace Logger
+{
+
+std::string FormatLogTime(const RecordTime& time)
+{
+	return date::format("%FT%TZ", time);
+}
+
+namespace
+{
+//! Запись добавляется напрямую в строку, без промежуточного nlohmann::json. Ключи идут в том же порядке (по алфавиту),
+//! что и при сериализации через nlohmann::json, поэтому результат совпадает. Поля шаблона записи
+//! вставляются готовым фрагментом сразу после тела
+void AppendRecord(std::string& out, const Record& r)
+{
+	const RecordTemplate* record_template = r.recordTemplate.get();
+
+	out += '{';
+
+	if (!r.jsonBody.empty())
+	{
+		try
+		{
+			// тело проверяется разбором, поэтому сериализуется через nlohmann
+			std::string body = nlohmann::json::parse(r.jsonBody).dump();
+			out += "\"body\":";
+			out += body;
+			out += ',';
+		}
+		catch (...)
+		{
+		}
+	}
+
+	if (record_template != nullptr)
+	{
+		out += record_template->Fragment();
+		out += ',';
+	}
+	else
+	{
+		out += "\"category\":";
+		AppendJsonString(out, r.category);
+		out += ',';
+	}
+
+	out += "\"errorCode\":";
+	out += fmt::format_int(r.errorCode).c_str();
+	out += ",\"httpCode\":";
+	out += fmt::format_int(r.httpCode).c_str();
+	if (record_template == nullptr)
+	{
+		out += ",\"httpHeaders\":";
+		AppendJsonObject(out, r.httpHeaders);
+	}
+	out += ",\"httpType\":";
+	AppendJsonString(out, r.httpType);
+	out += ",\"info\":";
+	AppendJsonString(out, r.info);
+	out += ",\"level\":";
+	AppendJsonString(out, r.level);
+	out += ",\"logTime\":";
+	AppendJsonString(out, FormatLogTime(r.time));
+	out += ",\"properties\":";
+	AppendJsonObject(out, r.properties);
+	if (record_template == nullptr)
+	{
+		out += ",\"service\":";
+		AppendJsonString(out, r.service);
+	}
+	out += ",\"session\":";
+	AppendJsonString(out, r.session);
+	if (record_template == nullptr)
+	{
+		out += ",\"source\":";
+		AppendJsonString(out, r.source);
+	}
+	out += ",\"url\":";
+	AppendJsonString(out, r.url);
+
+	out += '}';
+}
+} // namespace
+
+std::string SerializeRecord(const Record& record)
+{
+	std::string out;
+	AppendRecord(out, record);
+	return out;
+}
+
+std::string FormatRecordText(const Record& r)
+{
+	return fmt::format("{}, service: {}, source: {}, category: {}, level: {}, session: {}, info: {}, url: {}, httpType: {}, "
+					   "properties: {}, httpHeaders: {}, jsonBody: {}",
+					   FormatLogTime(r.time),
+					   r.recordTemplate != nullptr ? r.recordTemplate->Service() : r.service,
+					   r.recordTemplate != nullptr ? r.recordTemplate->Source() : r.source,
+					   r.recordTemplate != nullptr ? r.recordTemplate->Category() : r.category,
+					   r.level,
+					   r.session,
+					   r.info,
+					   r.url,
+					   r.httpType,
+					   r.properties,
+					   r.recordTemplate != nullptr ? r.recordTemplate->HttpHeaders() : r.httpHeaders,
+					   r.jsonBody);
+}
+
+std::string SerializeRecords(const std::vector<RecordPtr>& records)
+{
+	std::string out;
+	out += '[';
+	for (size_t i = 0; i < records.size(); i++)
+	{
+		if (i > 0)
+			out += ',';
+		AppendRecord(out, *records.at(i));
+	}
+	out += ']';
+
+	return out;
+}
+
+} // namespace Logger
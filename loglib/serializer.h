@@ -0,0 +1,26 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <chrono>
+
+#include "record.h"
+
+namespace Logger
+{
+
+//! Время записи в формате, принятом сервером логов (ISO 8601, UTC, микросекунды)
+std::string FormatLogTime(const RecordTime& time);
+
+//! Сериализация одной записи в JSON-объект
+//! Бросает исключение, если данные не могут быть сериализованы (например некорректный UTF-8)
+std::string SerializeRecord(const Record& record);
+
+//! Запись в текстовом виде (одна строка, как в файле ошибок, но со временем записи)
+std::string FormatRecordText(const Record& record);
+
+//! Сериализация пакета записей в JSON-массив для отправки на сервер логов
+//! Бросает исключение, если данные не могут быть сериализованы (например некорректный UTF-8)
+std::string SerializeRecords(const std::vector<RecordPtr>& records);
+
+} // namespace Logger
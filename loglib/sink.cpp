@@ -0,0 +1,362 @@
+#include "sink.h"
+#include "serializer.h"
+
+#include <iostream>
+#include <algorithm>
+
+#include "3rdparty/fmtlib/format.h"
+
+namespace Logger
+{
+
+namespace
+{
+size_t BatchSize(const std::vector<RecordPtr>& records)
+{
+	return records.size();
+}
+
+size_t BatchSize(const SerializedBatch& batch)
+{
+	return batch.Size();
+}
+
+//! Записи пакета, начиная с from
+std::vector<RecordPtr> BatchTail(const std::vector<RecordPtr>& records, size_t from)
+{
+	return {records.begin() + (ptrdiff_t)std::min(from, records.size()), records.end()};
+}
+
+SerializedBatch BatchTail(const SerializedBatch& batch, size_t from)
+{
+	return batch.Slice(std::min(from, batch.Size()), batch.Size());
+}
+} // namespace
+
+size_t SerializedBatch::Size() const
+{
+	return offsets.size();
+}
+
+std::string_view SerializedBatch::At(size_t index) const
+{
+	size_t begin = offsets.at(index);
+	// запись заканчивается перед запятой, отделяющей следующую, или перед закрывающей скобкой массива
+	size_t end = index + 1 < offsets.size() ? offsets.at(index + 1) - 1 : json.size() - 1;
+	return std::string_view(json).substr(begin, end - begin);
+}
+
+void SerializedBatch::Append(std::string_view record)
+{
+	json.pop_back();
+	if (!offsets.empty())
+		json += ',';
+	offsets.push_back(json.size());
+	json += record;
+	json += ']';
+}
+
+SerializedBatch SerializedBatch::Slice(size_t begin, size_t end) const
+{
+	SerializedBatch batch;
+	if (begin >= end)
+		return batch;
+
+	// записи идут подряд, поэтому копируется один участок
+	size_t from = offsets.at(begin);
+	size_t to = end < offsets.size() ? offsets.at(end) - 1 : json.size() - 1;
+	batch.json.reserve(to - from + 2);
+	batch.json = "[";
+	batch.json.append(json, from, to - from);
+	batch.json += ']';
+
+	batch.offsets.reserve(end - begin);
+	for (size_t i = begin; i < end; i++)
+		batch.offsets.push_back(offsets.at(i) - from + 1);
+	return batch;
+}
+
+Sink::Sink(const SinkOptions& options) : _options(options)
+{
+}
+
+SinkResult Sink::Process(const std::vector<RecordPtr>& records)
+{
+	if (_options.max_records == 0 || records.size() <= _options.max_records)
+		return Write(records);
+
+	for (size_t i = 0; i < records.size(); i += _options.max_records)
+	{
+		auto begin = records.begin() + i;
+		auto end = records.begin() + std::min(records.size(), i + _options.max_records);
+		auto result = Write({begin, end});
+		if (!result.ok)
+		{
+			// предыдущие части уже обработаны и не должны повторяться
+			result.delivered += i;
+			return result;
+		}
+	}
+	return {};
+}
+
+SinkResult Sink::Process(const SerializedBatch& batch)
+{
+	if (_options.max_records == 0 || batch.Size() <= _options.max_records)
+		return WriteSerialized(batch);
+
+	for (size_t i = 0; i < batch.Size(); i += _options.max_records)
+	{
+		auto result = WriteSerialized(batch.Slice(i, std::min(batch.Size(), i + _options.max_records)));
+		if (!result.ok)
+		{
+			result.delivered += i;
+			return result;
+		}
+	}
+	return {};
+}
+
+bool Sink::AcceptsSerialized() const
+{
+	return false;
+}
+
+SinkResult Sink::WriteSerialized(const SerializedBatch&)
+{
+	return {false, 0, "serialized batches are not supported"};
+}
+
+size_t Sink::MaxPendingBatches() const
+{
+	return 0;
+}
+
+void Sink::ProcessAsync(const std::shared_ptr<const std::vector<RecordPtr>>& records, const SinkCallback& done)
+{
+	done(Process(*records));
+}
+
+void Sink::ProcessAsync(const std::shared_ptr<const SerializedBatch>& batch, const SinkCallback& done)
+{
+	done(Process(*batch));
+}
+
+size_t Sink::MaxRecords() const
+{
+	return _options.max_records;
+}
+
+FanoutSink::FanoutSink(const std::vector<SinkPtr>& sinks, const SinkOptions& options) : Sink(options), _sinks(sinks)
+{
+}
+
+std::string FanoutSink::Name() const
+{
+	std::string name = "fanout(";
+	for (size_t i = 0; i < _sinks.size(); i++)
+		name += (i > 0 ? ", " : "") + _sinks.at(i)->Name();
+	return name + ")";
+}
+
+bool FanoutSink::AcceptsSerialized() const
+{
+	return std::all_of(_sinks.begin(), _sinks.end(), [](const SinkPtr& sink) { return sink->AcceptsSerialized(); });
+}
+
+SinkResult FanoutSink::Write(const std::vector<RecordPtr>& records)
+{
+	return WriteBatch(records);
+}
+
+SinkResult FanoutSink::WriteSerialized(const SerializedBatch& batch)
+{
+	return WriteBatch(batch);
+}
+
+template <class Batch>
+SinkResult FanoutSink::WriteBatch(const Batch& batch)
+{
+	// обработанными считаются записи, которые обработали все приемники
+	SinkResult result;
+	result.delivered = BatchSize(batch);
+	for (auto& sink : _sinks)
+	{
+		auto r = sink->Process(batch);
+		if (r.ok)
+			continue;
+
+		result.ok = false;
+		result.delivered = std::min(result.delivered, r.delivered);
+		result.error_code = r.error_code;
+		result.error_text += fmt::format("{}{}: {}", result.error_text.empty() ? "" : "; ", sink->Name(), r.error_text);
+	}
+	return result;
+}
+
+FailoverSink::FailoverSink(const std::vector<SinkPtr>& sinks, const SinkOptions& options) : Sink(options), _sinks(sinks)
+{
+}
+
+std::string FailoverSink::Name() const
+{
+	std::string name = "failover(";
+	for (size_t i = 0; i < _sinks.size(); i++)
+		name += (i > 0 ? " -> " : "") + _sinks.at(i)->Name();
+	return name + ")";
+}
+
+bool FailoverSink::AcceptsSerialized() const
+{
+	return std::all_of(_sinks.begin(), _sinks.end(), [](const SinkPtr& sink) { return sink->AcceptsSerialized(); });
+}
+
+SinkResult FailoverSink::Write(const std::vector<RecordPtr>& records)
+{
+	return WriteBatch(records);
+}
+
+SinkResult FailoverSink::WriteSerialized(const SerializedBatch& batch)
+{
+	return WriteBatch(batch);
+}
+
+template <class Batch>
+SinkResult FailoverSink::WriteBatch(const Batch& batch)
+{
+	SinkResult result {false, 0, "no sinks"};
+	std::string errors;
+	// записи, обработанные предыдущими приемниками, следующим не передаются
+	size_t delivered = 0;
+	for (auto& sink : _sinks)
+	{
+		result = delivered == 0 ? sink->Process(batch) : sink->Process(BatchTail(batch, delivered));
+		if (result.ok)
+			return result;
+
+		delivered += result.delivered;
+		errors += fmt::format("{}{}: {}", errors.empty() ? "" : "; ", sink->Name(), result.error_text);
+	}
+
+	if (!errors.empty())
+		result.error_text = errors;
+	result.delivered = delivered;
+	return result;
+}
+
+MemorySink::MemorySink(bool keep_records, const SinkOptions& options) : Sink(options), _keep_records(keep_records)
+{
+}
+
+std::string MemorySink::Name() const
+{
+	return "memory";
+}
+
+uint64_t MemorySink::RecordsCount() const
+{
+	return _records_count;
+}
+
+uint64_t MemorySink::BatchesCount() const
+{
+	return _batches_count;
+}
+
+std::vector<RecordPtr> MemorySink::TakeRecords()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return std::move(_records);
+}
+
+bool MemorySink::AcceptsSerialized() const
+{
+	return !_keep_records;
+}
+
+SinkResult MemorySink::WriteSerialized(const SerializedBatch& batch)
+{
+	_records_count += batch.Size();
+	_batches_count++;
+	return {};
+}
+
+SinkResult MemorySink::Write(const std::vector<RecordPtr>& records)
+{
+	if (_keep_records)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_records.insert(_records.end(), records.begin(), records.end());
+	}
+
+	_records_count += records.size();
+	_batches_count++;
+	return {};
+}
+
+StdoutSink::StdoutSink(SinkFormat format, const SinkOptions& options) : Sink(options), _format(format)
+{
+}
+
+std::string StdoutSink::Name() const
+{
+	return "stdout";
+}
+
+bool StdoutSink::AcceptsSerialized() const
+{
+	return _format == SinkFormat::Json;
+}
+
+SinkResult StdoutSink::Write(const std::vector<RecordPtr>& records)
+{
+	return Print(FormatSinkLines(records, _format));
+}
+
+SinkResult StdoutSink::WriteSerialized(const SerializedBatch& batch)
+{
+	return Print(FormatSinkLines(batch));
+}
+
+SinkResult StdoutSink::Print(const std::string& lines)
+{
+	static std::mutex mutex;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	std::cout << lines << std::flush;
+	if (!std::cout.good())
+		return {false, 0, "stdout write error"};
+	return {};
+}
+
+std::string FormatSinkLines(const std::vector<RecordPtr>& records, SinkFormat format)
+{
+	std::string lines;
+	for (auto& r : records)
+	{
+		try
+		{
+			lines += format == SinkFormat::Json ? SerializeRecord(*r) : FormatRecordText(*r);
+			lines += '\n';
+		}
+		catch (...)
+		{
+			// кривые данные? игнорируем
+		}
+	}
+	return lines;
+}
+
+std::string FormatSinkLines(const SerializedBatch& batch)
+{
+	std::string lines;
+	lines.reserve(batch.json.size());
+	for (size_t i = 0; i < batch.Size(); i++)
+	{
+		lines += batch.At(i);
+		lines += '\n';
+	}
+	return lines;
+}
+
+} // namespace Logger
@@ -0,0 +1,199 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <functional>
+
+#include "record.h"
+
+namespace Logger
+{
+
+//! Результат обработки пакета приемником
+struct SinkResult
+{
+	bool ok = true;
+	//! Код ошибки (HTTP статус, errno и т.п.)
+	int error_code = 0;
+	std::string error_text;
+	//! Если ok == false: сколько первых записей пакета уже обработано (например, при разбиении пакета на части).
+	//! В обработку ошибок и другим приемникам передаются только остальные
+	size_t delivered = 0;
+};
+
+//! Завершение асинхронной обработки пакета (Sink::ProcessAsync)
+using SinkCallback = std::function<void(const SinkResult&)>;
+
+//! Общие настройки приемника
+struct SinkOptions
+{
+	//! Максимальное количество записей, передаваемых в Write за один раз. Если 0, то пакет обработчика передается целиком
+	size_t max_records = 0;
+};
+
+//! Пакет записей, сериализованных при добавлении в очередь (BatchOptions::pre_serialize)
+struct SerializedBatch
+{
+	//! JSON-массив записей
+	std::string json = "[]";
+	//! Начало каждой записи в json
+	std::vector<size_t> offsets;
+
+	size_t Size() const;
+	//! JSON-объект записи
+	std::string_view At(size_t index) const;
+	//! Добавить JSON-объект записи
+	void Append(std::string_view record);
+	//! Пакет из записей [begin, end)
+	SerializedBatch Slice(size_t begin, size_t end) const;
+};
+
+//! Формат записей в текстовых приемниках
+enum class SinkFormat
+{
+	//! Одна JSON запись в строке (NDJSON)
+	Json,
+	//! Текст в формате файла ошибок
+	Text,
+};
+
+//! Приемник пакетов записей. Один экземпляр используется всеми обработчиками, поэтому реализация должна быть потокобезопасной
+class Sink
+{
+public:
+	explicit Sink(const SinkOptions& options = {});
+	virtual ~Sink() = default;
+
+	//! Обработать пакет с учетом ограничения SinkOptions::max_records
+	SinkResult Process(const std::vector<RecordPtr>& records);
+	//! Обработать пакет сериализованных записей с учетом ограничения SinkOptions::max_records
+	SinkResult Process(const SerializedBatch& batch);
+	//! Имя приемника для сообщений об ошибках
+	virtual std::string Name() const = 0;
+	//! Принимает ли приемник пакеты сериализованных записей. Если нет, то обработчики передают ему записи
+	virtual bool AcceptsSerialized() const;
+
+	//! Сколько пакетов один обработчик может передать в ProcessAsync, не дождавшись результата. Если 0, то приемник
+	//! обрабатывает пакеты синхронно и обработчики вызывают Process
+	virtual size_t MaxPendingBatches() const;
+	//! Начать обработку пакета и вернуться, не дожидаясь результата. done вызывается один раз, возможно из другого потока
+	//! или до возврата из ProcessAsync. Пакет не изменяется до вызова done. По умолчанию вызывает Process
+	virtual void ProcessAsync(const std::shared_ptr<const std::vector<RecordPtr>>& records, const SinkCallback& done);
+	//! Начать обработку пакета сериализованных записей. Вызывается, только если AcceptsSerialized() == true
+	virtual void ProcessAsync(const std::shared_ptr<const SerializedBatch>& batch, const SinkCallback& done);
+
+protected:
+	//! Обработать пакет
+	virtual SinkResult Write(const std::vector<RecordPtr>& records) = 0;
+	//! Обработать пакет сериализованных записей. Вызывается, только если AcceptsSerialized() == true
+	virtual SinkResult WriteSerialized(const SerializedBatch& batch);
+	//! SinkOptions::max_records
+	size_t MaxRecords() const;
+
+private:
+	const SinkOptions _options;
+};
+
+using SinkPtr = std::shared_ptr<Sink>;
+
+//! Передача пакета во все приемники. Пакет считается обработанным, если его обработали все приемники
+class FanoutSink : public Sink
+{
+public:
+	explicit FanoutSink(const std::vector<SinkPtr>& sinks, const SinkOptions& options = {});
+	std::string Name() const override;
+	//! Если все приемники принимают сериализованные записи
+	bool AcceptsSerialized() const override;
+
+protected:
+	SinkResult Write(const std::vector<RecordPtr>& records) override;
+	SinkResult WriteSerialized(const SerializedBatch& batch) override;
+
+private:
+	template <class Batch>
+	SinkResult WriteBatch(const Batch& batch);
+
+	const std::vector<SinkPtr> _sinks;
+};
+
+//! Передача пакета приемникам по очереди до первой успешной обработки. Следующий приемник получает только записи,
+//! которые не обработал предыдущий
+class FailoverSink : public Sink
+{
+public:
+	explicit FailoverSink(const std::vector<SinkPtr>& sinks, const SinkOptions& options = {});
+	std::string Name() const override;
+	//! Если все приемники принимают сериализованные записи
+	bool AcceptsSerialized() const override;
+
+protected:
+	SinkResult Write(const std::vector<RecordPtr>& records) override;
+	SinkResult WriteSerialized(const SerializedBatch& batch) override;
+
+private:
+	template <class Batch>
+	SinkResult WriteBatch(const Batch& batch);
+
+	const std::vector<SinkPtr> _sinks;
+};
+
+//! Приемник в памяти для тестирования и бенчмарков
+class MemorySink : public Sink
+{
+public:
+	explicit MemorySink(
+		//! Сохранять записи (иначе только подсчитываются)
+		bool keep_records = false,
+		const SinkOptions& options = {});
+	std::string Name() const override;
+
+	//! Количество принятых записей
+	uint64_t RecordsCount() const;
+	//! Количество принятых пакетов
+	uint64_t BatchesCount() const;
+	//! Забрать сохраненные записи
+	std::vector<RecordPtr> TakeRecords();
+	//! Если записи не сохраняются
+	bool AcceptsSerialized() const override;
+
+protected:
+	SinkResult Write(const std::vector<RecordPtr>& records) override;
+	SinkResult WriteSerialized(const SerializedBatch& batch) override;
+
+private:
+	const bool _keep_records;
+	std::atomic<uint64_t> _records_count = 0;
+	std::atomic<uint64_t> _batches_count = 0;
+	std::mutex _mutex;
+	std::vector<RecordPtr> _records;
+};
+
+//! Вывод записей в стандартный поток вывода
+class StdoutSink : public Sink
+{
+public:
+	explicit StdoutSink(SinkFormat format = SinkFormat::Json, const SinkOptions& options = {});
+	std::string Name() const override;
+	//! Если формат SinkFormat::Json
+	bool AcceptsSerialized() const override;
+
+protected:
+	SinkResult Write(const std::vector<RecordPtr>& records) override;
+	SinkResult WriteSerialized(const SerializedBatch& batch) override;
+
+private:
+	SinkResult Print(const std::string& lines);
+
+	const SinkFormat _format;
+};
+
+//! Преобразование записей в строки для текстовых приемников. Записи, которые не удалось сериализовать, пропускаются
+std::string FormatSinkLines(const std::vector<RecordPtr>& records, SinkFormat format);
+//! Сериализованные записи в формате NDJSON
+std::string FormatSinkLines(const SerializedBatch& batch);
+
+} // namespace Logger
@@ -0,0 +1,102 @@
+#include "thread_options.h"
+
+#include <fstream>
+#include <sstream>
+
+#ifdef __linux__
+	#include <pthread.h>
+	#include <sched.h>
+	#include <unistd.h>
+	#include <sys/resource.h>
+	#include <sys/syscall.h>
+	#include <cstring>
+	#include <cerrno>
+#endif
+
+#include "3rdparty/fmtlib/format.h"
+
+namespace Logger
+{
+
+#ifdef __linux__
+namespace
+{
+//! Разбор списка процессоров в формате /sys/devices/system/node/nodeN/cpulist: "0-3,8,10-11"
+bool ReadNumaCpus(int node, std::vector<int>& cpus)
+{
+	std::ifstream file(fmt::format("/sys/devices/system/node/node{}/cpulist", node));
+	std::string list;
+	if (!std::getline(file, list))
+		return false;
+
+	std::stringstream ss(list);
+	std::string range;
+	while (std::getline(ss, range, ','))
+	{
+		if (range.empty())
+			continue;
+
+		size_t dash = range.find('-');
+		int first = std::atoi(range.substr(0, dash).c_str());
+		int last = dash == std::string::npos ? first : std::atoi(range.substr(dash + 1).c_str());
+		for (int cpu = first; cpu <= last; cpu++)
+			cpus.push_back(cpu);
+	}
+	return true;
+}
+} // namespace
+
+std::string ApplyThreadOptions(const ThreadOptions& options, size_t number)
+{
+	std::vector<std::string> errors;
+
+	if (!options.name_prefix.empty())
+	{
+		std::string name = (options.name_prefix + std::to_string(number)).substr(0, 15);
+		if (int err = pthread_setname_np(pthread_self(), name.c_str()); err != 0)
+			errors.push_back(fmt::format("name: {}", strerror(err)));
+	}
+
+	std::vector<int> cpus = options.cpus;
+	if (options.numa_node >= 0 && !ReadNumaCpus(options.numa_node, cpus))
+		errors.push_back(fmt::format("numa node {} not found", options.numa_node));
+
+	if (!cpus.empty())
+	{
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		for (int cpu : cpus)
+		{
+			if (cpu >= 0 && cpu < CPU_SETSIZE)
+				CPU_SET(cpu, &set);
+		}
+
+		if (int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set); err != 0)
+			errors.push_back(fmt::format("affinity: {}", strerror(err)));
+	}
+
+	if (options.policy != SchedulingPolicy::Default)
+	{
+		sched_param param {};
+		int policy = options.policy == SchedulingPolicy::Batch ? SCHED_BATCH : SCHED_IDLE;
+		if (int err = pthread_setschedparam(pthread_self(), policy, &param); err != 0)
+			errors.push_back(fmt::format("scheduling policy: {}", strerror(err)));
+	}
+
+	// в Linux nice относится к потоку, а не к процессу
+	if (options.nice != 0 && setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), options.nice) != 0)
+		errors.push_back(fmt::format("nice: {}", strerror(errno)));
+
+	return errors.empty() ? std::string() : fmt::format("worker {} thread options: {}", number, fmt::join(errors, ", "));
+}
+#else
+std::string ApplyThreadOptions(const ThreadOptions& options, size_t number)
+{
+	if (options.cpus.empty() && options.numa_node < 0 && options.policy == SchedulingPolicy::Default && options.nice == 0)
+		return std::string();
+
+	return fmt::format("worker {} thread options: not supported on this platform", number);
+}
+#endif
+
+} // namespace Logger
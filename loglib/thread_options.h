@@ -0,0 +1,38 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace Logger
+{
+
+//! Политика планирования потоков обработчиков
+enum class SchedulingPolicy
+{
+	//! Без изменений (SCHED_OTHER)
+	Default,
+	//! SCHED_BATCH: поток считается вычислительным и реже вытесняет интерактивные
+	Batch,
+	//! SCHED_IDLE: поток выполняется только при простое процессора
+	Idle,
+};
+
+//! Настройки потоков обработчиков
+struct ThreadOptions
+{
+	//! Процессоры, на которых могут выполняться обработчики. Если пусто и numa_node < 0, то без ограничений
+	std::vector<int> cpus;
+	//! Узел NUMA. Если >= 0, то его процессоры добавляются к cpus
+	int numa_node = -1;
+	//! Политика планирования
+	SchedulingPolicy policy = SchedulingPolicy::Default;
+	//! Значение nice (-20..19). 0 - не менять
+	int nice = 0;
+	//! Префикс имени потока, к нему добавляется номер обработчика. Имя обрезается до 15 символов
+	std::string name_prefix = "loglib-w";
+};
+
+//! Применить настройки к текущему потоку. Возвращает текст ошибки или пустую строку
+std::string ApplyThreadOptions(const ThreadOptions& options, size_t number);
+
+} // namespace Logger
@@ -1,227 +1,726 @@
 #include "worker.h"
 #include "manager.h"
+#include "serializer.h"
+#include "http_sink.h"
 
 #include <iostream>
 #include <string>
 #include <assert.h>
 #include <chrono>
+#include <algorithm>
 
 #include "3rdparty/fmtlib/format.h"
 #include "3rdparty/fmtlib/chrono.h"
 
-#include "3rdparty/date.h"
-#include "3rdparty/httplib.h"
-#include "3rdparty/json.hpp"
 
 namespace Logger
 {
 
-Worker::Worker(const std::string& token, const std::string& host, uint16_t port, size_t packet_size, size_t flush_buffer_size, bool concat_records) :
-	_token(token), _host(host), _port(port), _packet_size(packet_size), _flush_buffer_size(flush_buffer_size), _concat_records(concat_records)
+namespace
 {
-	assert(!_host.empty());
-	assert(_port > 0);
+//! Емкость пустой _arena, которая сохраняется для следующих записей. Больший буфер освобождается
+constexpr size_t kArenaKeepBytes = 1 << 20;
+} // namespace
+
+Worker::Worker(const SinkPtr& sink, size_t packet_size, size_t flush_buffer_size, size_t crash_buffer_size, size_t flush_buffer_bytes,
+			   const BatchOptions& batch_options, Pipeline* pipeline) :
+	_pipeline(pipeline != nullptr ? pipeline : &Manager::Default()),
+	_sink(sink),
+	_packet_size(packet_size),
+	_batch_sizer(packet_size, batch_options),
+	_flush_buffer_size(flush_buffer_size),
+	_flush_buffer_bytes(flush_buffer_bytes),
+	_pre_serialize(batch_options.pre_serialize && sink->AcceptsSerialized()),
+	_latency(_pipeline->Latency()),
+	_stealing(_pipeline->Stealing()),
+	_max_pending(sink->MaxPendingBatches())
+{
+	assert(_sink != nullptr);
 	assert(_packet_size > 0);
+
+	if (crash_buffer_size > 0)
+	{
+		_crash_buffer = std::make_unique<CrashBuffer>(crash_buffer_size);
+		CrashHandler::Register(_crash_buffer.get());
+	}
 }
 
-bool Worker::SendToServer(const std::vector<RecordPtr>& records, int& error_code, std::string& error_string)
-{		
-	error_code = 0;
-	error_string.clear();
+Worker::Worker(const std::string& token, const std::string& host, uint16_t port, size_t packet_size, size_t flush_buffer_size, bool concat_records,
+			   size_t crash_buffer_size, size_t flush_buffer_bytes, const BatchOptions& batch_options) :
+	Worker(std::make_shared<HttpSink>(token, host, port, concat_records, batch_options.max_batch_bytes, SinkOptions {},
+												batch_options.stream_chunk_bytes), packet_size, flush_buffer_size,
+		   crash_buffer_size, flush_buffer_bytes, batch_options)
+{
+}
 
-	using json = nlohmann::json;
+Worker::~Worker()
+{
+	if (_crash_buffer != nullptr)
+		CrashHandler::Unregister(_crash_buffer.get());
+}
 
-	auto j_total = json::array();
+void Worker::Start(size_t number)
+{
+	_number = number;
+//	_pipeline->CoutPrint(fmt::format("worker {} started", _number), false);
 
-	for (auto& r : records)
+	while (!IsStopRequested())
 	{
-		auto j_obj = json::object();
-
-		j_obj["logTime"] = date::format("%FT%TZ", date::floor<std::chrono::microseconds>(r->time));
-		j_obj["service"] = r->service;
-		j_obj["source"] = r->source;
-		j_obj["category"] = r->category;
-		j_obj["level"] = r->level;
-		j_obj["session"] = r->session;
-		j_obj["info"] = r->info;
-		j_obj["url"] = r->url;
-		j_obj["httpType"] = r->httpType;
-		j_obj["httpCode"] = r->httpCode;
-		j_obj["errorCode"] = r->errorCode;
-		j_obj["properties"] = r->properties;
-		j_obj["httpHeaders"] = r->httpHeaders;
-
-		if (!r->jsonBody.empty())
+		while (true)
 		{
-			try
-			{
-				j_obj["body"] = json::parse(r->jsonBody);
-			}
-			catch (...)
+			// при переполнении очередь разбирается теми же ограниченными пакетами, но с блокировкой добавления новых записей
+			bool full_lock = false;
+			if (IsFlushRequired())
 			{
+				full_lock = true;
+				_pipeline->CoutPrint(fmt::format("Worker {} buffer full => auto flush", _number), true);
 			}
+
+			if (ProcessBuffer(full_lock) == 0)
+				break;
 		}
 
-		j_total.push_back(j_obj);
+		// своя очередь пуста: разбираем очереди обработчиков, зависших на отправке
+		while (_stealing.enabled && !IsStopRequested() && StealBatch() > 0)
+		{
+		}
+
+		// спим какое-то время или пробуждаемся при вызове AddRecord или StopRequest
+		auto timeout = _stealing.enabled ? std::min<std::chrono::milliseconds>(std::chrono::seconds(1), _stealing.stall) : std::chrono::seconds(1);
+		std::unique_lock<std::mutex> lock(_wakeup_mutex);
+		_wakeup.wait_for(lock, timeout, [this]() { return IsStopRequested() || _wakeup_requested; });
+		_wakeup_requested = false;
 	}
 
-	httplib::Client cli(_host, _port);
-	//	cli.set_connection_timeout(2);
-	//	cli.set_read_timeout(5, 0);
-	//	cli.set_write_timeout(5, 0);
+	// записи, добавленные до этой точки, попадут в Flush, а после нее вызывающий выберет другой обработчик
+	_buffer_mutex.lock();
+	_closed = true;
+	_buffer_mutex.unlock();
 
-	try
+	Flush();
+
+	// другие обработчики могут еще отправлять записи, забранные из этой очереди
+	std::unique_lock<std::mutex> lock(_buffer_mutex);
+	_taken_released.wait(lock, [this]() { return _taken_batches == 0; });
+
+//	_pipeline->CoutPrint(fmt::format("worker {} finished", _number), false);
+}
+
+void Worker::Flush()
+{
+	// обрабатываем только записи, находящиеся в очереди на момент вызова
+	size_t remaining = BufferSize();
+	while (remaining > 0)
 	{
-		auto res = cli.Post("/api/add",
-							{
-								{"X-Authorization", _token},
-								{"Connection", "keep-alive"},
-								{"Content-Type", "application/json"},
-								{"User-Agent", "loglib"},
-							},
-							j_total.dump(),
-							"application/json");
-		if (!res)
+		size_t processed = ProcessBuffer(true);
+		if (processed == 0)
+			break;
+		remaining -= std::min(remaining, processed);
+	}
+
+	// пакеты, переданные асинхронному приемнику, тоже должны быть обработаны
+	WaitPending(1);
+}
+
+bool Worker::AddRecord(const RecordPtr& record, size_t bytes)
+{
+	RecordStamps stamps;
+	if (_latency != nullptr)
+		stamps = MakeStamps(*record);
+	else
+		record->StampTime();
+
+	if (_pre_serialize)
+		return AddSerialized(record, stamps);
+
+	QueueItem item;
+	item.record = record;
+	item.bytes = bytes > 0 ? bytes : record->MemorySize();
+	item.stamps = stamps;
+
+	std::string crash_line;
+	if (_crash_buffer != nullptr)
+	{
+		// при аварийном сохранении запись сериализуется сразу, поэтому и форматирование выполняется здесь
+		record->FormatDeferred();
+		try
 		{
-			error_code = (int)res.error();
-			error_string = to_string(res.error());
-			return false;
+			crash_line = SerializeRecord(*record) + "\n";
 		}
-
-		if (res->status != 201)
+		catch (...)
 		{
-			error_code = res->status;
-			error_string = res->reason + ", " + res->body;
-			return false;
 		}
 	}
+
+	std::unique_lock<std::mutex> lock(_buffer_mutex);
+	_adding_allowed.wait(lock, [this]() { return !_adding_blocked; });
+	if (_closed)
+		return false;
+	if (!crash_line.empty())
+	{
+		item.crash_pos = _crash_buffer->Append(crash_line);
+		item.crash_size = crash_line.size();
+	}
+	_buffer_bytes += item.bytes;
+	_pipeline->RegisterBuffered(1, item.bytes);
+	_buffer.push_back(std::move(item));
+	_enqueued++;
+	lock.unlock();
+
+	// будим обработчик если он решил поспать. Без флага ожидание с предикатом пропустит уведомление
+	Wakeup();
+	return true;
+}
+
+bool Worker::AddSerialized(const RecordPtr& record, RecordStamps stamps)
+{
+	record->FormatDeferred();
+	std::string json;
+	try
+	{
+		json = SerializeRecord(*record);
+	}
 	catch (...)
 	{
-		// кривые данные? игнорируем
-		error_code = 400;
-		error_string = "invalid data";
+		// кривые данные? в очередь не попадают
+		_pipeline->SaveErrors({record}, 400, "invalid data");
+		_buffer_mutex.lock();
+		_enqueued++;
+		_buffer_mutex.unlock();
+		RegisterCompleted(0, 1, 0);
+		return true;
+	}
+
+	if (stamps.sampled)
+		stamps.serialized = Clock::Now().time_since_epoch().count();
+
+	QueueItem item;
+	item.json_size = json.size() + 1;
+	// сама запись после возврата освобождается, в очереди остается только JSON
+	item.bytes = item.json_size + sizeof(QueueItem);
+	item.stamps = stamps;
+
+	std::unique_lock<std::mutex> lock(_buffer_mutex);
+	_adding_allowed.wait(lock, [this]() { return !_adding_blocked; });
+	if (_closed)
 		return false;
+	if (_crash_buffer != nullptr)
+	{
+		json += '\n';
+		item.crash_pos = _crash_buffer->Append(json);
+		item.crash_size = json.size();
+		json.pop_back();
 	}
+	_arena += json;
+	_arena += ',';
+	_buffer_bytes += item.bytes;
+	_pipeline->RegisterBuffered(1, item.bytes);
+	_buffer.push_back(std::move(item));
+	_enqueued++;
+	lock.unlock();
+
+	Wakeup();
 	return true;
 }
 
-void Worker::Start(size_t number)
+RecordStamps Worker::MakeStamps(Record& record) const
 {
-	_number = number;
-//	Manager::CoutPrint(fmt::format("worker {} started", _number), false);
+	// при Clock::DeferredCapture запись получает время здесь же, и часы читаются один раз
+	const bool deferred = record.time.time_since_epoch().count() == 0;
+	record.StampTime();
+
+	RecordStamps stamps;
+	stamps.created = record.time.time_since_epoch().count();
+	stamps.enqueued = deferred ? stamps.created : Clock::Now().time_since_epoch().count();
+	stamps.key = _latency->Key(record.recordTemplate != nullptr ? record.recordTemplate->Service() : record.service, record.level);
+	stamps.sampled = _latency->Sample();
+	return stamps;
+}
 
-	while (!IsStopRequested())
-	{
-		while (true)
-		{
-			size_t process_size = _packet_size;
-			bool full_lock = false;
+size_t Worker::BufferSize() const
+{
+	std::lock_guard<std::mutex> lock(_buffer_mutex);
+	return _buffer.size();
+}
 
-			if (_flush_buffer_size > 0)
-			{
-				_buffer_mutex.lock();
-				size_t size = _buffer.size();
-				_buffer_mutex.unlock();
-				if (size > _flush_buffer_size)
-				{
-					process_size = size;
-					full_lock = true;
-					Manager::CoutPrint(fmt::format("Worker {} buffer full => auto flush", _number), true);
-				}
-			}
+size_t Worker::BufferBytes() const
+{
+	return _buffer_bytes;
+}
 
-			if (!ProcessBuffer(process_size, full_lock))
-				break;
-		}
+size_t Worker::BatchLimit() const
+{
+	return _batch_sizer.Records();
+}
 
-		// спим какое-то время или пробуждаемся при вызове AddRecord
-		std::unique_lock<std::mutex> lock(_wakeup_mutex);
-		_wakeup.wait_for(lock, std::chrono::seconds(1));
-	}
+bool Worker::IsFlushRequired() const
+{
+	if (_flush_buffer_bytes > 0 && _buffer_bytes > _flush_buffer_bytes)
+		return true;
 
-	Flush();
+	return _flush_buffer_size > 0 && BufferSize() > _flush_buffer_size;
+}
 
-//	Manager::CoutPrint(fmt::format("worker {} finished", _number), false);
+void Worker::StopRequest()
+{
+//	_pipeline->CoutPrint(fmt::format("worker {} finishing...", _number), false);
+
+	StoppableWorker::StopRequest();
+
+	// захват мьютекса гарантирует, что обработчик либо увидит запрос остановки, либо уже ждет и получит уведомление
+	{
+		std::lock_guard<std::mutex> lock(_wakeup_mutex);
+	}
+	_wakeup.notify_one();
 }
 
-void Worker::Flush()
+void Worker::ProcessErrorRecords(const std::vector<RecordPtr>& records, int error_code, const std::string& error_text)
 {
-	ProcessBuffer(BufferSize(), true);
+	_pipeline->SaveErrors(records, error_code, error_text);
 }
 
-void Worker::AddRecord(const RecordPtr& record)
+size_t Worker::TakeRecords(std::vector<RecordPtr>& records, size_t max_count)
 {
+	uint64_t crash_pos = 0;
 	_buffer_mutex.lock();
-	_buffer.push(record);
+	size_t count = TakeRecordsHelper(records, max_count, crash_pos);
+	if (count > 0)
+		_taken_batches++;
 	_buffer_mutex.unlock();
 
-	// будим обработчик если он решил поспать
-	_wakeup.notify_one();
+	if (count > 0)
+		ReleaseTaken(crash_pos);
+
+	// извлеченные записи передаются вызывающему и для Flush считаются обработанными
+	RegisterCompleted(0, 0, count);
+	return count;
 }
 
-size_t Worker::BufferSize() const
+Worker::Progress Worker::GetProgress() const
 {
-	std::lock_guard<std::mutex> lock(_buffer_mutex);
-	return _buffer.size();
+	Progress progress;
+	{
+		// enqueued читаем первым, чтобы completed не мог оказаться больше него
+		std::lock_guard<std::mutex> lock(_buffer_mutex);
+		progress.enqueued = _enqueued;
+	}
+
+	std::lock_guard<std::mutex> lock(_progress_mutex);
+	progress.delivered = _progress.delivered;
+	progress.failed = _progress.failed;
+	progress.completed = _progress.completed;
+	progress.stolen = _progress.stolen;
+	return progress;
 }
 
-void Worker::StopRequest()
+void Worker::Wakeup()
 {
-//	Manager::CoutPrint(fmt::format("worker {} finishing...", _number), false);
+	{
+		std::lock_guard<std::mutex> lock(_wakeup_mutex);
+		_wakeup_requested = true;
+	}
+	_wakeup.notify_one();
+}
 
-	StoppableWorker::StopRequest();
+bool Worker::WaitCompleted(uint64_t target, std::chrono::steady_clock::time_point deadline)
+{
+	std::unique_lock<std::mutex> lock(_progress_mutex);
+	return _progress_changed.wait_until(lock, deadline, [this, target]() { return _progress.completed >= target; });
+}
 
-	// будим обработчик если он решил поспать
-	_wakeup.notify_one();
+void Worker::TakeSendLatency(std::chrono::microseconds& total, uint64_t& count)
+{
+	total = std::chrono::microseconds(_send_time_us.exchange(0));
+	count = _send_count.exchange(0);
 }
 
-bool Worker::ProcessRecords(const std::vector<RecordPtr>& records, int& error_code, std::string& error_text)
+void Worker::RegisterCompleted(uint64_t delivered, uint64_t failed, uint64_t taken)
 {
-	if (_concat_records)
-		return SendToServer(records, error_code, error_text);
+	if (delivered + failed + taken == 0)
+		return;
 
-	for (auto i = records.begin(); i != records.end(); ++i)
 	{
-		if (!SendToServer({*i}, error_code, error_text))
-			return false;
+		std::lock_guard<std::mutex> lock(_progress_mutex);
+		_progress.delivered += delivered;
+		_progress.failed += failed;
+		_progress.completed += delivered + failed + taken;
 	}
-	return true;
+	_progress_changed.notify_all();
 }
 
-void Worker::ProcessErrorRecords(const std::vector<RecordPtr>& records, int error_code, const std::string& error_text)
+size_t Worker::TakeRecordsHelper(std::vector<RecordPtr>& records, size_t max_count, uint64_t& crash_pos, size_t max_bytes,
+								 std::vector<RecordStamps>* stamps)
 {
-	Manager::SaveErrors(records, error_code, error_text);
+	size_t count = 0;
+	size_t bytes = 0;
+	while (!_buffer.empty() && count < max_count)
+	{
+		auto& item = _buffer.front();
+		if (item.record == nullptr || (max_bytes > 0 && count > 0 && bytes + item.bytes > max_bytes))
+			break;
+
+		records.push_back(std::move(item.record));
+		if (stamps != nullptr)
+			stamps->push_back(item.stamps);
+		crash_pos = std::max(crash_pos, item.crash_pos);
+		bytes += item.bytes;
+		_buffer.pop_front();
+		count++;
+	}
+
+	// обрабатываемый пакет не учитывается: его размер ограничен packet_size
+	_buffer_bytes -= bytes;
+	_pipeline->RegisterBuffered(-(int64_t)count, -(int64_t)bytes);
+	return count;
 }
 
-bool Worker::ProcessBuffer(size_t packet_size, bool full_lock)
+size_t Worker::TakeSerializedHelper(SerializedBatch& batch, size_t max_count, uint64_t& crash_pos, size_t max_bytes,
+									std::vector<RecordStamps>* stamps)
 {
-	std::vector<RecordPtr> records;
+	size_t count = 0;
+	size_t bytes = 0;
+	size_t json_bytes = 0;
+	batch.offsets.clear();
+	while (!_buffer.empty() && count < max_count)
+	{
+		auto& item = _buffer.front();
+		if (max_bytes > 0 && count > 0 && bytes + item.bytes > max_bytes)
+			break;
+
+		// смещение с учетом открывающей скобки массива
+		batch.offsets.push_back(json_bytes + 1);
+		json_bytes += item.json_size;
+		if (stamps != nullptr)
+			stamps->push_back(item.stamps);
+		crash_pos = std::max(crash_pos, item.crash_pos);
+		bytes += item.bytes;
+		_buffer.pop_front();
+		count++;
+	}
 
-	_buffer_mutex.lock();
-	while (!_buffer.empty() && records.size() < packet_size)
+	if (count > 0)
 	{
-		records.push_back(_buffer.front());
-		_buffer.pop();
+		// записи лежат в _arena подряд и уже разделены запятыми, поэтому пакет собирается одним копированием
+		batch.json.clear();
+		batch.json.reserve(json_bytes + 1);
+		batch.json += '[';
+		batch.json.append(_arena, _arena_head, json_bytes - 1);
+		batch.json += ']';
+
+		_arena_head += json_bytes;
+		if (_arena_head == _arena.size())
+		{
+			// после пиковой нагрузки память не удерживается
+			if (_arena.capacity() > kArenaKeepBytes)
+				std::string().swap(_arena);
+			else
+				_arena.clear();
+			_arena_head = 0;
+		}
+		else if (_arena_head > _arena.size() / 2)
+		{
+			_arena.erase(0, _arena_head);
+			_arena_head = 0;
+		}
 	}
 
-	if (!full_lock)
-		_buffer_mutex.unlock();
+	_buffer_bytes -= bytes;
+	_pipeline->RegisterBuffered(-(int64_t)count, -(int64_t)bytes);
+	return count;
+}
+
+size_t Worker::ProcessBuffer(bool full_lock)
+{
+	auto taken = std::make_shared<TakenBatch>();
+	auto* stamps_ptr = _latency != nullptr ? &taken->stamps : nullptr;
+
+	std::unique_lock<std::mutex> lock(_buffer_mutex);
+	size_t count = _pre_serialize
+					   ? TakeSerializedHelper(taken->serialized, _batch_sizer.Records(), taken->crash_pos, _batch_sizer.Bytes(), stamps_ptr)
+					   : TakeRecordsHelper(taken->records, _batch_sizer.Records(), taken->crash_pos, _batch_sizer.Bytes(), stamps_ptr);
+	if (count > 0)
+		_taken_batches++;
+
+	// добавление блокируется флагом, а не удержанием _buffer_mutex, чтобы другие обработчики могли забирать записи с конца очереди
+	if (full_lock)
+		_adding_blocked = true;
+	lock.unlock();
 
 	// обрабатываем записи
-	if (!records.empty())
+	if (count > 0)
 	{
-		int error_code;
-		std::string error_text;
-		if (!ProcessRecords(records, error_code, error_text))
-			ProcessErrorRecords(records, error_code, error_text);
-		else
-			Manager::RegisterProcessedCount(records.size());
+		taken->count = count;
+		taken->owner = this;
+		SendBatch(taken);
 	}
 
 	if (full_lock)
-		_buffer_mutex.unlock();
+	{
+		lock.lock();
+		_adding_blocked = false;
+		lock.unlock();
+		_adding_allowed.notify_all();
+	}
+
+	_pipeline->NotifyPressure();
+	return count;
+}
+
+void Worker::SendBatch(const std::shared_ptr<TakenBatch>& taken)
+{
+	// отметки этапов берутся один раз на пакет
+	if (_latency != nullptr)
+		taken->dequeued_time = Clock::Now();
+
+	for (auto& r : taken->records)
+		r->FormatDeferred();
+
+	taken->serialized_time = taken->dequeued_time;
+	if (_latency != nullptr && !_pre_serialize)
+		taken->serialized_time = Clock::Now();
+
+	if (_max_pending == 0)
+	{
+		taken->begin = std::chrono::steady_clock::now();
+		_busy_since = taken->begin.time_since_epoch().count();
+		auto result = _pre_serialize ? _sink->Process(taken->serialized) : _sink->Process(taken->records);
+		_busy_since = 0;
+		CompleteBatch(*taken, result);
+		return;
+	}
+
+	// память под отправляемые пакеты ограничена: следующий передается после ответа на один из предыдущих
+	WaitPending(_max_pending);
+	{
+		std::lock_guard<std::mutex> lock(_pending_mutex);
+		_pending++;
+	}
+
+	auto done = [this, taken](const SinkResult& result) {
+		CompleteBatch(*taken, result);
+
+		// уведомление под блокировкой: после последнего ответа обработчик может завершиться и быть удален
+		std::lock_guard<std::mutex> lock(_pending_mutex);
+		_pending--;
+		_pending_changed.notify_all();
+	};
+
+	// пакет остается в taken до вызова done
+	taken->begin = std::chrono::steady_clock::now();
+	if (_pre_serialize)
+		_sink->ProcessAsync(std::shared_ptr<const SerializedBatch>(taken, &taken->serialized), done);
+	else
+		_sink->ProcessAsync(std::shared_ptr<const std::vector<RecordPtr>>(taken, &taken->records), done);
+}
+
+void Worker::CompleteBatch(TakenBatch& taken, const SinkResult& result)
+{
+	const size_t count = taken.count;
+	const auto& stamps = taken.stamps;
+	bool ok = result.ok;
+	auto latency = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - taken.begin);
+	_send_time_us += latency.count();
+	_send_count++;
+	_batch_sizer.Register(count, latency, ok);
+
+	// при частичной обработке в файл ошибок попадают только необработанные записи
+	const size_t delivered = ok ? count : std::min(result.delivered, count);
+	if (_latency != nullptr)
+	{
+		auto acked_time = Clock::Now();
+		if (ok || delivered == 0 || stamps.empty())
+		{
+			_latency->Register(stamps, taken.dequeued_time, taken.serialized_time, acked_time, ok);
+		}
+		else
+		{
+			_latency->Register({stamps.begin(), stamps.begin() + (ptrdiff_t)delivered}, taken.dequeued_time, taken.serialized_time, acked_time, true);
+			_latency->Register({stamps.begin() + (ptrdiff_t)delivered, stamps.end()}, taken.dequeued_time, taken.serialized_time, acked_time, false);
+		}
+	}
+
+	if (!ok)
+	{
+		std::string error_text = fmt::format("{}: {}", _sink->Name(), result.error_text);
+		if (_pre_serialize)
+			_pipeline->SaveErrors(delivered == 0 ? taken.serialized : taken.serialized.Slice(delivered, taken.serialized.Size()), result.error_code,
+								  error_text);
+		else
+			ProcessErrorRecords(delivered == 0 ? taken.records
+											   : std::vector<RecordPtr>(taken.records.begin() + (ptrdiff_t)delivered, taken.records.end()),
+								result.error_code,
+								error_text);
+		if (delivered > 0)
+			_pipeline->RegisterProcessedCount(delivered);
+		taken.owner->RegisterCompleted(delivered, count - delivered, 0);
+	}
+	else
+	{
+		_pipeline->RegisterProcessedCount(count);
+		taken.owner->RegisterCompleted(count, 0, 0);
+	}
+
+	// записи отправлены или сохранены в файл ошибок, аварийные копии больше не нужны
+	taken.owner->ReleaseTaken(taken.crash_pos, taken.stolen_pos);
+}
+
+void Worker::WaitPending(size_t limit)
+{
+	std::unique_lock<std::mutex> lock(_pending_mutex);
+	if (_pending < limit)
+		return;
+
+	// ожидание ответа считается занятостью отправкой: записи из очереди могут забрать другие обработчики (StealingOptions)
+	_busy_since = std::chrono::steady_clock::now().time_since_epoch().count();
+	_pending_changed.wait(lock, [this, limit]() { return _pending < limit; });
+	_busy_since = 0;
+}
+
+bool Worker::IsStalled(std::chrono::steady_clock::time_point now, std::chrono::milliseconds stall) const
+{
+	int64_t busy_since = _busy_since;
+	return busy_since != 0 && now - std::chrono::steady_clock::time_point(std::chrono::steady_clock::duration(busy_since)) > stall;
+}
+
+size_t Worker::StealBatch()
+{
+	// самый загруженный из обработчиков, которые дольше stall заняты отправкой своего пакета
+	auto workers = _pipeline->Workers();
+	const auto now = std::chrono::steady_clock::now();
+	Worker* victim = nullptr;
+	size_t victim_bytes = 0;
+	for (auto& w : *workers)
+	{
+		if (w.get() == this || !w->IsStalled(now, _stealing.stall))
+			continue;
+
+		size_t bytes = w->BufferBytes();
+		if (bytes > victim_bytes)
+		{
+			victim = w.get();
+			victim_bytes = bytes;
+		}
+	}
+	if (victim == nullptr)
+		return 0;
+
+	auto taken = std::make_shared<TakenBatch>();
+	size_t count = victim->TakeTail(taken->records, taken->serialized, _latency != nullptr ? &taken->stamps : nullptr, _batch_sizer.Records(),
+									_batch_sizer.Bytes(), taken->stolen_pos);
+	if (count == 0)
+		return 0;
+
+	{
+		std::lock_guard<std::mutex> lock(_progress_mutex);
+		_progress.stolen += count;
+	}
+	// завершение засчитывается обработчику, в очередь которого были добавлены записи: его ждет Flush
+	taken->count = count;
+	taken->owner = victim;
+	SendBatch(taken);
+	return count;
+}
+
+void Worker::ReleaseTaken(uint64_t crash_pos, uint64_t stolen_pos)
+{
+	std::lock_guard<std::mutex> lock(_buffer_mutex);
+	_taken_batches--;
+	if (_taken_batches == 0)
+		_taken_released.notify_all();
+	if (_crash_buffer == nullptr)
+		return;
+
+	if (stolen_pos > 0)
+	{
+		_stolen_copies.erase(std::find_if(_stolen_copies.begin(), _stolen_copies.end(),
+										  [stolen_pos](const std::pair<uint64_t, uint64_t>& c) { return c.first == stolen_pos; }));
+	}
+	_release_pos = std::max(_release_pos, crash_pos);
+
+	// копии записей, забранных с конца очереди, лежат после всех остальных. Пока очередь не пуста, они освобождаются
+	// вместе со следующими пакетами владельца, а в опустевшей очереди - после обработки последнего извлеченного пакета
+	if (_taken_batches == 0 && _buffer.empty() && _stolen_crash_pos > 0)
+	{
+		_release_pos = std::max(_release_pos, _stolen_crash_pos);
+		_stolen_crash_pos = 0;
+	}
+
+	// пакет владельца может заканчиваться после записей, которые еще отправляет другой обработчик
+	uint64_t pos = _release_pos;
+	for (auto& c : _stolen_copies)
+		pos = std::min(pos, c.second);
+	if (pos > 0)
+		_crash_buffer->Release(pos);
+}
+
+size_t Worker::TakeTail(std::vector<RecordPtr>& records, SerializedBatch& batch, std::vector<RecordStamps>* stamps, size_t max_count,
+						size_t max_bytes, uint64_t& stolen_pos)
+{
+	std::lock_guard<std::mutex> lock(_buffer_mutex);
+
+	// сколько записей с конца помещается в пакет
+	size_t count = 0;
+	size_t bytes = 0;
+	size_t json_bytes = 0;
+	for (auto it = _buffer.rbegin(); it != _buffer.rend() && count < max_count; ++it)
+	{
+		// сериализованные и обычные записи не смешиваются в одном пакете
+		if ((it->record == nullptr) != _pre_serialize || (max_bytes > 0 && count > 0 && bytes + it->bytes > max_bytes))
+			break;
+
+		bytes += it->bytes;
+		json_bytes += it->json_size;
+		count++;
+	}
+	if (count == 0)
+		return 0;
+
+	const auto first = _buffer.end() - (ptrdiff_t)count;
+	if (_pre_serialize)
+	{
+		// последние записи лежат в конце _arena, поэтому она просто укорачивается
+		batch.offsets.clear();
+		size_t offset = 1;
+		for (auto it = first; it != _buffer.end(); ++it)
+		{
+			batch.offsets.push_back(offset);
+			offset += it->json_size;
+		}
+		batch.json.clear();
+		batch.json.reserve(json_bytes + 1);
+		batch.json += '[';
+		batch.json.append(_arena, _arena.size() - json_bytes, json_bytes - 1);
+		batch.json += ']';
+
+		_arena.resize(_arena.size() - json_bytes);
+		if (_arena.size() == _arena_head)
+		{
+			_arena.clear();
+			_arena_head = 0;
+		}
+	}
+
+	// аварийные копии остаются в буфере этого обработчика и освобождаются в ReleaseTaken
+	stolen_pos = 0;
+	for (auto it = first; it != _buffer.end(); ++it)
+	{
+		if (stolen_pos == 0 && it->crash_pos > 0)
+		{
+			stolen_pos = it->crash_pos;
+			_stolen_copies.push_back({it->crash_pos, it->crash_pos - it->crash_size});
+		}
+		_stolen_crash_pos = std::max(_stolen_crash_pos, it->crash_pos);
+		if (!_pre_serialize)
+			records.push_back(std::move(it->record));
+		if (stamps != nullptr)
+			stamps->push_back(it->stamps);
+	}
+	_buffer.erase(first, _buffer.end());
+	_taken_batches++;
 
-	return !records.empty();
+	_buffer_bytes -= bytes;
+	_pipeline->RegisterBuffered(-(int64_t)count, -(int64_t)bytes);
+	return count;
 }
 
 } // namespace Logger
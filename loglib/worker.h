@@ -1,17 +1,60 @@
 #pragma once
 
-#include <queue>
+#include <deque>
 #include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <vector>
+#include <atomic>
 
 #include "stoppable_worker.h"
 #include "record.h"
+#include "crash_handler.h"
+#include "batching.h"
+#include "sink.h"
+#include "latency.h"
+#include "scaling.h"
 
 namespace Logger
 {
+class Pipeline;
 
 class Worker : public StoppableWorker
 {
 public:
+	//! Счетчики записей обработчика
+	struct Progress
+	{
+		//! Добавлено в очередь
+		uint64_t enqueued = 0;
+		//! Успешно отправлено
+		uint64_t delivered = 0;
+		//! Не удалось отправить
+		uint64_t failed = 0;
+		//! Обработано всего (в том числе извлечено через TakeRecords и обработано другими обработчиками)
+		uint64_t completed = 0;
+		//! Забрано и обработано записей из очередей других обработчиков (StealingOptions)
+		uint64_t stolen = 0;
+	};
+
+	Worker(
+		//! Приемник пакетов
+		const SinkPtr& sink,
+		//! Сколько записей обрабатывать за один раз
+		size_t packet_size,
+		//! Максимальный размер буффера, после которого начнется его принудительное сбрасывание
+		//! Если 0, то никогда
+		size_t flush_buffer_size,
+		//! Размер буфера для аварийного сохранения записей при падении процесса в байтах. Если 0, то не используется
+		size_t crash_buffer_size = 0,
+		//! Объем записей в очереди в байтах, после которого начнется ее принудительное сбрасывание. Если 0, то никогда
+		size_t flush_buffer_bytes = 0,
+		//! Ограничение объема пакета и адаптивный подбор количества записей в нем
+		const BatchOptions& batch_options = {},
+		//! Конвейер, в котором учитываются записи и сохраняются ошибки. Если nullptr, то Manager::Default()
+		Pipeline* pipeline = nullptr);
+	//! Обработчик с отправкой на сервер логов (HttpSink)
 	Worker(
 		//! Токен доступа
 		const std::string& token,
@@ -25,55 +68,201 @@ public:
 		//! Если 0, то никогда
 		size_t flush_buffer_size,
 		//! При наличии в буфере нескольких записей, отправлять их одним пакетом
-		bool concat_records);
+		bool concat_records,
+		//! Размер буфера для аварийного сохранения записей при падении процесса в байтах. Если 0, то не используется
+		size_t crash_buffer_size = 0,
+		//! Объем записей в очереди в байтах, после которого начнется ее принудительное сбрасывание. Если 0, то никогда
+		size_t flush_buffer_bytes = 0,
+		//! Ограничение объема пакета и адаптивный подбор количества записей в нем
+		const BatchOptions& batch_options = {});
+	~Worker();
 
 	// Запуск на выполнение
 	void Start(size_t number);
 
-	//! Добавить запись
-	void AddRecord(const RecordPtr& record);
+	//! Добавить запись. bytes - приблизительный размер записи (Record::MemorySize), если 0, то вычисляется.
+	//! Сериализация записи выполняется в вызывающем потоке до блокировки очереди.
+	//! Возвращает false, если обработчик уже завершает работу и запись не принята
+	bool AddRecord(const RecordPtr& record, size_t bytes = 0);
 	//! Остановить прием и обработать буффер
 	void Flush();
 
 	//! Размер текущей очереди на выполнение
 	size_t BufferSize() const;
+	//! Приблизительный объем памяти, занимаемой записями в очереди, в байтах
+	size_t BufferBytes() const;
+	//! Текущее ограничение количества записей в пакете
+	size_t BatchLimit() const;
+	//! Забрать из очереди не более max_count записей, не отправляя их. Возвращает количество извлеченных записей.
+	//! Сериализованные записи (BatchOptions::pre_serialize) не извлекаются
+	size_t TakeRecords(std::vector<RecordPtr>& records, size_t max_count);
+
+	//! Текущие счетчики
+	Progress GetProgress() const;
+	//! Разбудить обработчик для немедленной обработки очереди
+	void Wakeup();
+	//! Дождаться, пока счетчик completed достигнет target. Возвращает false по истечении deadline
+	bool WaitCompleted(uint64_t target, std::chrono::steady_clock::time_point deadline);
+	//! Суммарное время обработки пакетов и их количество с момента предыдущего вызова
+	void TakeSendLatency(std::chrono::microseconds& total, uint64_t& count);
+	//! Обработчик занят отправкой пакета дольше stall
+	bool IsStalled(std::chrono::steady_clock::time_point now, std::chrono::milliseconds stall) const;
 
 	//! Запросить остановку потока
 	void StopRequest() override;
 
 private:
-	//! Обработчик записей
-	bool ProcessRecords(const std::vector<RecordPtr>& records, int& error_code, std::string& error_text);
-	//! Если не удалось выполнить ProcessRecords (например недоступен внешний сервис), то пишем ошибки в локальный файл
+	//! Если приемник не смог обработать пакет (например недоступен внешний сервис), то пишем ошибки в локальный файл
 	void ProcessErrorRecords(const std::vector<RecordPtr>& records, int error_code, const std::string& error_text);
-	//! Обработка буфера
-	bool ProcessBuffer(size_t packet_size, bool full_lock);
+	//! Обработка одного пакета из очереди. Возвращает количество обработанных записей
+	size_t ProcessBuffer(bool full_lock);
+	//! Извлечение записей из очереди. _buffer_mutex должен быть заблокирован.
+	//! В crash_pos возвращается позиция в _crash_buffer, которую можно освободить после обработки.
+	//! Если max_bytes больше 0, то извлечение прекращается до превышения этого объема (но не менее одной записи).
+	//! Если stamps не nullptr, то в него добавляются отметки времени извлеченных записей
+	size_t TakeRecordsHelper(std::vector<RecordPtr>& records, size_t max_count, uint64_t& crash_pos, size_t max_bytes = 0,
+							 std::vector<RecordStamps>* stamps = nullptr);
+	//! Извлечение сериализованных записей из очереди в пакет. _buffer_mutex должен быть заблокирован
+	size_t TakeSerializedHelper(SerializedBatch& batch, size_t max_count, uint64_t& crash_pos, size_t max_bytes,
+								std::vector<RecordStamps>* stamps = nullptr);
+	//! Сериализация записи и добавление в _arena
+	bool AddSerialized(const RecordPtr& record, RecordStamps stamps);
+	//! Время создания и добавления записи, сервис и уровень для LatencyTracker
+	RecordStamps MakeStamps(Record& record) const;
+	//! Пакет, извлеченный из очереди owner (этого или другого обработчика)
+	struct TakenBatch
+	{
+		std::vector<RecordPtr> records;
+		//! Записи, сериализованные при добавлении
+		SerializedBatch serialized;
+		std::vector<RecordStamps> stamps;
+		size_t count = 0;
+		//! Ему засчитывается завершение записей и передаются crash_pos и stolen_pos (ReleaseTaken)
+		Worker* owner = nullptr;
+		uint64_t crash_pos = 0;
+		uint64_t stolen_pos = 0;
+		//! Отметки этапов для LatencyTracker
+		RecordTime dequeued_time;
+		RecordTime serialized_time;
+		//! Начало отправки
+		std::chrono::steady_clock::time_point begin;
+	};
+	//! Отправка пакета. Синхронный приемник обрабатывает его в потоке обработчика, а асинхронному пакет передается без ожидания
+	//! результата, как только ответа ждут меньше Sink::MaxPendingBatches() пакетов
+	void SendBatch(const std::shared_ptr<TakenBatch>& taken);
+	//! Учет результата обработки пакета, файл ошибок и освобождение аварийных копий в очереди владельца
+	void CompleteBatch(TakenBatch& taken, const SinkResult& result);
+	//! Дождаться, пока результата ждут меньше limit пакетов, переданных асинхронному приемнику
+	void WaitPending(size_t limit);
+	//! Забрать пакет с конца очереди самого загруженного из зависших обработчиков и отправить его. Возвращает количество записей
+	size_t StealBatch();
+	//! Извлечение записей с конца очереди для другого обработчика. В stolen_pos возвращается конец аварийной копии первой
+	//! извлеченной записи (0, если копий нет), который передается в ReleaseTaken после обработки
+	size_t TakeTail(std::vector<RecordPtr>& records, SerializedBatch& batch, std::vector<RecordStamps>* stamps, size_t max_count,
+					size_t max_bytes, uint64_t& stolen_pos);
+	//! Завершение обработки пакета, извлеченного из этой очереди: освобождение аварийных копий до crash_pos (ProcessBuffer)
+	//! или пакета stolen_pos (TakeTail). Копии не освобождаются дальше начала пакетов, которые еще отправляют
+	//! другие обработчики, а копии забранных записей освобождаются, когда очередь опустела
+	void ReleaseTaken(uint64_t crash_pos, uint64_t stolen_pos = 0);
+	//! Нужно ли принудительно сбросить очередь по количеству записей или их объему
+	bool IsFlushRequired() const;
+	//! Учесть результат обработки пакета и уведомить ожидающих в WaitCompleted
+	void RegisterCompleted(uint64_t delivered, uint64_t failed, uint64_t taken);
 
-	//! Отправка лога на удаленный сервер
-	bool SendToServer(const std::vector<RecordPtr>& records, int& error_code, std::string& error_string);
-
-	//! Токен доступа
-	std::string _token;
-
-	//! Адрес сервера
-	std::string _host;
-	//! Порт сервера
-	uint16_t _port;
+	//! Конвейер, которому принадлежит обработчик
+	Pipeline* _pipeline;
+	//! Приемник пакетов
+	SinkPtr _sink;
 
 	size_t _number = 0;
 	//! Сколько записей обрабатывать за один раз
 	size_t _packet_size;
+	//! Подбор размера пакета (не более _packet_size записей)
+	BatchSizer _batch_sizer;
 	//! Максимальный размер буффера, после которого начнется его принудительное сбрасывание
 	//! Если 0, то никогда
 	size_t _flush_buffer_size;
+	//! Объем очереди в байтах, после которого начнется ее принудительное сбрасывание. Если 0, то никогда
+	size_t _flush_buffer_bytes;
+	//! Записи сериализуются при добавлении (BatchOptions::pre_serialize и приемник это поддерживает)
+	const bool _pre_serialize;
+	//! Сбор задержек доставки записей конвейера. nullptr, если отключен
+	const std::shared_ptr<LatencyTracker> _latency;
+	//! Перераспределение записей между обработчиками конвейера
+	const StealingOptions _stealing;
+	//! Sink::MaxPendingBatches(). Если 0, то пакеты отправляются синхронно
+	const size_t _max_pending;
+
+	//! Элемент очереди
+	struct QueueItem
+	{
+		//! nullptr, если запись сериализована в _arena
+		RecordPtr record;
+		//! Размер JSON записи в _arena вместе с разделителем
+		size_t json_size = 0;
+		//! Конец копии записи в _crash_buffer (0, если копии нет)
+		uint64_t crash_pos = 0;
+		//! Размер копии записи в _crash_buffer
+		size_t crash_size = 0;
+		//! Размер записи, учтенный в _buffer_bytes на момент добавления
+		size_t bytes = 0;
+		//! Отметки времени (если включен _latency)
+		RecordStamps stamps;
+	};
 
 	mutable std::mutex _buffer_mutex;
-	std::queue<RecordPtr> _buffer;
+	//! Владелец извлекает записи с начала, другие обработчики (StealingOptions) - с конца
+	std::deque<QueueItem> _buffer;
+	//! JSON сериализованных записей очереди подряд, каждая с завершающей запятой. Защищен _buffer_mutex
+	std::string _arena;
+	//! Начало первой записи очереди в _arena
+	size_t _arena_head = 0;
+	//! Счетчик добавленных записей. Защищен _buffer_mutex
+	uint64_t _enqueued = 0;
+	//! Обработчик завершает работу и больше не принимает записи. Защищен _buffer_mutex
+	bool _closed = false;
+	//! Идет принудительный сброс переполненной очереди, добавление ждет _adding_allowed. Защищен _buffer_mutex
+	bool _adding_blocked = false;
+	std::condition_variable _adding_allowed;
+	//! Извлеченных из очереди и еще не обработанных пакетов. Защищен _buffer_mutex
+	size_t _taken_batches = 0;
+	//! Уведомляется с _buffer_mutex, когда обработаны все извлеченные пакеты. Обработчик не завершается, пока другие
+	//! отправляют записи из его очереди
+	std::condition_variable _taken_released;
+	//! Конец аварийных копий записей, забранных другими обработчиками (0, если их нет). Защищен _buffer_mutex
+	uint64_t _stolen_crash_pos = 0;
+	//! Аварийные копии пакетов, которые отправляют другие обработчики: конец копии первой записи (stolen_pos) и ее начало.
+	//! Защищен _buffer_mutex
+	std::vector<std::pair<uint64_t, uint64_t>> _stolen_copies;
+	//! Позиция, до которой обработаны все записи, кроме отправляемых другими обработчиками. Защищен _buffer_mutex
+	uint64_t _release_pos = 0;
+	//! Объем записей в очереди. Изменяется под _buffer_mutex, читается без блокировки
+	std::atomic<size_t> _buffer_bytes = 0;
 
 	std::condition_variable _wakeup;
 	std::mutex _wakeup_mutex;
+	//! Запрошена немедленная обработка очереди. Защищен _wakeup_mutex
+	bool _wakeup_requested = false;
+
+	//! Счетчики обработанных записей
+	mutable std::mutex _progress_mutex;
+	std::condition_variable _progress_changed;
+	Progress _progress;
+
+	//! Начало текущей отправки пакета или ожидания ответа асинхронного приемника (steady_clock), 0 - обработчик не занят отправкой
+	std::atomic<int64_t> _busy_since = 0;
+
+	//! Пакетов, переданных асинхронному приемнику и ожидающих результата. Защищен _pending_mutex
+	size_t _pending = 0;
+	std::mutex _pending_mutex;
+	std::condition_variable _pending_changed;
+
+	//! Время обработки пакетов для TakeSendLatency
+	std::atomic<int64_t> _send_time_us = 0;
+	std::atomic<uint64_t> _send_count = 0;
 
-	bool _concat_records;
+	//! Сериализованные копии записей из очереди для аварийного сохранения
+	std::unique_ptr<CrashBuffer> _crash_buffer;
 };
 
 using WorkerPtr = std::shared_ptr<Worker>;
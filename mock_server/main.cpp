@@ -0,0 +1,373 @@
+// Локальная замена сервера логов (https://github.com/n-r-w/logsrv) для нагрузочного тестирования.
+// Реализует POST /api/add с проверкой токена и умеет имитировать задержки, ошибки и обрывы соединения.
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <random>
+#include <thread>
+#include <csignal>
+
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <httplib.h>
+#include <json.hpp>
+#include <fmtlib/format.h>
+
+#include "distribution.h"
+
+namespace
+{
+
+struct Options
+{
+	std::string host = "0.0.0.0";
+	int port = 8080;
+	//! Если пустой, то токен не проверяется
+	std::string token;
+	size_t threads = 0;
+	//! Задержка перед ответом
+	Tools::Distribution latency;
+	//! Доли запросов с внедренными ошибками [0..1]
+	double error_5xx = 0;
+	double error_4xx = 0;
+	double reset = 0;
+	double slow_read = 0;
+	//! Пауза после каждого прочитанного блока тела при медленном чтении
+	int slow_read_ms = 10;
+	//! Максимальный размер тела запроса, 0 - без ограничений
+	size_t max_body = 0;
+	//! Запросов через одно соединение, после чего сервер его закрывает. 0 - по умолчанию httplib
+	size_t keep_alive = 0;
+	//! Проверять корректность json
+	bool decode = true;
+	//! Период вывода статистики
+	int report_sec = 1;
+};
+
+struct Stats
+{
+	std::atomic<uint64_t> requests = 0;
+	std::atomic<uint64_t> records = 0;
+	std::atomic<uint64_t> bytes = 0;
+	std::atomic<uint64_t> invalid_bodies = 0;
+	std::atomic<uint64_t> invalid_records = 0;
+	std::atomic<uint64_t> unauthorized = 0;
+	std::atomic<uint64_t> injected_5xx = 0;
+	std::atomic<uint64_t> injected_4xx = 0;
+	std::atomic<uint64_t> resets = 0;
+	std::atomic<uint64_t> slow_reads = 0;
+};
+
+Options options;
+Stats stats;
+httplib::Server* server = nullptr;
+
+std::mt19937_64& Random()
+{
+	thread_local std::mt19937_64 rng(std::random_device {}() ^ std::hash<std::thread::id>()(std::this_thread::get_id()));
+	return rng;
+}
+
+bool Chance(double rate)
+{
+	return rate > 0 && std::uniform_real_distribution<double>(0, 1)(Random()) < rate;
+}
+
+//! httplib не дает доступа к сокету запроса, поэтому ищем его по адресу клиента
+int FindClientSocket(const httplib::Request& req)
+{
+	rlimit limit {};
+	getrlimit(RLIMIT_NOFILE, &limit);
+
+	for (int fd = 3; fd < (int)std::min<rlim_t>(limit.rlim_cur, 65536); fd++)
+	{
+		sockaddr_storage local {};
+		sockaddr_storage peer {};
+		socklen_t local_len = sizeof(local);
+		socklen_t peer_len = sizeof(peer);
+		if (getsockname(fd, (sockaddr*)&local, &local_len) != 0 || getpeername(fd, (sockaddr*)&peer, &peer_len) != 0)
+			continue;
+
+		char addr[INET6_ADDRSTRLEN] = {};
+		int local_port = 0;
+		int peer_port = 0;
+		if (peer.ss_family == AF_INET)
+		{
+			inet_ntop(AF_INET, &((sockaddr_in*)&peer)->sin_addr, addr, sizeof(addr));
+			peer_port = ntohs(((sockaddr_in*)&peer)->sin_port);
+			local_port = ntohs(((sockaddr_in*)&local)->sin_port);
+		}
+		else if (peer.ss_family == AF_INET6)
+		{
+			inet_ntop(AF_INET6, &((sockaddr_in6*)&peer)->sin6_addr, addr, sizeof(addr));
+			peer_port = ntohs(((sockaddr_in6*)&peer)->sin6_port);
+			local_port = ntohs(((sockaddr_in6*)&local)->sin6_port);
+		}
+
+		if (local_port == options.port && peer_port == req.remote_port && req.remote_addr == addr)
+			return fd;
+	}
+	return -1;
+}
+
+//! Обрыв соединения: SO_LINGER с нулевым таймаутом приводит к отправке RST при закрытии
+void ResetConnection(const httplib::Request& req)
+{
+	int fd = FindClientSocket(req);
+	if (fd < 0)
+		return;
+
+	linger l {1, 0};
+	setsockopt(fd, SOL_SOCKET, SO_LINGER, &l, sizeof(l));
+	shutdown(fd, SHUT_RDWR);
+}
+
+//! Проверка формата, который отправляет loglib: массив объектов с обязательными полями
+bool DecodeBody(const std::string& body, uint64_t& valid, uint64_t& invalid)
+{
+	auto j = nlohmann::json::parse(body, nullptr, false);
+	if (j.is_discarded() || !j.is_array())
+		return false;
+
+	for (auto& r : j)
+	{
+		if (r.is_object() && r.contains("logTime") && r["logTime"].is_string() && r.contains("service") && r["service"].is_string() &&
+			r.contains("level") && r["level"].is_string())
+			valid++;
+		else
+			invalid++;
+	}
+	return true;
+}
+
+void HandleAdd(const httplib::Request& req, httplib::Response& res, const httplib::ContentReader& content_reader)
+{
+	stats.requests++;
+
+	if (!options.token.empty() && req.get_header_value("X-Authorization") != options.token)
+	{
+		stats.unauthorized++;
+		res.status = 401;
+		return;
+	}
+
+	if (Chance(options.reset))
+	{
+		stats.resets++;
+		ResetConnection(req);
+		return;
+	}
+
+	bool slow = Chance(options.slow_read);
+	if (slow)
+		stats.slow_reads++;
+
+	std::string body;
+	content_reader([&](const char* data, size_t length) {
+		body.append(data, length);
+		if (slow)
+			std::this_thread::sleep_for(std::chrono::milliseconds(options.slow_read_ms));
+		return options.max_body == 0 || body.size() <= options.max_body;
+	});
+	stats.bytes += body.size();
+
+	if (options.max_body > 0 && body.size() > options.max_body)
+	{
+		res.status = 413;
+		return;
+	}
+
+	double delay = options.latency.Sample(Random());
+	if (delay > 0)
+		std::this_thread::sleep_for(std::chrono::microseconds((int64_t)(delay * 1000)));
+
+	if (Chance(options.error_5xx))
+	{
+		stats.injected_5xx++;
+		res.status = 503;
+		res.set_content("injected error", "text/plain");
+		return;
+	}
+
+	if (Chance(options.error_4xx))
+	{
+		stats.injected_4xx++;
+		res.status = 400;
+		res.set_content("injected error", "text/plain");
+		return;
+	}
+
+	if (options.decode)
+	{
+		uint64_t valid = 0;
+		uint64_t invalid = 0;
+		if (!DecodeBody(body, valid, invalid))
+		{
+			stats.invalid_bodies++;
+			res.status = 400;
+			res.set_content("invalid json", "text/plain");
+			return;
+		}
+		stats.records += valid;
+		stats.invalid_records += invalid;
+	}
+
+	res.status = 201;
+}
+
+void PrintUsage()
+{
+	std::cout << "loglib-mock-server [options]\n"
+				 "  --host=ADDR             listen address (0.0.0.0)\n"
+				 "  --port=N                listen port (8080)\n"
+				 "  --token=TOKEN           required X-Authorization value (any if empty)\n"
+				 "  --threads=N             server thread pool size\n"
+				 "  --latency=DIST          none | fixed:MS | uniform:MIN:MAX | normal:MEAN:STDDEV | exp:MEAN\n"
+				 "  --error-5xx=RATE        share of requests answered with 503\n"
+				 "  --error-4xx=RATE        share of requests answered with 400\n"
+				 "  --reset=RATE            share of connections reset without response\n"
+				 "  --slow-read=RATE        share of requests whose body is read slowly\n"
+				 "  --slow-read-ms=MS       pause after each body block for slow reads (10)\n"
+				 "  --max-body=BYTES        maximum request body, 413 if exceeded (0 = unlimited)\n"
+				 "  --keep-alive=N          requests per connection before it is closed (httplib default)\n"
+				 "  --decode=0|1            validate json records (1)\n"
+				 "  --report=SEC            statistics period (1)\n";
+}
+
+bool ParseOptions(int argc, char* argv[])
+{
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		size_t eq = arg.find('=');
+		std::string key = arg.substr(0, eq);
+		std::string value = eq == std::string::npos ? "" : arg.substr(eq + 1);
+
+		if (key == "--host")
+			options.host = value;
+		else if (key == "--port")
+			options.port = std::atoi(value.c_str());
+		else if (key == "--token")
+			options.token = value;
+		else if (key == "--threads")
+			options.threads = std::strtoul(value.c_str(), nullptr, 10);
+		else if (key == "--latency")
+		{
+			if (!Tools::Distribution::Parse(value, options.latency))
+			{
+				std::cerr << "invalid latency distribution: " << value << std::endl;
+				return false;
+			}
+		}
+		else if (key == "--error-5xx")
+			options.error_5xx = std::atof(value.c_str());
+		else if (key == "--error-4xx")
+			options.error_4xx = std::atof(value.c_str());
+		else if (key == "--reset")
+			options.reset = std::atof(value.c_str());
+		else if (key == "--slow-read")
+			options.slow_read = std::atof(value.c_str());
+		else if (key == "--slow-read-ms")
+			options.slow_read_ms = std::atoi(value.c_str());
+		else if (key == "--max-body")
+			options.max_body = std::strtoull(value.c_str(), nullptr, 10);
+		else if (key == "--keep-alive")
+			options.keep_alive = std::strtoul(value.c_str(), nullptr, 10);
+		else if (key == "--decode")
+			options.decode = value != "0";
+		else if (key == "--report")
+			options.report_sec = std::max(1, std::atoi(value.c_str()));
+		else
+		{
+			PrintUsage();
+			return false;
+		}
+	}
+	return true;
+}
+
+void PrintStats(uint64_t& last_records, uint64_t& last_requests, uint64_t& last_bytes, double seconds)
+{
+	uint64_t records = stats.records;
+	uint64_t requests = stats.requests;
+	uint64_t bytes = stats.bytes;
+
+	std::cout << fmt::format("records/s: {:.0f}, requests/s: {:.0f}, MB/s: {:.2f}, total records: {}, invalid bodies: {}, invalid records: {}, "
+							 "401: {}, 4xx: {}, 5xx: {}, resets: {}, slow reads: {}",
+							 (records - last_records) / seconds,
+							 (requests - last_requests) / seconds,
+							 (bytes - last_bytes) / seconds / (1024 * 1024),
+							 records,
+							 stats.invalid_bodies.load(),
+							 stats.invalid_records.load(),
+							 stats.unauthorized.load(),
+							 stats.injected_4xx.load(),
+							 stats.injected_5xx.load(),
+							 stats.resets.load(),
+							 stats.slow_reads.load())
+			  << std::endl;
+
+	last_records = records;
+	last_requests = requests;
+	last_bytes = bytes;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+	if (!ParseOptions(argc, argv))
+		return 1;
+
+	httplib::Server svr;
+	server = &svr;
+
+	if (options.threads > 0)
+		svr.new_task_queue = [] { return new httplib::ThreadPool(options.threads); };
+	if (options.max_body > 0)
+		svr.set_payload_max_length(options.max_body);
+	if (options.keep_alive > 0)
+		svr.set_keep_alive_max_count(options.keep_alive);
+
+	svr.Post("/api/add", HandleAdd);
+
+	std::signal(SIGINT, [](int) { server->stop(); });
+	std::signal(SIGTERM, [](int) { server->stop(); });
+
+	std::atomic_bool finished = false;
+	std::thread reporter([&]() {
+		uint64_t last_records = 0;
+		uint64_t last_requests = 0;
+		uint64_t last_bytes = 0;
+		auto last_time = std::chrono::steady_clock::now();
+		while (!finished)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+			auto now = std::chrono::steady_clock::now();
+			if (now - last_time < std::chrono::seconds(options.report_sec))
+				continue;
+
+			PrintStats(last_records, last_requests, last_bytes, std::chrono::duration<double>(now - last_time).count());
+			last_time = now;
+		}
+	});
+
+	std::cout << fmt::format("listening on {}:{}", options.host, options.port) << std::endl;
+	bool ok = svr.listen(options.host.c_str(), options.port);
+
+	finished = true;
+	reporter.join();
+
+	if (!ok)
+	{
+		std::cerr << fmt::format("unable to listen on {}:{}", options.host, options.port) << std::endl;
+		return 1;
+	}
+
+	return 0;
+}